@@ -0,0 +1,214 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// This benchmark measures the cost of running a small task through leaf::capture with
+// a context obtained from make_shared_context (as in examples/capture_in_result.cpp),
+// and handling the result, both when the task succeeds and when it fails. It also
+// counts the number of dynamic memory allocations per task. Build with and without
+// LEAF_CONTEXT_POOL_SIZE=16 (for example) to compare allocating a new context for each
+// task with recycling the memory of the contexts of completed tasks.
+//
+// The Async rows run the same tasks on a worker thread, with the results handled (and
+// the contexts freed) by the main thread. Contexts are recycled through the pool of the
+// thread that frees them, so in this case the worker does not benefit from the pool.
+
+#ifndef LEAF_ALL_HPP_INCLUDED
+#	include <boost/leaf/all.hpp>
+#endif
+
+#ifdef _MSC_VER
+#	define NOINLINE __declspec(noinline)
+#else
+#	define NOINLINE __attribute__((noinline))
+#endif
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace leaf = boost::leaf;
+
+#ifdef LEAF_NO_EXCEPTIONS
+namespace boost
+{
+	void throw_exception( std::exception const & e )
+	{
+		std::cerr << "Terminating due to a C++ exception under LEAF_NO_EXCEPTIONS: " << e.what();
+		std::terminate();
+	}
+}
+#endif
+
+//////////////////////////////////////
+
+unsigned long allocation_count;
+
+void * operator new( std::size_t size )
+{
+	++allocation_count;
+	if( void * p = std::malloc(size) )
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete( void * p ) noexcept
+{
+	std::free(p);
+}
+
+void operator delete( void * p, std::size_t ) noexcept
+{
+	std::free(p);
+}
+
+//////////////////////////////////////
+
+struct e_task_id
+{
+	int value;
+};
+
+struct e_failure_info
+{
+	int value;
+};
+
+auto error_handler = []( leaf::error_info const & error )
+{
+	return leaf::remote_handle_all( error,
+		[]( e_task_id const & id, e_failure_info const & info )
+		{
+			return id.value + info.value;
+		},
+		[]
+		{
+			return -1;
+		} );
+};
+
+NOINLINE leaf::result<int> task( int x ) noexcept
+{
+	if( x<0 )
+		return leaf::new_error(e_task_id{x}, e_failure_info{1});
+	return x;
+}
+
+NOINLINE int run( int x ) noexcept
+{
+	leaf::result<int> r = leaf::capture(leaf::make_shared_context(&error_handler), &task, x);
+	return leaf::remote_try_handle_all(
+		[&]
+		{
+			return std::move(r);
+		},
+		[]( leaf::error_info const & error )
+		{
+			return error_handler(error);
+		} );
+}
+
+NOINLINE int handle( leaf::result<int> & r ) noexcept
+{
+	return leaf::remote_try_handle_all(
+		[&]
+		{
+			return std::move(r);
+		},
+		[]( leaf::error_info const & error )
+		{
+			return error_handler(error);
+		} );
+}
+
+struct measurement
+{
+	double ns;
+	double allocations;
+};
+
+template <class F>
+measurement measure( int iteration_count, F f )
+{
+	measurement best = { 0, 0 };
+	for( int rep=0; rep!=5; ++rep )
+	{
+		int val = 0;
+		unsigned long allocations = allocation_count;
+		auto start = std::chrono::steady_clock::now();
+		for( int i=0; i!=iteration_count; ++i )
+			val += f(i);
+		auto stop = std::chrono::steady_clock::now();
+		allocations = allocation_count - allocations;
+		if( val==42 )
+			std::cout << ' ';
+		double ns = std::chrono::duration<double, std::nano>(stop-start).count() / iteration_count;
+		if( rep==0 || ns<best.ns )
+			best = { ns, double(allocations) / iteration_count };
+	}
+	return best;
+}
+
+template <class F>
+measurement measure_async( int iteration_count, F f )
+{
+	int const batch_size = 10000;
+	std::vector<leaf::result<int>> results;
+	results.reserve(batch_size);
+	measurement best = { 0, 0 };
+	for( int rep=0; rep!=5; ++rep )
+	{
+		int val = 0;
+		unsigned long allocations = allocation_count;
+		auto start = std::chrono::steady_clock::now();
+		for( int i=0; i<iteration_count; i+=batch_size )
+		{
+			std::thread worker( [&]
+				{
+					for( int j=0; j!=batch_size; ++j )
+						results.push_back(f(i+j));
+				} );
+			worker.join();
+			for( auto & r : results )
+				val += handle(r);
+			results.clear();
+		}
+		auto stop = std::chrono::steady_clock::now();
+		allocations = allocation_count - allocations;
+		if( val==42 )
+			std::cout << ' ';
+		double ns = std::chrono::duration<double, std::nano>(stop-start).count() / iteration_count;
+		if( rep==0 || ns<best.ns )
+			best = { ns, double(allocations) / iteration_count };
+	}
+	return best;
+}
+
+NOINLINE leaf::result<int> run_async( int x ) noexcept
+{
+	return leaf::capture(leaf::make_shared_context(&error_handler), &task, x);
+}
+
+int main()
+{
+	int const iteration_count = 1000000;
+	measurement success = measure(iteration_count, [](int i) { return run(i); });
+	measurement failure = measure(iteration_count, [](int i) { return run(-i-1); });
+	measurement async_success = measure_async(iteration_count, [](int i) { return run_async(i); });
+	measurement async_failure = measure_async(iteration_count, [](int i) { return run_async(-i-1); });
+	std::cout <<
+		iteration_count << " tasks, LEAF_CONTEXT_POOL_SIZE=" << LEAF_CONTEXT_POOL_SIZE << "\n"
+		"Task          | ns per task | allocations per task\n"
+		"--------------|-------------|---------------------\n" <<
+		std::fixed << std::setprecision(2) <<
+		"Success       |" << std::setw(12) << success.ns << " |" << std::setw(21) << success.allocations << "\n"
+		"Failure       |" << std::setw(12) << failure.ns << " |" << std::setw(21) << failure.allocations << "\n"
+		"Async success |" << std::setw(12) << async_success.ns << " |" << std::setw(21) << async_success.allocations << "\n"
+		"Async failure |" << std::setw(12) << async_failure.ns << " |" << std::setw(21) << async_failure.allocations << '\n';
+	return 0;
+}
@@ -49,7 +49,13 @@ namespace boost
 
 namespace leaf = boost::leaf;
 
-#define USING_RESULT_TYPE "leaf::result<T>"
+#if defined(LEAF_USE_64BIT_ERROR_ID)
+#	define USING_RESULT_TYPE "leaf::result<T> (64-bit error ID)"
+#elif defined(LEAF_NO_CAPTURE_IN_RESULT)
+#	define USING_RESULT_TYPE "leaf::result<T> (no capture)"
+#else
+#	define USING_RESULT_TYPE "leaf::result<T>"
+#endif
 
 //////////////////////////////////////
 
@@ -246,13 +252,37 @@ int benchmark_type( char const * type_name, int iteration_count )
 
 //////////////////////////////////////
 
+// Under the Itanium C++ ABI, a type of at most 16 bytes with trivial copy
+// constructors and destructor is returned in registers; otherwise it is
+// returned through memory.
+template <class R>
+void print_result_abi( char const * type_name )
+{
+	bool const trivially_copyable = std::is_trivially_copyable<R>::value;
+	bool const trivially_destructible = std::is_trivially_destructible<R>::value;
+	std::cout << std::left << std::setw(24) << type_name << "| " <<
+		std::setw(7) << sizeof(R) << "| " <<
+		std::setw(19) << (trivially_copyable ? "yes" : "no") << "| " <<
+		std::setw(23) << (trivially_destructible ? "yes" : "no") << "| " <<
+		(trivially_copyable && trivially_destructible && sizeof(R)<=16 ? "registers" : "memory") << '\n';
+}
+
 int main()
 {
 	int const depth = 10;
 	int const iteration_count = 10000;
 	std::cout <<
 		iteration_count << " iterations, call depth " << depth << ", sizeof(e_heavy_payload) = " << sizeof(e_heavy_payload) << "\n"
-		USING_RESULT_TYPE "\n"
+		USING_RESULT_TYPE ":\n"
+		"Type                    | sizeof | Trivially copyable | Trivially destructible | Returned in (Itanium ABI)\n"
+		"------------------------|--------|--------------------|------------------------|--------------------------\n";
+	print_result_abi<leaf::result<int>>("result<int>");
+	print_result_abi<leaf::result<float>>("result<float>");
+	print_result_abi<leaf::result<void>>("result<void>");
+	print_result_abi<leaf::nocapture_result<int>>("nocapture_result<int>");
+	print_result_abi<leaf::nocapture_result<float>>("nocapture_result<float>");
+	print_result_abi<leaf::nocapture_result<void>>("nocapture_result<void>");
+	std::cout << "\n"
 		"Error type      |  2% (μs) | 98% (μs)\n"
 		"----------------|----------|---------";
 	int r = 0;
@@ -0,0 +1,192 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// This benchmark measures the cost of recording the path an error takes through a
+// chain of functions, using leaf::accumulate with a std::deque of source locations
+// (as in examples/error_trace.cpp) vs. LEAF_ERROR_TRACE, which records into the
+// fixed-capacity leaf::e_error_trace. It also counts the number of dynamic memory
+// allocations per error.
+
+#ifndef LEAF_ALL_HPP_INCLUDED
+#	include <boost/leaf/all.hpp>
+#endif
+
+#ifdef _MSC_VER
+#	define NOINLINE __declspec(noinline)
+#else
+#	define NOINLINE __attribute__((noinline))
+#endif
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <deque>
+#include <cstdlib>
+#include <new>
+
+namespace leaf = boost::leaf;
+
+#ifdef LEAF_NO_EXCEPTIONS
+namespace boost
+{
+	void throw_exception( std::exception const & e )
+	{
+		std::cerr << "Terminating due to a C++ exception under LEAF_NO_EXCEPTIONS: " << e.what();
+		std::terminate();
+	}
+}
+#endif
+
+//////////////////////////////////////
+
+unsigned long allocation_count;
+
+void * operator new( std::size_t size )
+{
+	++allocation_count;
+	if( void * p = std::malloc(size) )
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete( void * p ) noexcept
+{
+	std::free(p);
+}
+
+void operator delete( void * p, std::size_t ) noexcept
+{
+	std::free(p);
+}
+
+//////////////////////////////////////
+
+struct e_deque_trace
+{
+	struct rec
+	{
+		char const * file;
+		int line;
+	};
+
+	std::deque<rec> value;
+};
+
+int const depth = 30;
+
+template <int Depth>
+struct deque_chain
+{
+	NOINLINE static leaf::result<int> f( int x ) noexcept
+	{
+		auto trace = leaf::accumulate( []( e_deque_trace & tr ) { tr.value.emplace_front(e_deque_trace::rec{__FILE__, __LINE__}); } );
+		return deque_chain<Depth-1>::f(x);
+	}
+};
+
+template <>
+struct deque_chain<0>
+{
+	NOINLINE static leaf::result<int> f( int x ) noexcept
+	{
+		return leaf::new_error();
+	}
+};
+
+template <int Depth>
+struct trace_chain
+{
+	NOINLINE static leaf::result<int> f( int x ) noexcept
+	{
+		LEAF_ERROR_TRACE;
+		return trace_chain<Depth-1>::f(x);
+	}
+};
+
+template <>
+struct trace_chain<0>
+{
+	NOINLINE static leaf::result<int> f( int x ) noexcept
+	{
+		return leaf::new_error();
+	}
+};
+
+NOINLINE int run_deque( int x ) noexcept
+{
+	return leaf::try_handle_all(
+		[=]
+		{
+			return deque_chain<depth>::f(x);
+		},
+		[]( e_deque_trace const & tr )
+		{
+			return int(tr.value.size());
+		},
+		[]
+		{
+			return -1;
+		} );
+}
+
+NOINLINE int run_trace( int x ) noexcept
+{
+	return leaf::try_handle_all(
+		[=]
+		{
+			return trace_chain<depth>::f(x);
+		},
+		[]( leaf::e_error_trace const & tr )
+		{
+			return tr.size();
+		},
+		[]
+		{
+			return -1;
+		} );
+}
+
+struct measurement
+{
+	double ns;
+	double allocations;
+};
+
+template <class F>
+measurement measure( int iteration_count, F f )
+{
+	measurement best = { 0, 0 };
+	for( int rep=0; rep!=5; ++rep )
+	{
+		int val = 0;
+		unsigned long allocations = allocation_count;
+		auto start = std::chrono::steady_clock::now();
+		for( int i=0; i!=iteration_count; ++i )
+			val += f(i);
+		auto stop = std::chrono::steady_clock::now();
+		allocations = allocation_count - allocations;
+		if( val==42 )
+			std::cout << ' ';
+		double ns = std::chrono::duration<double, std::nano>(stop-start).count() / iteration_count;
+		if( rep==0 || ns<best.ns )
+			best = { ns, double(allocations) / iteration_count };
+	}
+	return best;
+}
+
+int main()
+{
+	int const iteration_count = 100000;
+	measurement d = measure(iteration_count, &run_deque);
+	measurement t = measure(iteration_count, &run_trace);
+	std::cout <<
+		iteration_count << " errors, " << depth << " functions deep, e_error_trace capacity " << leaf::e_error_trace::capacity() << "\n"
+		"Trace                     | ns per error | allocations per error\n"
+		"--------------------------|--------------|----------------------\n" <<
+		std::fixed << std::setprecision(2) <<
+		"accumulate + std::deque   |" << std::setw(13) << d.ns << " |" << std::setw(22) << d.allocations << "\n"
+		"LEAF_ERROR_TRACE          |" << std::setw(13) << t.ns << " |" << std::setw(22) << t.allocations << '\n';
+	return 0;
+}
@@ -0,0 +1,102 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// This benchmark measures how many diagnostic_info / verbose_diagnostic_info records
+// per second can be formatted and written to a file, using operator<< directly on a
+// std::ofstream, format_to_buffer (followed by a single write), and format_to_sink.
+
+#ifndef LEAF_ALL_HPP_INCLUDED
+#	include <boost/leaf/all.hpp>
+#endif
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cstdio>
+
+namespace leaf = boost::leaf;
+
+#ifdef LEAF_NO_EXCEPTIONS
+namespace boost
+{
+	void throw_exception( std::exception const & e )
+	{
+		std::cerr << "Terminating due to a C++ exception under LEAF_NO_EXCEPTIONS: " << e.what();
+		std::terminate();
+	}
+}
+#endif
+
+//////////////////////////////////////
+
+template <int N>
+struct e_info
+{
+	int value;
+};
+
+char const temp_file_name[] = "format_diagnostic.tmp";
+
+template <class F>
+double records_per_second( int iteration_count, F && f )
+{
+	auto start = std::chrono::steady_clock::now();
+	for( int i=0; i!=iteration_count; ++i )
+		f();
+	auto stop = std::chrono::steady_clock::now();
+	return iteration_count / std::chrono::duration<double>(stop-start).count();
+}
+
+template <class Info>
+void benchmark( char const * name, Info const & x )
+{
+	int const iteration_count = 100000;
+	std::ofstream out(temp_file_name, std::ios::binary);
+	double stream = records_per_second(iteration_count, [&]
+		{
+			out << x;
+		} );
+	double buffer = records_per_second(iteration_count, [&]
+		{
+			char buf[2048];
+			std::size_t n = leaf::format_to_buffer(buf, sizeof(buf), x);
+			out.write(buf, n);
+		} );
+	double sink = records_per_second(iteration_count, [&]
+		{
+			leaf::format_to_sink(
+				[&]( char const * s, std::size_t n )
+				{
+					out.write(s, n);
+				}, x );
+		} );
+	std::cout << std::left << std::setw(25) << name << " |" << std::right << std::fixed << std::setprecision(0) <<
+		std::setw(11) << stream << " |" <<
+		std::setw(17) << buffer << " |" <<
+		std::setw(15) << sink << '\n';
+}
+
+int main()
+{
+	std::cout <<
+		"Records per second        | operator<< | format_to_buffer | format_to_sink\n"
+		"--------------------------|------------|------------------|---------------\n";
+	leaf::try_handle_all(
+		[]() -> leaf::result<void>
+		{
+			return leaf::new_error(e_info<1>{1}, e_info<2>{2}, e_info<3>{3}, e_info<4>{4}, e_info<5>{5}, e_info<6>{6});
+		},
+		[]( e_info<1> const &, e_info<2> const &, leaf::diagnostic_info const & di, leaf::verbose_diagnostic_info const & vdi )
+		{
+			benchmark("diagnostic_info", di);
+			benchmark("verbose_diagnostic_info", vdi);
+		},
+		[]
+		{
+		} );
+	std::remove(temp_file_name);
+	return 0;
+}
@@ -0,0 +1,152 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// This benchmark measures the cost of selecting a handler in handle_all as a function
+// of the number of handlers. Each handler takes an E-object common to all handlers,
+// and two E-objects each shared with the neighbouring handlers. Only the last handler
+// (before the match-all one) matches, so every other handler has to be rejected
+// before the matching one is found. The E-objects are loaded once; the loop only
+// measures handle_all. Build with and without LEAF_HANDLER_PRESENCE_MASK to compare
+// checking each handler argument in turn with testing a mask of available E-objects,
+// both with full optimization and with the handler checks not inlined (e.g. -Og,
+// -O0 or -fno-inline), see the handler_count*_og targets in meson.build.
+
+#ifndef LEAF_ALL_HPP_INCLUDED
+#	include <boost/leaf/all.hpp>
+#endif
+
+#ifdef _MSC_VER
+#	define NOINLINE __declspec(noinline)
+#else
+#	define NOINLINE __attribute__((noinline))
+#endif
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+namespace leaf = boost::leaf;
+
+#ifdef LEAF_NO_EXCEPTIONS
+namespace boost
+{
+	void throw_exception( std::exception const & e )
+	{
+		std::cerr << "Terminating due to a C++ exception under LEAF_NO_EXCEPTIONS: " << e.what();
+		std::terminate();
+	}
+}
+#endif
+
+//////////////////////////////////////
+
+template <int N>
+struct e_info
+{
+	int value;
+};
+
+struct e_common
+{
+	int value;
+};
+
+#ifdef LEAF_HANDLER_PRESENCE_MASK
+char const handler_selection[] = "presence mask (LEAF_HANDLER_PRESENCE_MASK)";
+#else
+char const handler_selection[] = "argument by argument";
+#endif
+
+template <int I>
+struct handler
+{
+	int operator()( e_common const & c, e_info<I> const & a, e_info<I+1> const & b ) const
+	{
+		return c.value + a.value + b.value + I;
+	}
+};
+
+template <int... I>
+struct int_seq
+{
+};
+
+template <int N, int... I>
+struct make_int_seq: make_int_seq<N-1, N-1, I...>
+{
+};
+
+template <int... I>
+struct make_int_seq<0, I...>
+{
+	using type = int_seq<I...>;
+};
+
+template <int... I>
+leaf::context_type_from_handlers<handler<I>...> make_context( int_seq<I...> )
+{
+	return { };
+}
+
+template <class Ctx, int... I>
+NOINLINE int handle( Ctx const & ctx, leaf::result<int> & r, int_seq<I...> ) noexcept
+{
+	return ctx.handle_all( r,
+		handler<I>()...,
+		[]
+		{
+			return 0;
+		} );
+}
+
+template <int N>
+double ns_per_error( int iteration_count )
+{
+	using seq = typename make_int_seq<N>::type;
+	auto ctx = make_context(seq());
+	leaf::error_id id;
+	{
+		auto active_context = activate_context(ctx, leaf::on_deactivation::do_not_propagate);
+		id = leaf::new_error(e_common{0}, e_info<N-1>{1}, e_info<N>{2});
+	}
+	leaf::result<int> r(id);
+	double best = 0;
+	for( int rep=0; rep!=5; ++rep )
+	{
+		int val = 0;
+		auto start = std::chrono::steady_clock::now();
+		for( int i=0; i!=iteration_count; ++i )
+			val += handle(ctx, r, seq());
+		auto stop = std::chrono::steady_clock::now();
+		if( val==42 )
+			std::cout << ' ';
+		double ns = std::chrono::duration<double, std::nano>(stop-start).count() / iteration_count;
+		if( rep==0 || ns<best )
+			best = ns;
+	}
+	return best;
+}
+
+template <int N>
+void benchmark( int iteration_count )
+{
+	std::cout << std::setw(8) << N << " |" << std::setw(14) << std::fixed << std::setprecision(2) << ns_per_error<N>(iteration_count) << '\n';
+}
+
+int main()
+{
+	int const iteration_count = 1000000;
+	std::cout <<
+		iteration_count << " iterations, handler selection: " << handler_selection << "\n"
+		"Handlers | handle_all (ns)\n"
+		"---------|----------------\n";
+	benchmark<1>(iteration_count);
+	benchmark<5>(iteration_count);
+	benchmark<10>(iteration_count);
+	benchmark<20>(iteration_count);
+	benchmark<40>(iteration_count);
+	benchmark<60>(iteration_count);
+	return 0;
+}
@@ -0,0 +1,128 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// This benchmark compares passing an E-object which is expensive to create (a
+// formatted string) to new_error, with passing a function which creates it. The
+// function is only called if a context that can store the E-object is active,
+// so when the error is handled without the E-object, nothing is created.
+
+#ifndef LEAF_ALL_HPP_INCLUDED
+#	include <boost/leaf/all.hpp>
+#endif
+
+#ifdef _MSC_VER
+#	define NOINLINE __declspec(noinline)
+#else
+#	define NOINLINE __attribute__((noinline))
+#endif
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+namespace leaf = boost::leaf;
+
+#ifdef LEAF_NO_EXCEPTIONS
+namespace boost
+{
+	void throw_exception( std::exception const & e )
+	{
+		std::cerr << "Terminating due to a C++ exception under LEAF_NO_EXCEPTIONS: " << e.what();
+		std::terminate();
+	}
+}
+#endif
+
+//////////////////////////////////////
+
+struct e_request_info
+{
+	std::string value;
+};
+
+struct e_error_code
+{
+	int value;
+};
+
+e_request_info format_request_info( int x )
+{
+	return e_request_info{ "GET /api/v1/resource/" + std::to_string(x) + " HTTP/1.1, Host: example.com, User-Agent: benchmark" };
+}
+
+NOINLINE leaf::result<int> f_eager( int x ) noexcept
+{
+	return leaf::new_error(e_error_code{x}, format_request_info(x));
+}
+
+NOINLINE leaf::result<int> f_lazy( int x ) noexcept
+{
+	return leaf::new_error(e_error_code{x}, [=] { return format_request_info(x); });
+}
+
+template <leaf::result<int> (*F)( int )>
+NOINLINE int handled( int x ) noexcept
+{
+	return leaf::try_handle_all(
+		[=]
+		{
+			return F(x);
+		},
+		[]( e_error_code const & ec, e_request_info const & ri )
+		{
+			return ec.value + int(ri.value.size());
+		},
+		[]
+		{
+			return 0;
+		} );
+}
+
+template <leaf::result<int> (*F)( int )>
+NOINLINE int unhandled( int x ) noexcept
+{
+	return leaf::try_handle_all(
+		[=]
+		{
+			return F(x);
+		},
+		[]( e_error_code const & ec )
+		{
+			return ec.value;
+		},
+		[]
+		{
+			return 0;
+		} );
+}
+
+//////////////////////////////////////
+
+template <class F>
+double ns_per_call( int iteration_count, F f )
+{
+	int val = 0;
+	auto start = std::chrono::steady_clock::now();
+	for( int i=0; i!=iteration_count; ++i )
+		val += f(i);
+	auto stop = std::chrono::steady_clock::now();
+	if( val==42 )
+		std::cout << ' ';
+	return std::chrono::duration<double, std::nano>(stop-start).count() / iteration_count;
+}
+
+int main()
+{
+	int const iteration_count = 1000000;
+	std::cout <<
+		iteration_count << " iterations\n"
+		"e_request_info   | Eager (ns) | Lazy (ns)\n"
+		"-----------------|------------|----------\n" <<
+		std::fixed << std::setprecision(2) <<
+		"Handled          |" << std::setw(11) << ns_per_call(iteration_count, &handled<&f_eager>) << " |" << std::setw(10) << ns_per_call(iteration_count, &handled<&f_lazy>) << "\n"
+		"Not handled      |" << std::setw(11) << ns_per_call(iteration_count, &unhandled<&f_eager>) << " |" << std::setw(10) << ns_per_call(iteration_count, &unhandled<&f_lazy>) << '\n';
+	return 0;
+}
@@ -0,0 +1,125 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// This benchmark measures the cost of checking a value with match<E, V...>, as
+// a function of the number of values in V... The values are every other
+// enumerator of a 64-value enum, and the checked values are pseudo-random, so
+// about half of the checks succeed for the larger packs. Build with
+// LEAF_MATCH_LOOKUP_TABLE_MIN=0 to compare with a chain of == comparisons.
+
+#ifndef LEAF_ALL_HPP_INCLUDED
+#	include <boost/leaf/all.hpp>
+#endif
+
+#ifdef _MSC_VER
+#	define NOINLINE __declspec(noinline)
+#else
+#	define NOINLINE __attribute__((noinline))
+#endif
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+
+namespace leaf = boost::leaf;
+
+#ifdef LEAF_NO_EXCEPTIONS
+namespace boost
+{
+	void throw_exception( std::exception const & e )
+	{
+		std::cerr << "Terminating due to a C++ exception under LEAF_NO_EXCEPTIONS: " << e.what();
+		std::terminate();
+	}
+}
+#endif
+
+//////////////////////////////////////
+
+enum class protocol_error
+{
+	first,
+	last = 63
+};
+
+template <int... I>
+struct int_seq
+{
+};
+
+template <int N, int... I>
+struct make_int_seq: make_int_seq<N-1, N-1, I...>
+{
+};
+
+template <int... I>
+struct make_int_seq<0, I...>
+{
+	using type = int_seq<I...>;
+};
+
+int const value_count = 4096;
+protocol_error values[value_count];
+protocol_error const * volatile values_ptr = values;
+
+template <int... I>
+NOINLINE int count_matches( int_seq<I...>, protocol_error const * v ) noexcept
+{
+	using m = leaf::match<protocol_error, protocol_error(2*I)...>;
+	int n = 0;
+	for( int i=0; i!=value_count; ++i )
+		n += m(&v[i])();
+	return n;
+}
+
+template <int N>
+double ns_per_match( int iteration_count )
+{
+	using seq = typename make_int_seq<N>::type;
+	double best = 0;
+	for( int rep=0; rep!=5; ++rep )
+	{
+		int val = 0;
+		auto start = std::chrono::steady_clock::now();
+		for( int i=0; i!=iteration_count; ++i )
+			val += count_matches(seq(), values_ptr);
+		auto stop = std::chrono::steady_clock::now();
+		if( val==42 )
+			std::cout << ' ';
+		double ns = std::chrono::duration<double, std::nano>(stop-start).count() / iteration_count / value_count;
+		if( rep==0 || ns<best )
+			best = ns;
+	}
+	return best;
+}
+
+template <int N>
+void benchmark( int iteration_count )
+{
+	std::cout << std::setw(6) << N << " |" << std::setw(10) << std::fixed << std::setprecision(2) << ns_per_match<N>(iteration_count) << '\n';
+}
+
+int main()
+{
+	std::uint32_t x = 12345;
+	for( int i=0; i!=value_count; ++i )
+	{
+		x = x * 1664525u + 1013904223u;
+		values[i] = protocol_error(x >> 26);
+	}
+	int const iteration_count = 2000;
+	std::cout <<
+		iteration_count*value_count << " checks, LEAF_MATCH_LOOKUP_TABLE_MIN=" << LEAF_MATCH_LOOKUP_TABLE_MIN << "\n"
+		"Values | match (ns)\n"
+		"-------|-----------\n";
+	benchmark<1>(iteration_count);
+	benchmark<2>(iteration_count);
+	benchmark<4>(iteration_count);
+	benchmark<8>(iteration_count);
+	benchmark<16>(iteration_count);
+	benchmark<32>(iteration_count);
+	return 0;
+}
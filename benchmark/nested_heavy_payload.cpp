@@ -0,0 +1,145 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// This benchmark measures the cost of a 4 KiB E-type which is requested by error
+// handlers at several levels of nested try_handle_some calls. Each level reserves
+// storage for the E-object in its context; in case of a failure the E-object is
+// propagated through all levels before it reaches the handler in try_handle_all.
+// Compile with LEAF_SLOT_HEAP_THRESHOLD defined (e.g. to 256) to store the E-object
+// out of line instead.
+
+#ifndef LEAF_ALL_HPP_INCLUDED
+#	include <boost/leaf/all.hpp>
+#endif
+
+#ifdef _MSC_VER
+#	define NOINLINE __declspec(noinline)
+#else
+#	define NOINLINE __attribute__((noinline))
+#endif
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <array>
+
+namespace leaf = boost::leaf;
+
+#ifdef LEAF_NO_EXCEPTIONS
+namespace boost
+{
+	void throw_exception( std::exception const & e )
+	{
+		std::cerr << "Terminating due to a C++ exception under LEAF_NO_EXCEPTIONS: " << e.what();
+		std::terminate();
+	}
+}
+#endif
+
+//////////////////////////////////////
+
+struct e_heavy_payload
+{
+	std::array<char, 4096> value;
+};
+
+struct e_never
+{
+	int value;
+};
+
+template <int Depth>
+struct nest
+{
+	NOINLINE static leaf::result<int> f( int x ) noexcept
+	{
+		return leaf::try_handle_some(
+			[=]
+			{
+				return nest<Depth-1>::f(x);
+			},
+			[]( e_heavy_payload const & e, e_never const & ) -> leaf::result<int>
+			{
+				// e_never is never loaded, so this handler doesn't match and the
+				// e_heavy_payload object propagates to the enclosing context.
+				return e.value[0];
+			} );
+	}
+};
+
+template <>
+struct nest<0>
+{
+	NOINLINE static leaf::result<int> f( int x ) noexcept
+	{
+		if( x<0 )
+		{
+			e_heavy_payload e;
+			e.value[0] = char(x);
+			return leaf::new_error(std::move(e));
+		}
+		else
+			return x;
+	}
+};
+
+template <int Depth>
+NOINLINE int run( int x ) noexcept
+{
+	return leaf::try_handle_all(
+		[=]
+		{
+			return nest<Depth-1>::f(x);
+		},
+		[]( e_heavy_payload const & e )
+		{
+			return int(e.value[0]);
+		},
+		[]
+		{
+			return 0;
+		} );
+}
+
+//////////////////////////////////////
+
+template <class F>
+double ns_per_call( int iteration_count, F f )
+{
+	int val = 0;
+	auto start = std::chrono::steady_clock::now();
+	for( int i=0; i!=iteration_count; ++i )
+		val += f(i);
+	auto stop = std::chrono::steady_clock::now();
+	if( val==42 )
+		std::cout << ' ';
+	return std::chrono::duration<double, std::nano>(stop-start).count() / iteration_count;
+}
+
+template <int Depth>
+void benchmark_depth( int iteration_count )
+{
+	std::cout <<
+		std::right << std::setw(5) << Depth << " |" <<
+		std::setw(13) << ns_per_call(iteration_count, [](int i) { return run<Depth>(i); }) << " |" <<
+		std::setw(13) << ns_per_call(iteration_count, [](int i) { return run<Depth>(-i-1); }) << '\n';
+}
+
+int main()
+{
+	int const iteration_count = 1000000;
+	std::cout <<
+		iteration_count << " iterations, sizeof(e_heavy_payload) = " << sizeof(e_heavy_payload) <<
+		", LEAF_SLOT_HEAP_THRESHOLD = " << LEAF_SLOT_HEAP_THRESHOLD << "\n"
+		"Depth | Success (ns) | Failure (ns)\n"
+		"------|--------------|-------------\n" <<
+		std::fixed << std::setprecision(2);
+	benchmark_depth<1>(iteration_count);
+	benchmark_depth<2>(iteration_count);
+	benchmark_depth<4>(iteration_count);
+	benchmark_depth<8>(iteration_count);
+	benchmark_depth<16>(iteration_count);
+	return 0;
+}
@@ -0,0 +1,91 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// This benchmark measures the cost of new_error() when called concurrently from an
+// increasing number of threads, simulating an error storm. Compile with different
+// values of LEAF_ID_BLOCK_SIZE to compare the contention on the global ID counter.
+
+#ifndef LEAF_ALL_HPP_INCLUDED
+#	include <boost/leaf/all.hpp>
+#endif
+
+#ifdef LEAF_NO_THREADS
+#	error This benchmark requires thread support.
+#endif
+
+#ifdef _MSC_VER
+#	define NOINLINE __declspec(noinline)
+#else
+#	define NOINLINE __attribute__((noinline))
+#endif
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+namespace leaf = boost::leaf;
+
+#ifdef LEAF_NO_EXCEPTIONS
+namespace boost
+{
+	void throw_exception( std::exception const & e )
+	{
+		std::cerr << "Terminating due to a C++ exception under LEAF_NO_EXCEPTIONS: " << e.what();
+		std::terminate();
+	}
+}
+#endif
+
+//////////////////////////////////////
+
+NOINLINE leaf::error_id f() noexcept
+{
+	return leaf::new_error();
+}
+
+double ns_per_call( int thread_count, int iteration_count )
+{
+	std::vector<std::thread> threads;
+	threads.reserve(thread_count);
+	std::vector<double> elapsed(thread_count);
+	for( int t=0; t!=thread_count; ++t )
+		threads.emplace_back(
+			[=, &elapsed]
+			{
+				int val = 0;
+				auto start = std::chrono::steady_clock::now();
+				for( int i=0; i!=iteration_count; ++i )
+					val ^= f().value();
+				auto stop = std::chrono::steady_clock::now();
+				elapsed[t] = std::chrono::duration<double, std::nano>(stop-start).count() / iteration_count;
+				if( val==42 )
+					std::cout << ' ';
+			} );
+	for( auto & t : threads )
+		t.join();
+	return *std::max_element(elapsed.begin(), elapsed.end());
+}
+
+int main()
+{
+	int const iteration_count = 10000000;
+	int max_threads = std::max(1u, std::thread::hardware_concurrency());
+	std::cout <<
+		iteration_count << " calls to new_error() per thread (worst thread shown), LEAF_ID_BLOCK_SIZE = " << LEAF_ID_BLOCK_SIZE << "\n"
+		"Threads | new_error (ns)\n"
+		"--------|---------------\n";
+	for( int n=1; ; n*=2 )
+	{
+		if( n>max_threads )
+			n = max_threads;
+		std::cout << std::right << std::setw(7) << n << " |" << std::setw(14) << std::fixed << std::setprecision(2) << ns_per_call(n, iteration_count) << '\n';
+		if( n==max_threads )
+			break;
+	}
+	return 0;
+}
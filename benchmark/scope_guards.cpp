@@ -0,0 +1,161 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// This benchmark measures the overhead of preload / defer / accumulate scope guards
+// when no error occurs. Each call goes through a chain of functions, and each function
+// registers the same four items (two preloaded E-objects, one deferred and one
+// accumulating function), either with separate preload, defer and accumulate guards,
+// or with a single on_error guard. The baseline runs the same chain without guards.
+
+#ifndef LEAF_ALL_HPP_INCLUDED
+#	include <boost/leaf/all.hpp>
+#endif
+
+#ifdef _MSC_VER
+#	define NOINLINE __declspec(noinline)
+#else
+#	define NOINLINE __attribute__((noinline))
+#endif
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+namespace leaf = boost::leaf;
+
+#ifdef LEAF_NO_EXCEPTIONS
+namespace boost
+{
+	void throw_exception( std::exception const & e )
+	{
+		std::cerr << "Terminating due to a C++ exception under LEAF_NO_EXCEPTIONS: " << e.what();
+		std::terminate();
+	}
+}
+#endif
+
+//////////////////////////////////////
+
+template <int N>
+struct e_info
+{
+	int value;
+};
+
+struct e_retries
+{
+	int value;
+};
+
+enum class guards
+{
+	none,
+	separate,
+	combined
+};
+
+int const depth = 8;
+
+template <guards G, int Depth, bool = Depth==0>
+struct chain;
+
+template <int Depth>
+struct chain<guards::none, Depth, false>
+{
+	NOINLINE static leaf::result<int> f( int x ) noexcept
+	{
+		return chain<guards::none, Depth-1>::f(x+1);
+	}
+};
+
+template <int Depth>
+struct chain<guards::separate, Depth, false>
+{
+	NOINLINE static leaf::result<int> f( int x ) noexcept
+	{
+		auto p1 = leaf::preload(e_info<1>{x});
+		auto p2 = leaf::preload(e_info<2>{Depth});
+		auto d = leaf::defer([x]{ return e_info<3>{x*2}; });
+		auto a = leaf::accumulate([]( e_retries & r ){ ++r.value; });
+		return chain<guards::separate, Depth-1>::f(x+1);
+	}
+};
+
+template <int Depth>
+struct chain<guards::combined, Depth, false>
+{
+	NOINLINE static leaf::result<int> f( int x ) noexcept
+	{
+		auto g = leaf::on_error(
+			e_info<1>{x},
+			e_info<2>{Depth},
+			[x]{ return e_info<3>{x*2}; },
+			[]( e_retries & r ){ ++r.value; } );
+		return chain<guards::combined, Depth-1>::f(x+1);
+	}
+};
+
+template <guards G, int Depth>
+struct chain<G, Depth, true>
+{
+	NOINLINE static leaf::result<int> f( int x ) noexcept
+	{
+		if( x<0 )
+			return leaf::new_error();
+		return x;
+	}
+};
+
+template <guards G>
+NOINLINE int run( int x ) noexcept
+{
+	return leaf::try_handle_all(
+		[=]
+		{
+			return chain<G, depth>::f(x);
+		},
+		[]( e_info<1> const & a, e_info<2> const & b, e_info<3> const & c, e_retries const & r )
+		{
+			return a.value + b.value + c.value + r.value;
+		},
+		[]
+		{
+			return -1;
+		} );
+}
+
+template <guards G>
+double ns_per_call( int iteration_count )
+{
+	double best = 0;
+	for( int rep=0; rep!=5; ++rep )
+	{
+		int val = 0;
+		auto start = std::chrono::steady_clock::now();
+		for( int i=0; i!=iteration_count; ++i )
+			val += run<G>(i);
+		auto stop = std::chrono::steady_clock::now();
+		if( val==42 )
+			std::cout << ' ';
+		double ns = std::chrono::duration<double, std::nano>(stop-start).count() / iteration_count;
+		if( rep==0 || ns<best )
+			best = ns;
+	}
+	return best;
+}
+
+int main()
+{
+	int const iteration_count = 1000000;
+	std::cout <<
+		iteration_count << " successful calls, " << depth << " functions deep, 4 items per function\n"
+		"No guards (ns) | preload + defer + accumulate (ns) | on_error (ns)\n"
+		"---------------|-----------------------------------|--------------\n" <<
+		std::fixed << std::setprecision(2) <<
+		std::setw(14) << ns_per_call<guards::none>(iteration_count) << " |" <<
+		std::setw(34) << ns_per_call<guards::separate>(iteration_count) << " |" <<
+		std::setw(13) << ns_per_call<guards::combined>(iteration_count) << '\n';
+	return 0;
+}
@@ -0,0 +1,137 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// This benchmark measures how many captured contexts per second can be transferred
+// to a receiving context: serialize into a buffer, deserialize into a fresh context
+// and handle the error with remote_handle_all. For comparison, it also measures how
+// many contexts per second can be printed (which only produces text, and cannot be
+// used to recover the E-objects).
+
+#ifndef LEAF_ALL_HPP_INCLUDED
+#	include <boost/leaf/all.hpp>
+#endif
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+namespace leaf = boost::leaf;
+
+#ifdef LEAF_NO_EXCEPTIONS
+namespace boost
+{
+	void throw_exception( std::exception const & e )
+	{
+		std::cerr << "Terminating due to a C++ exception under LEAF_NO_EXCEPTIONS: " << e.what();
+		std::terminate();
+	}
+}
+#endif
+
+//////////////////////////////////////
+
+template <int N>
+struct e_info
+{
+	int value;
+};
+
+struct e_message
+{
+	std::string value;
+};
+
+namespace boost { namespace leaf {
+
+	template <int N>
+	struct serialization<e_info<N>>: trivial_serialization<e_info<N>>
+	{
+	};
+
+	template <>
+	struct serialization<e_message>
+	{
+		static void write( serialization_writer & w, e_message const & e )
+		{
+			w.write_string(e.value);
+		}
+
+		static bool read( serialization_reader & r, e_message & e )
+		{
+			return r.read_string(e.value);
+		}
+	};
+
+} }
+
+auto handle_error = []( leaf::error_info const & error )
+{
+	return leaf::remote_handle_all( error,
+		[]( e_info<1> const & x1, e_info<2> const & x2, e_info<3> const & x3, e_info<4> const & x4, e_message const & m )
+		{
+			return x1.value + x2.value + x3.value + x4.value + int(m.value.size());
+		},
+		[]
+		{
+			return -1;
+		} );
+};
+
+template <class F>
+double contexts_per_second( int iteration_count, F && f )
+{
+	int val = 0;
+	auto start = std::chrono::steady_clock::now();
+	for( int i=0; i!=iteration_count; ++i )
+		val += f();
+	auto stop = std::chrono::steady_clock::now();
+	if( val==42 )
+		std::cout << ' ';
+	return iteration_count / std::chrono::duration<double>(stop-start).count();
+}
+
+int main()
+{
+	int const iteration_count = 1000000;
+
+	auto ctx = leaf::make_shared_context(&handle_error);
+	ctx->activate();
+	ctx->captured_id_ = leaf::new_error(e_info<1>{1}, e_info<2>{2}, e_info<3>{3}, e_info<4>{4}, e_message{"file not found"});
+	ctx->deactivate(false);
+
+	char buf[256];
+	std::size_t size = leaf::serialize(*ctx, buf, sizeof(buf));
+	if( size>sizeof(buf) )
+	{
+		std::cerr << "Buffer too small\n";
+		return 1;
+	}
+
+	double round_trip = contexts_per_second(iteration_count, [&]
+		{
+			std::size_t n = leaf::serialize(*ctx, buf, sizeof(buf));
+			auto receiver = leaf::make_context(&handle_error);
+			leaf::result<int> r(leaf::deserialize(buf, n, receiver));
+			return receiver.remote_handle_all(r, handle_error);
+		} );
+
+	std::ostringstream out;
+	double print = contexts_per_second(iteration_count, [&]
+		{
+			out.str(std::string());
+			ctx->print(out);
+			return int(out.tellp());
+		} );
+
+	std::cout <<
+		iteration_count << " iterations, context with 5 E-objects, " << size << " bytes serialized\n"
+		"Contexts per second:\n"
+		"serialize + deserialize + handle | print\n"
+		"---------------------------------|-----------\n" <<
+		std::fixed << std::setprecision(0) <<
+		std::setw(32) << round_trip << " |" << std::setw(11) << print << '\n';
+	return 0;
+}
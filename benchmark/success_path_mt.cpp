@@ -0,0 +1,145 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// This benchmark measures the success path of try_handle_some (and try_catch, if
+// exception handling is enabled) executed concurrently from an increasing number of
+// threads. Since no error occurs, the time per call should not depend on the number of
+// threads: LEAF should not touch any data shared between threads.
+
+#ifndef LEAF_ALL_HPP_INCLUDED
+#	include <boost/leaf/all.hpp>
+#endif
+
+#ifdef LEAF_NO_THREADS
+#	error This benchmark requires thread support.
+#endif
+
+#ifdef _MSC_VER
+#	define NOINLINE __declspec(noinline)
+#else
+#	define NOINLINE __attribute__((noinline))
+#endif
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+namespace leaf = boost::leaf;
+
+#ifdef LEAF_NO_EXCEPTIONS
+namespace boost
+{
+	void throw_exception( std::exception const & e )
+	{
+		std::cerr << "Terminating due to a C++ exception under LEAF_NO_EXCEPTIONS: " << e.what();
+		std::terminate();
+	}
+}
+#endif
+
+//////////////////////////////////////
+
+struct e_error_code { int value; };
+
+NOINLINE leaf::result<int> f( int x ) noexcept
+{
+	if( x<0 )
+		return leaf::new_error(e_error_code{x});
+	else
+		return x;
+}
+
+NOINLINE int run_try_handle_some( int x ) noexcept
+{
+	leaf::result<int> r = leaf::try_handle_some(
+		[=]
+		{
+			return f(x);
+		},
+		[]( e_error_code const & e ) -> leaf::result<int>
+		{
+			return e.value;
+		} );
+	return r ? *r : -1;
+}
+
+#ifndef LEAF_NO_EXCEPTIONS
+
+NOINLINE int g( int x )
+{
+	if( x<0 )
+		throw leaf::exception(std::exception(), e_error_code{x});
+	return x;
+}
+
+NOINLINE int run_try_catch( int x )
+{
+	return leaf::try_catch(
+		[=]
+		{
+			return g(x);
+		},
+		[]( e_error_code const & e )
+		{
+			return e.value;
+		} );
+}
+
+#endif
+
+//////////////////////////////////////
+
+template <class F>
+double ns_per_call( int thread_count, int iteration_count, F f )
+{
+	std::vector<std::thread> threads;
+	threads.reserve(thread_count);
+	std::vector<double> elapsed(thread_count);
+	for( int t=0; t!=thread_count; ++t )
+		threads.emplace_back(
+			[=, &elapsed]
+			{
+				int val = 0;
+				auto start = std::chrono::steady_clock::now();
+				for( int i=0; i!=iteration_count; ++i )
+					val += f(i);
+				auto stop = std::chrono::steady_clock::now();
+				elapsed[t] = std::chrono::duration<double, std::nano>(stop-start).count() / iteration_count;
+				if( val==42 )
+					std::cout << ' ';
+			} );
+	for( auto & t : threads )
+		t.join();
+	return *std::max_element(elapsed.begin(), elapsed.end());
+}
+
+int main()
+{
+	int const iteration_count = 10000000;
+	int max_threads = std::max(1u, std::thread::hardware_concurrency());
+	std::cout <<
+		iteration_count << " successful calls per thread (worst thread shown)\n"
+		"Threads | try_handle_some (ns) | try_catch (ns)\n"
+		"--------|----------------------|---------------\n";
+	for( int n=1; ; n*=2 )
+	{
+		if( n>max_threads )
+			n = max_threads;
+		std::cout << std::right << std::setw(7) << n << " |";
+		std::cout << std::setw(21) << std::fixed << std::setprecision(2) << ns_per_call(n, iteration_count, &run_try_handle_some) << " |";
+#ifndef LEAF_NO_EXCEPTIONS
+		std::cout << std::setw(14) << ns_per_call(n, iteration_count, &run_try_catch);
+#else
+		std::cout << std::setw(14) << "N/A";
+#endif
+		std::cout << '\n';
+		if( n==max_threads )
+			break;
+	}
+	return 0;
+}
@@ -0,0 +1,122 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// This benchmark measures the cost of activating / deactivating a context with many
+// E-types, and of loading E-objects, when the LEAF code lives in a shared library
+// (where each access to a TLS variable typically requires a call to __tls_get_addr).
+//
+// This file is compiled twice: once into a shared library (the LEAF code being
+// measured), and once with TLS_SLOTS_DRIVER defined, into the executable that
+// calls it. Build the shared library with and without LEAF_USE_TLS_ARRAY to
+// compare the two layouts of the thread-local slot pointers.
+
+#ifdef _MSC_VER
+#	define NOINLINE __declspec(noinline)
+#	define EXPORT __declspec(dllexport)
+#	define IMPORT __declspec(dllimport)
+#else
+#	define NOINLINE __attribute__((noinline))
+#	define EXPORT __attribute__((visibility("default")))
+#	define IMPORT
+#endif
+
+#ifndef TLS_SLOTS_DRIVER
+
+#ifndef LEAF_ALL_HPP_INCLUDED
+#	include <boost/leaf/all.hpp>
+#endif
+
+#ifdef LEAF_NO_EXCEPTIONS
+namespace boost
+{
+	void throw_exception( std::exception const & e )
+	{
+		std::terminate();
+	}
+}
+#endif
+
+namespace leaf = boost::leaf;
+
+template <int N>
+struct e_info
+{
+	int value;
+};
+
+NOINLINE leaf::result<int> f( int x ) noexcept
+{
+	if( x<0 )
+		return leaf::new_error(e_info<0>{x}, e_info<1>{x}, e_info<2>{x}, e_info<3>{x}, e_info<4>{x}, e_info<5>{x}, e_info<6>{x}, e_info<7>{x});
+	else
+		return x;
+}
+
+extern "C" EXPORT int run( int x ) noexcept
+{
+	return leaf::try_handle_all(
+		[=]
+		{
+			return f(x);
+		},
+		[]( e_info<0> const & e0, e_info<1> const & e1, e_info<2> const & e2, e_info<3> const & e3 )
+		{
+			return e0.value + e1.value + e2.value + e3.value;
+		},
+		[]( e_info<4> const & e4, e_info<5> const & e5, e_info<6> const & e6, e_info<7> const & e7 )
+		{
+			return e4.value + e5.value + e6.value + e7.value;
+		},
+		[]
+		{
+			return 0;
+		} );
+}
+
+extern "C" EXPORT char const * tls_layout() noexcept
+{
+#ifdef LEAF_USE_TLS_ARRAY
+	return "single TLS array (LEAF_USE_TLS_ARRAY)";
+#else
+	return "one TLS variable per E-type";
+#endif
+}
+
+#else
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+extern "C" IMPORT int run( int x ) noexcept;
+extern "C" IMPORT char const * tls_layout() noexcept;
+
+template <class F>
+double ns_per_call( int iteration_count, F && f )
+{
+	int val = 0;
+	auto start = std::chrono::steady_clock::now();
+	for( int i=0; i!=iteration_count; ++i )
+		val += f(i);
+	auto stop = std::chrono::steady_clock::now();
+	if( val==42 )
+		std::cout << ' ';
+	return std::chrono::duration<double, std::nano>(stop-start).count() / iteration_count;
+}
+
+int main()
+{
+	int const iteration_count = 10000000;
+	std::cout <<
+		iteration_count << " iterations, context with 8 E-types, " << tls_layout() << "\n"
+		"Success (ns) | Failure (ns)\n"
+		"-------------|-------------\n" <<
+		std::fixed << std::setprecision(2) <<
+		std::setw(12) << ns_per_call(iteration_count, [](int i) { return run(i); }) << " |" <<
+		std::setw(12) << ns_per_call(iteration_count, [](int i) { return run(-i-1); }) << '\n';
+	return 0;
+}
+
+#endif
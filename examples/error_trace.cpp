@@ -11,6 +11,9 @@
 
 // This example is similar to error_log, except the path the error takes is captured and
 // recorded in a std::deque, rather than just printed in-place.
+//
+// LEAF also provides a built-in leaf::e_error_trace and a LEAF_ERROR_TRACE macro which work
+// the same way, but record into a fixed-capacity buffer, without allocating memory.
 
 #include <boost/leaf/preload.hpp>
 #include <boost/leaf/handle_error.hpp>
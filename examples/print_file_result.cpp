@@ -61,7 +61,7 @@ int main( int argc, char const * argv[] )
 		{
 			LEAF_AUTO(file_name, parse_command_line(argc,argv));
 
-			auto load = leaf::preload( leaf::e_file_name{file_name} );
+			auto load = leaf::preload_ref<leaf::e_file_name>(file_name);
 
 			LEAF_AUTO(f, file_open(file_name));
 
@@ -103,18 +103,93 @@
 
 #endif
 
+// Configure LEAF_NO_RTTI, unless already #defined
+#ifndef LEAF_NO_RTTI
+#	if defined(__GNUC__) && !defined(__GXX_RTTI)
+#		define LEAF_NO_RTTI
+#	elif defined(_MSC_VER) && !defined(_CPPRTTI)
+#		define LEAF_NO_RTTI
+#	endif
+#endif
+
 #ifndef LEAF_DIAGNOSTICS
 #	define LEAF_DIAGNOSTICS 1
 #endif
 
-#if LEAF_DIAGNOSTICS!=0 && LEAF_DIAGNOSTICS!=1
-#	error LEAF_DIAGNOSTICS must be 0 or 1.
+#if LEAF_DIAGNOSTICS!=0 && LEAF_DIAGNOSTICS!=1 && LEAF_DIAGNOSTICS!=2
+#	error LEAF_DIAGNOSTICS must be 0, 1 or 2.
+#endif
+
+#ifndef LEAF_UNEXPECTED_INFO_BUFFER_SIZE
+#	define LEAF_UNEXPECTED_INFO_BUFFER_SIZE 256
+#endif
+
+#if LEAF_UNEXPECTED_INFO_BUFFER_SIZE<1
+#	error LEAF_UNEXPECTED_INFO_BUFFER_SIZE must be greater than 0.
+#endif
+
+#ifndef LEAF_TLS_ARRAY_SIZE
+#	define LEAF_TLS_ARRAY_SIZE 64
+#endif
+
+#if LEAF_TLS_ARRAY_SIZE<1
+#	error LEAF_TLS_ARRAY_SIZE must be greater than 0.
+#endif
+
+#ifndef LEAF_SLOT_HEAP_THRESHOLD
+#	define LEAF_SLOT_HEAP_THRESHOLD 0
+#endif
+
+#if LEAF_SLOT_HEAP_THRESHOLD<0
+#	error LEAF_SLOT_HEAP_THRESHOLD must not be negative.
+#endif
+
+#ifndef LEAF_ID_BLOCK_SIZE
+#	define LEAF_ID_BLOCK_SIZE 1
+#endif
+
+#if LEAF_ID_BLOCK_SIZE<1 || (LEAF_ID_BLOCK_SIZE&(LEAF_ID_BLOCK_SIZE-1))!=0
+#	error LEAF_ID_BLOCK_SIZE must be a power of 2.
+#endif
+
+#ifndef LEAF_MATCH_LOOKUP_TABLE_MIN
+#	define LEAF_MATCH_LOOKUP_TABLE_MIN 8
+#endif
+
+#if LEAF_MATCH_LOOKUP_TABLE_MIN<0
+#	error LEAF_MATCH_LOOKUP_TABLE_MIN must not be negative.
+#endif
+
+#ifndef LEAF_ERROR_TRACE_CAPACITY
+#	define LEAF_ERROR_TRACE_CAPACITY 32
+#endif
+
+#if LEAF_ERROR_TRACE_CAPACITY<1
+#	error LEAF_ERROR_TRACE_CAPACITY must be positive.
+#endif
+
+#ifndef LEAF_CONTEXT_POOL_SIZE
+#	define LEAF_CONTEXT_POOL_SIZE 0
+#endif
+
+#if LEAF_CONTEXT_POOL_SIZE<0
+#	error LEAF_CONTEXT_POOL_SIZE must not be negative.
+#endif
+
+#ifndef LEAF_STACKTRACE_MAX_FRAMES
+#	define LEAF_STACKTRACE_MAX_FRAMES 32
+#endif
+
+#if LEAF_STACKTRACE_MAX_FRAMES<1
+#	error LEAF_STACKTRACE_MAX_FRAMES must be positive.
 #endif
 
 #ifdef _MSC_VER
 #	define LEAF_ALWAYS_INLINE __forceinline
+#	define LEAF_NOINLINE __declspec(noinline)
 #else
 #	define LEAF_ALWAYS_INLINE __attribute__((always_inline)) inline
+#	define LEAF_NOINLINE __attribute__((noinline))
 #endif
 
 #if __cplusplus > 201402L
@@ -592,12 +667,23 @@ namespace boost { namespace leaf {
 
 namespace boost { namespace leaf {
 
+	namespace leaf_detail
+	{
+#ifdef LEAF_USE_64BIT_ERROR_ID
+		using id_type = long long;
+		using unsigned_id_type = unsigned long long;
+#else
+		using id_type = int;
+		using unsigned_id_type = unsigned int;
+#endif
+	}
+
 	namespace leaf_detail
 	{
 		template <class T>
 		class optional
 		{
-			int key_;
+			id_type key_;
 			union { T value_; };
 
 		public:
@@ -626,14 +712,14 @@ namespace boost { namespace leaf {
 				}
 			}
 
-			LEAF_CONSTEXPR optional( int key, T const & v ):
+			LEAF_CONSTEXPR optional( id_type key, T const & v ):
 				key_(key),
 				value_(v)
 			{
 				assert(!empty());
 			}
 
-			LEAF_CONSTEXPR optional( int key, T && v ) noexcept:
+			LEAF_CONSTEXPR optional( id_type key, T && v ) noexcept:
 				key_(key),
 				value_(std::move(v))
 			{
@@ -643,7 +729,7 @@ namespace boost { namespace leaf {
 			LEAF_CONSTEXPR optional & operator=( optional const & x )
 			{
 				reset();
-				if( int key = x.key() )
+				if( id_type key = x.key() )
 				{
 					put(key, x.value_);
 					key_ = key;
@@ -654,7 +740,7 @@ namespace boost { namespace leaf {
 			LEAF_CONSTEXPR optional & operator=( optional && x ) noexcept
 			{
 				reset();
-				if( int key = x.key() )
+				if( id_type key = x.key() )
 				{
 					put(key, std::move(x.value_));
 					x.reset();
@@ -672,12 +758,12 @@ namespace boost { namespace leaf {
 				return key_==0;
 			}
 
-			LEAF_CONSTEXPR int key() const noexcept
+			LEAF_CONSTEXPR id_type key() const noexcept
 			{
 				return key_;
 			}
 
-			LEAF_CONSTEXPR void set_key( int key ) noexcept
+			LEAF_CONSTEXPR void set_key( id_type key ) noexcept
 			{
 				assert(!empty());
 				key_ = key;
@@ -692,7 +778,7 @@ namespace boost { namespace leaf {
 				}
 			}
 
-			LEAF_CONSTEXPR T & put( int key, T const & v )
+			LEAF_CONSTEXPR T & put( id_type key, T const & v )
 			{
 				assert(key);
 				reset();
@@ -701,7 +787,7 @@ namespace boost { namespace leaf {
 				return value_;
 			}
 
-			LEAF_CONSTEXPR T & put( int key, T && v ) noexcept
+			LEAF_CONSTEXPR T & put( id_type key, T && v ) noexcept
 			{
 				assert(key);
 				reset();
@@ -710,37 +796,37 @@ namespace boost { namespace leaf {
 				return value_;
 			}
 
-			LEAF_CONSTEXPR T const * has_value(int key) const noexcept
+			LEAF_CONSTEXPR T const * has_value(id_type key) const noexcept
 			{
 				assert(key);
 				return key_==key ? &value_ : 0;
 			}
 
-			LEAF_CONSTEXPR T * has_value(int key) noexcept
+			LEAF_CONSTEXPR T * has_value(id_type key) noexcept
 			{
 				assert(key);
 				return key_==key ? &value_ : 0;
 			}
 
-			LEAF_CONSTEXPR T const & value(int key) const & noexcept
+			LEAF_CONSTEXPR T const & value(id_type key) const & noexcept
 			{
 				assert(has_value(key)!=0);
 				return value_;
 			}
 
-			LEAF_CONSTEXPR T & value(int key) & noexcept
+			LEAF_CONSTEXPR T & value(id_type key) & noexcept
 			{
 				assert(has_value(key)!=0);
 				return value_;
 			}
 
-			LEAF_CONSTEXPR T const && value(int key) const && noexcept
+			LEAF_CONSTEXPR T const && value(id_type key) const && noexcept
 			{
 				assert(has_value(key)!=0);
 				return value_;
 			}
 
-			LEAF_CONSTEXPR T value(int key) && noexcept
+			LEAF_CONSTEXPR T value(id_type key) && noexcept
 			{
 				assert(has_value(key)!=0);
 				T tmp(std::move(value_));
@@ -748,7 +834,7 @@ namespace boost { namespace leaf {
 				return tmp;
 			}
 
-			void print( std::ostream &, int key_to_print ) const;
+			void print( std::ostream &, id_type key_to_print ) const;
 		};
 
 	} // leaf_detail
@@ -761,43 +847,109 @@ namespace boost { namespace leaf {
 #include <exception>
 #include <ostream>
 #include <cstring>
+#include <cstdint>
 #include <cassert>
 
 namespace boost { namespace leaf {
 
-	namespace leaf_detail
+	struct type_name
 	{
-		template <int N>
-		LEAF_CONSTEXPR inline char const * check_prefix( char const * t, char const (&prefix)[N] )
+		char const * name; // Not null-terminated
+		int length;
+		std::uint64_t hash;
+
+		friend bool operator==( type_name const & a, type_name const & b ) noexcept
 		{
-			return std::strncmp(t,prefix,sizeof(prefix)-1)==0 ? t+sizeof(prefix)-1 : t;
+			return a.hash==b.hash && a.length==b.length && std::memcmp(a.name, b.name, a.length)==0;
 		}
-	}
 
-	template <class Name>
-	LEAF_CONSTEXPR inline char const * type() noexcept
+		friend bool operator!=( type_name const & a, type_name const & b ) noexcept
+		{
+			return !(a==b);
+		}
+
+		friend std::ostream & operator<<( std::ostream & os, type_name const & x )
+		{
+			return os.write(x.name, x.length);
+		}
+	};
+
+	namespace leaf_detail
 	{
-	char const * t =
+		// The functions below are written in the C++11 constexpr style, and
+		// process long strings in steps of several characters, to keep the
+		// recursion depth low.
+
+		constexpr bool starts_with( char const * s, char const * prefix, int prefix_length ) noexcept
+		{
+			return prefix_length==0 || (*s==*prefix && starts_with(s+1, prefix+1, prefix_length-1));
+		}
+
+		constexpr int find( char const * s, int length, char const * substr, int substr_length, int i=0 ) noexcept
+		{
+			return i+substr_length>length ? -1 : starts_with(s+i, substr, substr_length) ? i : find(s, length, substr, substr_length, i+1);
+		}
+
+		constexpr int rfind( char const * s, char c, int i ) noexcept
+		{
+			return i<0 ? -1 : s[i]==c ? i : rfind(s, c, i-1);
+		}
+
+		constexpr std::uint64_t fnv1a_step( std::uint64_t h, char c ) noexcept
+		{
+			return (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+		}
+
+		constexpr std::uint64_t fnv1a( char const * s, int length, std::uint64_t h = 14695981039346656037ull ) noexcept
+		{
+			return
+				length>=8 ? fnv1a(s+8, length-8, fnv1a_step(fnv1a_step(fnv1a_step(fnv1a_step(fnv1a_step(fnv1a_step(fnv1a_step(fnv1a_step(h, s[0]), s[1]), s[2]), s[3]), s[4]), s[5]), s[6]), s[7])) :
+				length>0 ? fnv1a(s+1, length-1, fnv1a_step(h, s[0])) :
+				h;
+		}
+
+		constexpr type_name make_type_name( char const * s, int begin, int end ) noexcept
+		{
+			return type_name{ s+begin, end-begin, fnv1a(s+begin, end-begin) };
+		}
+
+		// Finds the name of T in the signature of type_name_of<T>, which
+		// looks like this:
+		// gcc:   "constexpr boost::leaf::type_name boost::leaf::leaf_detail::type_name_of() [with T = NAME]"
+		// clang: "boost::leaf::type_name boost::leaf::leaf_detail::type_name_of() [T = NAME]"
+		// msvc:  "struct boost::leaf::type_name __cdecl boost::leaf::leaf_detail::type_name_of<NAME>(void)"
+		constexpr type_name parse_type_name( char const * s, int length, int prefix, int prefix_length, char terminator ) noexcept
+		{
+			return prefix<0 || rfind(s, terminator, length-1)<prefix+prefix_length ?
+				make_type_name(s, 0, length) :
+				make_type_name(s, prefix+prefix_length, rfind(s, terminator, length-1));
+		}
+
+		template <class T>
+		constexpr type_name type_name_of() noexcept
+		{
+			return
 #ifdef __FUNCSIG__
-		__FUNCSIG__;
+				parse_type_name(__FUNCSIG__, sizeof(__FUNCSIG__)-1, find(__FUNCSIG__, sizeof(__FUNCSIG__)-1, "type_name_of<", 13), 13, '>');
 #else
-		__PRETTY_FUNCTION__;
+				parse_type_name(__PRETTY_FUNCTION__, sizeof(__PRETTY_FUNCTION__)-1, find(__PRETTY_FUNCTION__, sizeof(__PRETTY_FUNCTION__)-1, "T = ", 4), 4, ']');
 #endif
-#if defined(__clang__)
-		assert(leaf_detail::check_prefix(t,"const char *boost::leaf::type() ")==t+32);
-		return t+32;
-#elif defined(__GNUC__)
-		assert(leaf_detail::check_prefix(t,"const char* boost::leaf::type() ")==t+32);
-		return t+32;
-#else
-		char const * clang_style = leaf_detail::check_prefix(t,"const char *boost::leaf::type() ");
-		if( clang_style!=t )
-			return clang_style;
-		char const * gcc_style = leaf_detail::check_prefix(t,"const char* boost::leaf::type() ");
-		if( gcc_style!=t )
-			return gcc_style;
-#endif
-		return t;
+		}
+
+		template <class T>
+		struct type_name_holder
+		{
+			static constexpr type_name value = type_name_of<T>();
+		};
+
+		template <class T>
+		constexpr type_name type_name_holder<T>::value;
+	}
+
+	template <class T>
+	constexpr type_name type() noexcept
+	{
+		return leaf_detail::type_name_holder<T>::value;
 	}
 
 	namespace leaf_detail
@@ -869,22 +1021,28 @@ namespace boost { namespace leaf {
 		};
 
 		template <class T>
-		void optional<T>::print( std::ostream & os, int key_to_print ) const
+		void print_e_object( std::ostream & os, T const & value, id_type k, id_type key_to_print )
 		{
 			if( !diagnostic<T>::is_invisible )
-				if( int k = key() )
+			{
+				if( key_to_print )
 				{
-					if( key_to_print )
-					{
-						if( key_to_print!=k )
-							return;
-					}
-					else
-						os << '[' << k << ']';
-					os << type<T>() << ": ";
-					diagnostic<T>::print(os, value_);
-					os << std::endl;
+					if( key_to_print!=k )
+						return;
 				}
+				else
+					os << '[' << k << ']';
+				os << type<T>() << ": ";
+				diagnostic<T>::print(os, value);
+				os << '\n';
+			}
+		}
+
+		template <class T>
+		void optional<T>::print( std::ostream & os, id_type key_to_print ) const
+		{
+			if( id_type k = key() )
+				print_e_object(os, value_, k, key_to_print);
 		}
 	} // leaf_detail
 
@@ -897,14 +1055,37 @@ namespace boost { namespace leaf {
 #include <type_traits>
 #include <sstream>
 #include <memory>
-#include <set>
+#include <typeinfo>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#ifdef LEAF_COUNT_LOADS
+#	include <vector>
+#endif
+
+#ifdef LEAF_ENABLE_STACKTRACE
+#	if defined(_WIN32)
+#		define LEAF_STACKTRACE_WINDOWS
+		// Declared here rather than by including <Windows.h>.
+		extern "C" __declspec(dllimport) unsigned short __stdcall RtlCaptureStackBackTrace( unsigned long, unsigned long, void * *, unsigned long * );
+#	elif defined(__GLIBC__) || defined(__APPLE__)
+#		include <execinfo.h>
+#		include <cxxabi.h>
+#		include <cstdlib>
+#		include <cstring>
+#		define LEAF_STACKTRACE_EXECINFO
+#	endif
+#endif
 
 #ifdef LEAF_NO_THREADS
 #	define LEAF_THREAD_LOCAL
 	namespace boost { namespace leaf {
 		namespace leaf_detail
 		{
-			using atomic_unsigned_int = unsigned int;
+			using atomic_unsigned_id = unsigned_id_type;
+			using atomic_int = int;
+			using atomic_unsigned_long = unsigned long;
 		}
 	} }
 #else
@@ -914,7 +1095,9 @@ namespace boost { namespace leaf {
 	namespace boost { namespace leaf {
 		namespace leaf_detail
 		{
-			using atomic_unsigned_int = std::atomic<unsigned int>;
+			using atomic_unsigned_id = std::atomic<unsigned_id_type>;
+			using atomic_int = std::atomic<int>;
+			using atomic_unsigned_long = std::atomic<unsigned long>;
 		}
 	} }
 #endif
@@ -983,6 +1166,215 @@ namespace boost { namespace leaf {
 
 	////////////////////////////////////////
 
+	// Records the source locations an error passes through, in a ring buffer
+	// stored in the object itself, so that adding a record never allocates.
+	// Once LEAF_ERROR_TRACE_CAPACITY records are stored, each new record
+	// overwrites the oldest one.
+	class e_error_trace
+	{
+	public:
+
+		struct record
+		{
+			char const * file;
+			int line;
+			char const * function;
+		};
+
+	private:
+
+		record rec_[LEAF_ERROR_TRACE_CAPACITY];
+		unsigned count_;
+
+		// Only the first size() elements of rec_ are initialized.
+		void copy_from( e_error_trace const & x ) noexcept
+		{
+			count_ = x.count_;
+			for( int i=0, n=size(); i!=n; ++i )
+				rec_[i] = x.rec_[i];
+		}
+
+	public:
+
+		e_error_trace() noexcept:
+			count_(0)
+		{
+		}
+
+		e_error_trace( e_error_trace const & x ) noexcept
+		{
+			copy_from(x);
+		}
+
+		e_error_trace & operator=( e_error_trace const & x ) noexcept
+		{
+			if( this!=&x )
+				copy_from(x);
+			return *this;
+		}
+
+		constexpr static int capacity() noexcept
+		{
+			return LEAF_ERROR_TRACE_CAPACITY;
+		}
+
+		int size() const noexcept
+		{
+			return count_<unsigned(capacity()) ? int(count_) : capacity();
+		}
+
+		unsigned dropped() const noexcept
+		{
+			return count_ - unsigned(size());
+		}
+
+		record const & operator[]( int i ) const noexcept
+		{
+			assert(i>=0 && i<size());
+			return rec_[count_<unsigned(capacity()) ? i : (count_+unsigned(i)) % unsigned(capacity())];
+		}
+
+		void push( char const * file, int line, char const * function ) noexcept
+		{
+			record & r = rec_[count_ % unsigned(capacity())];
+			r.file = file;
+			r.line = line;
+			r.function = function;
+			++count_;
+		}
+
+		friend std::ostream & operator<<( std::ostream & os, e_error_trace const & x )
+		{
+			os << leaf::type<e_error_trace>() << ':';
+			if( unsigned d = x.dropped() )
+				os << " (" << d << " oldest records dropped)";
+			for( int i=0; i!=x.size(); ++i )
+				os << "\n\t" << x[i].file << '(' << x[i].line << ") in function " << x[i].function;
+			return os;
+		}
+	};
+
+	template <>
+	struct is_e_type<e_error_trace>: std::true_type
+	{
+	};
+
+	////////////////////////////////////////
+
+#ifdef LEAF_ENABLE_STACKTRACE
+
+	namespace leaf_detail
+	{
+#ifdef LEAF_STACKTRACE_EXECINFO
+		inline void print_stacktrace_frame( std::ostream & os, char const * sym )
+		{
+			// glibc formats symbols as "module(mangled+offset) [address]".
+			char const * b = std::strchr(sym, '(');
+			char const * e = b ? std::strchr(b, '+') : 0;
+			if( b && e && e>b+1 )
+			{
+				std::string mangled(b+1, e);
+				int status = 0;
+				if( char * demangled = abi::__cxa_demangle(mangled.c_str(), 0, 0, &status) )
+				{
+					os.write(sym, b+1-sym) << demangled << (e);
+					std::free(demangled);
+					return;
+				}
+			}
+			os << sym;
+		}
+
+		inline void print_stacktrace( std::ostream & os, void * const * frames, int size )
+		{
+			if( char * * syms = ::backtrace_symbols(frames, size) )
+			{
+				for( int i=0; i!=size; ++i )
+				{
+					os << "\n\t#" << i << ' ';
+					print_stacktrace_frame(os, syms[i]);
+				}
+				std::free(syms);
+			}
+			else
+				for( int i=0; i!=size; ++i )
+					os << "\n\t#" << i << ' ' << frames[i];
+		}
+#else
+		inline void print_stacktrace( std::ostream & os, void * const * frames, int size )
+		{
+			for( int i=0; i!=size; ++i )
+				os << "\n\t#" << i << ' ' << frames[i];
+		}
+#endif
+	} // leaf_detail
+
+	// Stores the return addresses of the calling thread's stack, without
+	// symbolizing them; symbols are only looked up when the object is
+	// printed. new_error captures an e_stacktrace automatically, but only
+	// if an active context provides storage for it. Available only if
+	// LEAF_ENABLE_STACKTRACE is defined.
+	class e_stacktrace
+	{
+		void * frames_[LEAF_STACKTRACE_MAX_FRAMES];
+		int size_;
+
+	public:
+
+		e_stacktrace() noexcept:
+			size_(0)
+		{
+		}
+
+		constexpr static int capacity() noexcept
+		{
+			return LEAF_STACKTRACE_MAX_FRAMES;
+		}
+
+		int size() const noexcept
+		{
+			return size_;
+		}
+
+		void * operator[]( int i ) const noexcept
+		{
+			assert(i>=0 && i<size_);
+			return frames_[i];
+		}
+
+		// Captures the stack of the calling function (the frame of capture
+		// itself is not included).
+		LEAF_NOINLINE void capture() noexcept
+		{
+#if defined(LEAF_STACKTRACE_EXECINFO)
+			void * frames[LEAF_STACKTRACE_MAX_FRAMES+1];
+			int n = ::backtrace(frames, LEAF_STACKTRACE_MAX_FRAMES+1);
+			size_ = n>1 ? n-1 : 0;
+			std::memcpy(frames_, frames+1, size_*sizeof(void *));
+#elif defined(LEAF_STACKTRACE_WINDOWS)
+			size_ = ::RtlCaptureStackBackTrace(1, LEAF_STACKTRACE_MAX_FRAMES, frames_, 0);
+#else
+			size_ = 0;
+#endif
+		}
+
+		friend std::ostream & operator<<( std::ostream & os, e_stacktrace const & x )
+		{
+			os << leaf::type<e_stacktrace>() << ": " << x.size_ << " frames";
+			leaf_detail::print_stacktrace(os, x.frames_, x.size_);
+			return os;
+		}
+	};
+
+	template <>
+	struct is_e_type<e_stacktrace>: std::true_type
+	{
+	};
+
+#endif
+
+	////////////////////////////////////////
+
 #if LEAF_DIAGNOSTICS
 
 	namespace leaf_detail
@@ -991,10 +1383,10 @@ namespace boost { namespace leaf {
 		{
 		public:
 
-			char const * (*first_type)();
+			type_name first_type;
 			int count;
 
-			LEAF_CONSTEXPR explicit e_unexpected_count( char const * (*first_type)() ) noexcept:
+			LEAF_CONSTEXPR explicit e_unexpected_count( type_name first_type ) noexcept:
 				first_type(first_type),
 				count(1)
 			{
@@ -1002,14 +1394,13 @@ namespace boost { namespace leaf {
 
 			void print( std::ostream & os ) const
 			{
-				assert(first_type!=0);
 				assert(count>0);
 				os << "Detected ";
 				if( count==1 )
 					os << "1 attempt to communicate an unexpected error object";
 				else
 					os << count << " attempts to communicate unexpected error objects, the first one";
-				os << " of type " << first_type() << std::endl;
+				os << " of type " << first_type << '\n';
 			}
 		};
 
@@ -1027,50 +1418,195 @@ namespace boost { namespace leaf {
 			}
 		};
 
+		// Stores the first E-object of each E-type which was not expected by any
+		// active context, so that it can be printed by verbose_diagnostic_info.
+		// The objects are copied (or moved) into a fixed-size buffer, type-erased,
+		// and only formatted when printed. Objects which do not fit, and objects
+		// which can't be copied (or moved) without throwing, for example an
+		// lvalue holding a std::string, are only counted. A slot<e_unexpected_info>
+		// keeps the buffer out of line (see is_stored_out_of_line), so moving it
+		// between nested contexts transfers a pointer.
 		class e_unexpected_info
 		{
-			std::string s_;
-			std::set<char const *(*)()> already_;
+			e_unexpected_info( e_unexpected_info const & ) = delete;
+			e_unexpected_info & operator=( e_unexpected_info const & ) = delete;
 
-		public:
+			struct entry_type
+			{
+				type_name type;
+				void (*print)( std::ostream &, void const * );
+				void (*move)( void * to, void * from ) noexcept;
+				void (*destroy)( void * ) noexcept;
+			};
+
+			template <class E>
+			struct entry_type_of
+			{
+				static void print( std::ostream & os, void const * p )
+				{
+					diagnostic<E>::print(os, *static_cast<E const *>(p));
+				}
+
+				static void move( void * to, void * from ) noexcept
+				{
+					(void) new (to) E(std::move(*static_cast<E *>(from)));
+				}
+
+				static void destroy( void * p ) noexcept
+				{
+					static_cast<E *>(p)->~E();
+				}
+
+				static entry_type const & get() noexcept
+				{
+					static entry_type const et = { type<E>(), &print, &move, &destroy };
+					return et;
+				}
+			};
+
+			struct header
+			{
+				entry_type const * et;
+				std::size_t obj;
+				std::size_t end;
+			};
 
-			e_unexpected_info() noexcept
+			static LEAF_CONSTEXPR std::size_t align( std::size_t n, std::size_t a ) noexcept
 			{
+				return (n + a - 1) & ~(a - 1);
 			}
 
-			void reset() noexcept
+			alignas(std::max_align_t) unsigned char buf_[LEAF_UNEXPECTED_INFO_BUFFER_SIZE];
+			std::size_t size_;
+			int dropped_;
+
+			header & header_at( std::size_t i ) noexcept
 			{
-				s_.clear();
-				already_.clear();
+				return *reinterpret_cast<header *>(buf_ + i);
 			}
 
-			template <class E>
-			void add( E const & e )
+			header const & header_at( std::size_t i ) const noexcept
+			{
+				return *reinterpret_cast<header const *>(buf_ + i);
+			}
+
+			void move_from( e_unexpected_info & x ) noexcept
 			{
-				std::stringstream s;
-				if( !leaf_detail::diagnostic<E>::is_invisible )
+				assert(size_==0);
+				for( std::size_t i=0; i<x.size_; i=align(x.header_at(i).end, alignof(header)) )
 				{
-					leaf_detail::diagnostic<E>::print(s,e);
-					if( already_.insert(&type<E>).second  )
-					{
-						s << std::endl;
-						s_ += s.str();
-					}
+					header const & h = *new (buf_ + i) header(x.header_at(i));
+					h.et->move(buf_ + h.obj, x.buf_ + h.obj);
 				}
+				size_ = x.size_;
+				dropped_ = x.dropped_;
+				x.reset();
 			}
 
-			void print( std::ostream & os ) const
+			template <class T, class E>
+			void add_impl( E && e, std::true_type ) noexcept
 			{
-				os << "Unexpected error objects:\n" << s_;
+				for( std::size_t i=0; i<size_; i=align(header_at(i).end, alignof(header)) )
+					if( header_at(i).et->type==type<T>() )
+						return;
+				std::size_t const h = align(size_, alignof(header));
+				std::size_t const obj = align(h + sizeof(header), alignof(T));
+				std::size_t const end = obj + sizeof(T);
+				if( end>sizeof(buf_) )
+				{
+					++dropped_;
+					return;
+				}
+				(void) new (buf_ + obj) T(std::forward<E>(e));
+				header & hd = *new (buf_ + h) header;
+				hd.et = &entry_type_of<T>::get();
+				hd.obj = obj;
+				hd.end = end;
+				size_ = end;
 			}
-		};
 
-		template <>
-		struct is_error_type_default<e_unexpected_info>: std::true_type
-		{
-		};
+			template <class T, class E>
+			void add_impl( E &&, std::false_type ) noexcept
+			{
+				if( !diagnostic<T>::is_invisible )
+					++dropped_;
+			}
 
-		template <>
+		public:
+
+			e_unexpected_info() noexcept:
+				size_(0),
+				dropped_(0)
+			{
+			}
+
+			e_unexpected_info( e_unexpected_info && x ) noexcept:
+				size_(0),
+				dropped_(0)
+			{
+				move_from(x);
+			}
+
+			e_unexpected_info & operator=( e_unexpected_info && x ) noexcept
+			{
+				if( this!=&x )
+				{
+					reset();
+					move_from(x);
+				}
+				return *this;
+			}
+
+			~e_unexpected_info() noexcept
+			{
+				reset();
+			}
+
+			void reset() noexcept
+			{
+				for( std::size_t i=0; i<size_; i=align(header_at(i).end, alignof(header)) )
+				{
+					header const & h = header_at(i);
+					h.et->destroy(buf_ + h.obj);
+				}
+				size_ = 0;
+				dropped_ = 0;
+			}
+
+			// Copies lvalues and moves rvalues; objects that can't be copied (or
+			// moved) without throwing are only counted.
+			template <class E>
+			void add( E && e ) noexcept
+			{
+				using T = typename std::decay<E>::type;
+				add_impl<T>(std::forward<E>(e), std::integral_constant<bool,
+					!diagnostic<T>::is_invisible &&
+					std::is_nothrow_constructible<T, E &&>::value &&
+					std::is_nothrow_move_constructible<T>::value &&
+					alignof(T)<=alignof(std::max_align_t) &&
+					sizeof(header)+sizeof(T)<=LEAF_UNEXPECTED_INFO_BUFFER_SIZE>());
+			}
+
+			void print( std::ostream & os ) const
+			{
+				os << "Unexpected error objects:\n";
+				for( std::size_t i=0; i<size_; i=align(header_at(i).end, alignof(header)) )
+				{
+					header const & h = header_at(i);
+					h.et->print(os, buf_ + h.obj);
+					os << '\n';
+				}
+				if( dropped_ )
+					os << "(" << dropped_ << " more not captured: too large for LEAF_UNEXPECTED_INFO_BUFFER_SIZE, or not nothrow copyable)" << '\n';
+			}
+		};
+
+		template <>
+		struct is_error_type_default<e_unexpected_info>: std::true_type
+		{
+		};
+
+		template <>
 		struct diagnostic<e_unexpected_info,false,false>
 		{
 			static constexpr bool is_invisible = true;
@@ -1084,6 +1620,44 @@ namespace boost { namespace leaf {
 			static LEAF_THREAD_LOCAL int c;
 			return c;
 		}
+
+#if LEAF_DIAGNOSTICS==2
+
+		template <class=void>
+		struct diagnostics_config
+		{
+			static atomic_int enabled;
+			static atomic_int sample_rate;
+		};
+
+		template <class T>
+		atomic_int diagnostics_config<T>::enabled(1);
+
+		template <class T>
+		atomic_int diagnostics_config<T>::sample_rate(1);
+
+		// Called when a context that can produce diagnostic_info or
+		// verbose_diagnostic_info is activated, to decide whether that context
+		// collects diagnostic information. Sampling uses a per-thread countdown,
+		// so that the only data shared between threads is read-only.
+		inline bool sample_diagnostics() noexcept
+		{
+			if( !diagnostics_config<>::enabled )
+				return false;
+			int n = diagnostics_config<>::sample_rate;
+			if( n<=1 )
+				return true;
+			static LEAF_THREAD_LOCAL int countdown;
+			if( countdown>0 )
+			{
+				--countdown;
+				return false;
+			}
+			countdown = n-1;
+			return true;
+		}
+
+#endif
 	}
 
 #endif
@@ -1095,35 +1669,398 @@ namespace boost { namespace leaf {
 		template <class E>
 		class slot;
 
+#ifdef LEAF_USE_TLS_ARRAY
+
+		// All slot head pointers live in a single thread-local array, so that
+		// activating a context or loading E-objects accesses one TLS variable
+		// regardless of the number of E-types involved: the address of the
+		// array is obtained once and passed down as a tl_slot_table. Each
+		// E-type is assigned an index into the array the first time it is used.
+
+		template <class=void>
+		struct tls_slot_array
+		{
+			static LEAF_THREAD_LOCAL void * ptr[LEAF_TLS_ARRAY_SIZE];
+			static atomic_int next_index;
+		};
+
+		template <class T>
+		LEAF_THREAD_LOCAL void * tls_slot_array<T>::ptr[LEAF_TLS_ARRAY_SIZE];
+
+		template <class T>
+		atomic_int tls_slot_array<T>::next_index(0);
+
+		using tl_slot_table = void * *;
+
+		inline tl_slot_table get_tl_slot_table() noexcept
+		{
+			return tls_slot_array<>::ptr;
+		}
+
+		template <class E>
+		inline int tls_slot_index() noexcept
+		{
+			static int const index = tls_slot_array<>::next_index++;
+			return index;
+		}
+
 		template <class E>
-		inline slot<E> * & tl_slot_ptr() noexcept
+		inline void * & tl_slot_overflow() noexcept
+		{
+			static LEAF_THREAD_LOCAL void * s;
+			return s;
+		}
+
+		template <class E>
+		inline void * & tl_slot_head( tl_slot_table table ) noexcept
+		{
+			int const index = tls_slot_index<E>();
+			if( index < LEAF_TLS_ARRAY_SIZE )
+				return table[index];
+			else
+				return tl_slot_overflow<E>(); // The array is full, use a TLS variable for this E-type.
+		}
+
+#else
+
+		struct tl_slot_table { };
+
+		LEAF_CONSTEXPR inline tl_slot_table get_tl_slot_table() noexcept
+		{
+			return tl_slot_table();
+		}
+
+		template <class E>
+		inline slot<E> * & tl_slot_head( tl_slot_table ) noexcept
 		{
 			static LEAF_THREAD_LOCAL slot<E> * s;
 			return s;
 		}
 
+#endif
+
+		template <class E>
+		inline slot<E> * tl_slot_ptr( tl_slot_table table = get_tl_slot_table() ) noexcept
+		{
+			return static_cast<slot<E> *>(tl_slot_head<E>(table));
+		}
+
+		// A per-thread cache of memory blocks of size S, used by heap_optional.
+		template <std::size_t S>
+		class heap_block_cache
+		{
+			heap_block_cache( heap_block_cache const & ) = delete;
+			heap_block_cache & operator=( heap_block_cache const & ) = delete;
+
+			struct block
+			{
+				block * next;
+			};
+
+			enum { max_cached = 8 };
+
+			block * free_;
+			int cached_;
+
+			heap_block_cache() noexcept:
+				free_(0),
+				cached_(0)
+			{
+			}
+
+			~heap_block_cache() noexcept
+			{
+				while( block * b = free_ )
+				{
+					free_ = b->next;
+					::operator delete(b);
+				}
+				tl_destroyed() = true;
+			}
+
+			// Set when the calling thread's cache is destroyed, so that blocks
+			// released after that (e.g. by a thread_local context) do not
+			// touch it.
+			static bool & tl_destroyed() noexcept
+			{
+				static LEAF_THREAD_LOCAL bool d;
+				return d;
+			}
+
+			static heap_block_cache & tl_instance() noexcept
+			{
+				static LEAF_THREAD_LOCAL heap_block_cache c;
+				return c;
+			}
+
+		public:
+
+			// Returns 0 if out of memory.
+			static void * allocate() noexcept
+			{
+				if( !tl_destroyed() )
+				{
+					heap_block_cache & c = tl_instance();
+					if( block * b = c.free_ )
+					{
+						c.free_ = b->next;
+						--c.cached_;
+						return b;
+					}
+				}
+				return ::operator new(S<sizeof(block) ? sizeof(block) : S, std::nothrow);
+			}
+
+			static void deallocate( void * p ) noexcept
+			{
+				assert(p!=0);
+				if( !tl_destroyed() )
+				{
+					heap_block_cache & c = tl_instance();
+					if( c.cached_<max_cached )
+					{
+						block * b = static_cast<block *>(p);
+						b->next = c.free_;
+						c.free_ = b;
+						++c.cached_;
+						return;
+					}
+				}
+				::operator delete(p);
+			}
+		};
+
+		// Like optional<T>, but the T object is stored out of line. The memory is
+		// obtained from the per-thread heap_block_cache the first time a value is
+		// put, and is retained until the heap_optional is destroyed. Moving a
+		// heap_optional transfers the pointer instead of moving the T object.
+		// If the memory can't be allocated, put does not store the value and
+		// returns 0.
+		template <class T>
+		class heap_optional
+		{
+			heap_optional( heap_optional const & ) = delete;
+			heap_optional & operator=( heap_optional const & ) = delete;
+
+			id_type key_;
+			T * value_;
+
+			T * storage() noexcept
+			{
+				if( !value_ )
+					value_ = static_cast<T *>(heap_block_cache<sizeof(T)>::allocate());
+				return value_;
+			}
+
+			void release_storage() noexcept
+			{
+				if( value_ )
+				{
+					heap_block_cache<sizeof(T)>::deallocate(value_);
+					value_ = 0;
+				}
+			}
+
+		public:
+
+			typedef T value_type;
+
+			LEAF_CONSTEXPR heap_optional() noexcept:
+				key_(0),
+				value_(0)
+			{
+			}
+
+			LEAF_CONSTEXPR heap_optional( heap_optional && x ) noexcept:
+				key_(x.key_),
+				value_(x.value_)
+			{
+				x.key_ = 0;
+				x.value_ = 0;
+			}
+
+			LEAF_CONSTEXPR heap_optional & operator=( heap_optional && x ) noexcept
+			{
+				reset();
+				release_storage();
+				key_ = x.key_;
+				value_ = x.value_;
+				x.key_ = 0;
+				x.value_ = 0;
+				return *this;
+			}
+
+			~heap_optional() noexcept
+			{
+				reset();
+				release_storage();
+			}
+
+			LEAF_CONSTEXPR bool empty() const noexcept
+			{
+				return key_==0;
+			}
+
+			LEAF_CONSTEXPR id_type key() const noexcept
+			{
+				return key_;
+			}
+
+			LEAF_CONSTEXPR void set_key( id_type key ) noexcept
+			{
+				assert(!empty());
+				key_ = key;
+			}
+
+			LEAF_CONSTEXPR void reset() noexcept
+			{
+				if( key_ )
+				{
+					value_->~T();
+					key_=0;
+				}
+			}
+
+			LEAF_CONSTEXPR T * put( id_type key, T const & v )
+			{
+				assert(key);
+				reset();
+				if( T * p = storage() )
+				{
+					(void) new(p) T(v);
+					key_=key;
+					return p;
+				}
+				return 0;
+			}
+
+			LEAF_CONSTEXPR T * put( id_type key, T && v ) noexcept
+			{
+				assert(key);
+				reset();
+				if( T * p = storage() )
+				{
+					(void) new(p) T(std::move(v));
+					key_=key;
+					return p;
+				}
+				return 0;
+			}
+
+			LEAF_CONSTEXPR T const * has_value(id_type key) const noexcept
+			{
+				assert(key);
+				return key_==key ? value_ : 0;
+			}
+
+			LEAF_CONSTEXPR T * has_value(id_type key) noexcept
+			{
+				assert(key);
+				return key_==key ? value_ : 0;
+			}
+
+			LEAF_CONSTEXPR T const & value(id_type key) const & noexcept
+			{
+				assert(has_value(key)!=0);
+				return *value_;
+			}
+
+			LEAF_CONSTEXPR T & value(id_type key) & noexcept
+			{
+				assert(has_value(key)!=0);
+				return *value_;
+			}
+
+			LEAF_CONSTEXPR T const && value(id_type key) const && noexcept
+			{
+				assert(has_value(key)!=0);
+				return std::move(*value_);
+			}
+
+			LEAF_CONSTEXPR T value(id_type key) && noexcept
+			{
+				assert(has_value(key)!=0);
+				T tmp(std::move(*value_));
+				reset();
+				return tmp;
+			}
+
+			void print( std::ostream & os, id_type key_to_print ) const
+			{
+				if( id_type k = key() )
+					print_e_object(os, *value_, k, key_to_print);
+			}
+		};
+
+		// E-objects larger than LEAF_SLOT_HEAP_THRESHOLD bytes (if non-zero) are
+		// stored out of line, so that a context does not reserve stack space for
+		// them and propagating them between nested contexts does not copy them.
+		template <class E>
+		struct is_stored_out_of_line: std::integral_constant<bool,
+			LEAF_SLOT_HEAP_THRESHOLD!=0 &&
+			(sizeof(E) > LEAF_SLOT_HEAP_THRESHOLD) &&
+			alignof(E) <= alignof(std::max_align_t)>
+		{
+		};
+
+#if LEAF_DIAGNOSTICS
+		// e_unexpected_info holds a LEAF_UNEXPECTED_INFO_BUFFER_SIZE buffer, and
+		// is only ever stored when an error is not handled as expected.
+		template <>
+		struct is_stored_out_of_line<e_unexpected_info>: std::true_type
+		{
+		};
+#endif
+
+		template <class E>
+		using slot_storage = typename std::conditional<
+			is_stored_out_of_line<E>::value,
+			heap_optional<E>,
+			optional<E>>::type;
+
+		// Each context keeps a dirty_mask with one bit per slot, which the slot
+		// sets whenever an E-object is stored in it (see slot<E>::bind_owner).
+		// A clear bit means that the slot is empty. Slots past the width of
+		// the mask share its last bit.
+		typedef std::uint64_t dirty_mask;
+
+		LEAF_CONSTEXPR inline dirty_mask dirty_bit( int i ) noexcept
+		{
+			return dirty_mask(1) << (i<64 ? i : 63);
+		}
+
 		template <class E>
 		class slot:
-			optional<E>
+			slot_storage<E>
 		{
 			slot( slot const & ) = delete;
 			slot & operator=( slot const & ) = delete;
 
-			typedef optional<E> impl;
-			slot<E> * * top_;
+			typedef slot_storage<E> impl;
+
+			LEAF_CONSTEXPR static E * stored( E & e ) noexcept { return &e; }
+			LEAF_CONSTEXPR static E * stored( E * e ) noexcept { return e; }
+
+			typename std::remove_reference<decltype(tl_slot_head<E>(tl_slot_table()))>::type * top_;
 			slot<E> * prev_;
+			dirty_mask * owner_mask_;
+			dirty_mask owner_bit_;
 			static_assert(is_e_type<E>::value,"Not an error type");
 
 		public:
 
 			LEAF_CONSTEXPR slot() noexcept:
-				top_(0)
+				top_(0),
+				owner_mask_(0),
+				owner_bit_(0)
 			{
 			}
 
 			LEAF_CONSTEXPR slot( slot && x ) noexcept:
-				optional<E>(std::move(x)),
-				top_(0)
+				impl(std::move(x)),
+				top_(0),
+				owner_mask_(0),
+				owner_bit_(0)
 			{
 				assert(x.top_==0);
 			}
@@ -1133,18 +2070,37 @@ namespace boost { namespace leaf {
 				assert(top_==0);
 			}
 
-			LEAF_CONSTEXPR void activate() noexcept
+			LEAF_CONSTEXPR void activate( tl_slot_table table = get_tl_slot_table() ) noexcept
 			{
 				assert(top_==0);
-				top_ = &tl_slot_ptr<E>();
-				prev_ = *top_;
+				top_ = &tl_slot_head<E>(table);
+				prev_ = static_cast<slot<E> *>(*top_);
 				*top_ = this;
 			}
 
-			LEAF_CONSTEXPR void deactivate( bool propagate_errors ) noexcept;
+			// Called by the context that owns the slot, whenever the slot is
+			// constructed or moved.
+			LEAF_CONSTEXPR void bind_owner( dirty_mask * mask, dirty_mask bit ) noexcept
+			{
+				assert(mask!=0);
+				owner_mask_ = mask;
+				owner_bit_ = bit;
+			}
+
+			LEAF_CONSTEXPR bool deactivate( bool propagate_errors ) noexcept;
+
+			// Returns 0 if the E-object could not be stored (only possible
+			// with heap_optional storage, if out of memory).
+			template <class T>
+			LEAF_CONSTEXPR E * put( id_type key, T && v ) noexcept(noexcept(std::declval<impl &>().put(key, std::forward<T>(v))))
+			{
+				assert(owner_mask_!=0);
+				*owner_mask_ |= owner_bit_;
+				return stored(impl::put(key, std::forward<T>(v)));
+			}
 
-			using impl::put;
 			using impl::has_value;
+			using impl::key;
 			using impl::value;
 			using impl::print;
 		};
@@ -1152,65 +2108,204 @@ namespace boost { namespace leaf {
 #if LEAF_DIAGNOSTICS
 
 		template <class E>
-		LEAF_CONSTEXPR inline void load_unexpected_count( int err_id ) noexcept
+		LEAF_CONSTEXPR inline void load_unexpected_count( id_type err_id ) noexcept
 		{
 			if( slot<e_unexpected_count> * sl = tl_slot_ptr<e_unexpected_count>() )
 				if( e_unexpected_count * unx = sl->has_value(err_id) )
 					++unx->count;
 				else
-					sl->put(err_id, e_unexpected_count(&type<E>));
+					sl->put(err_id, e_unexpected_count(type<E>()));
 		}
 
 		template <class E>
-		LEAF_CONSTEXPR inline void load_unexpected_info( int err_id, E && e ) noexcept
+		LEAF_CONSTEXPR inline void load_unexpected_info( id_type err_id, E && e ) noexcept
 		{
 			if( slot<e_unexpected_info> * sl = tl_slot_ptr<e_unexpected_info>() )
 				if( e_unexpected_info * unx = sl->has_value(err_id) )
-					unx->add(e);
-				else
-					sl->put(err_id, e_unexpected_info()).add(e);
+					unx->add(std::forward<E>(e));
+				else if( e_unexpected_info * unx = sl->put(err_id, e_unexpected_info()) )
+					unx->add(std::forward<E>(e));
 		}
 
 		template <class E>
-		LEAF_CONSTEXPR inline void load_unexpected( int err_id, E && e  ) noexcept
+		LEAF_CONSTEXPR inline void load_unexpected( id_type err_id, E && e  ) noexcept
 		{
 			load_unexpected_count<E>(err_id);
-			load_unexpected_info(err_id, std::move(e));
+			load_unexpected_info(err_id, std::forward<E>(e));
 		}
 
 #endif
 
+		// Returns true if the slot still holds an E-object after propagating
+		// (there is no previous slot to move it to).
 		template <class E>
-		LEAF_CONSTEXPR inline void slot<E>::deactivate( bool propagate_errors ) noexcept
+		LEAF_CONSTEXPR inline bool slot<E>::deactivate( bool propagate_errors ) noexcept
 		{
 			assert(top_!=0);
+			bool holds_value = false;
 			if( propagate_errors )
-				if( prev_ )
+				if( id_type err_id = impl::key() )
 				{
-					impl & this_ = *this;
-					impl & that_ = *prev_;
-					that_ = std::move(this_);
-				}
+					if( prev_ )
+					{
+						*prev_->owner_mask_ |= prev_->owner_bit_;
+						impl & this_ = *this;
+						impl & that_ = *prev_;
+						that_ = std::move(this_);
+					}
+					else
+					{
 #if LEAF_DIAGNOSTICS
-				else
-				{
-					int c = tl_unexpected_enabled_counter();
-					assert(c>=0);
-					if( c )
-						if( int err_id = impl::key() )
+						int c = tl_unexpected_enabled_counter();
+						assert(c>=0);
+						if( c )
 							load_unexpected(err_id, std::move(*this).value(err_id));
-				}
+						else
 #endif
+							holds_value = true;
+					}
+				}
 			*top_ = prev_;
 			top_ = 0;
+			return holds_value;
+		}
+
+#ifdef LEAF_COUNT_LOADS
+
+		// Each E-type that is ever loaded gets a load_counters object, which
+		// registers itself (once, on first use) in a global list so that
+		// get_load_counts can enumerate all E-types.
+		struct load_counters
+		{
+			load_counters( load_counters const & ) = delete;
+			load_counters & operator=( load_counters const & ) = delete;
+
+			type_name const type;
+			atomic_unsigned_long kept;
+			atomic_unsigned_long discarded;
+			atomic_unsigned_long unexpected;
+			load_counters * next;
+
+			explicit load_counters( type_name type ) noexcept;
+		};
+
+		template <class=void>
+		struct load_counters_list
+		{
+#ifdef LEAF_NO_THREADS
+			static load_counters * head;
+#else
+			static std::atomic<load_counters *> head;
+#endif
+		};
+
+#ifdef LEAF_NO_THREADS
+		template <class T>
+		load_counters * load_counters_list<T>::head(0);
+#else
+		template <class T>
+		std::atomic<load_counters *> load_counters_list<T>::head(0);
+#endif
+
+		inline load_counters::load_counters( type_name type ) noexcept:
+			type(type),
+			kept(0),
+			discarded(0),
+			unexpected(0),
+			next(load_counters_list<>::head)
+		{
+#ifdef LEAF_NO_THREADS
+			load_counters_list<>::head = this;
+#else
+			while( !load_counters_list<>::head.compare_exchange_weak(next, this) )
+			{
+			}
+#endif
+		}
+
+		template <class E>
+		inline load_counters & load_counters_of() noexcept
+		{
+			static load_counters c(type<E>());
+			return c;
+		}
+
+		inline void count_load( atomic_unsigned_long & n ) noexcept
+		{
+#ifdef LEAF_NO_THREADS
+			++n;
+#else
+			n.fetch_add(1, std::memory_order_relaxed);
+#endif
+		}
+
+		template <class E>
+		inline void count_load_kept() noexcept
+		{
+			count_load(load_counters_of<E>().kept);
+		}
+
+		template <class E>
+		inline void count_load_discarded() noexcept
+		{
+			count_load(load_counters_of<E>().discarded);
+		}
+
+		// Counts an E-object loaded while no slot for E is active: it is
+		// either recorded as unexpected, or discarded.
+		template <class E>
+		inline void count_load_missed() noexcept
+		{
+			load_counters & c = load_counters_of<E>();
+#if LEAF_DIAGNOSTICS
+			if( tl_unexpected_enabled_counter() )
+			{
+				count_load(c.unexpected);
+				return;
+			}
+#endif
+			count_load(c.discarded);
+		}
+
+		template <class E>
+		inline void count_load( tl_slot_table table ) noexcept
+		{
+			if( tl_slot_ptr<E>(table) )
+				count_load_kept<E>();
+			else
+				count_load_missed<E>();
+		}
+
+#else
+
+		template <class E>
+		LEAF_CONSTEXPR inline void count_load_kept() noexcept
+		{
+		}
+
+		template <class E>
+		LEAF_CONSTEXPR inline void count_load_discarded() noexcept
+		{
+		}
+
+		template <class E>
+		LEAF_CONSTEXPR inline void count_load_missed() noexcept
+		{
+		}
+
+		template <class E>
+		LEAF_CONSTEXPR inline void count_load( tl_slot_table ) noexcept
+		{
 		}
 
+#endif
+
 		template <class E>
-		LEAF_CONSTEXPR inline int load_slot( int err_id, E && e ) noexcept
+		LEAF_CONSTEXPR inline int load_slot( id_type err_id, E && e, tl_slot_table table = get_tl_slot_table() ) noexcept
 		{
 			using T = typename std::decay<E>::type;
 			assert((err_id&3)==1);
-			if( slot<T> * p = tl_slot_ptr<T>() )
+			if( slot<T> * p = tl_slot_ptr<T>(table) )
 				(void) p->put(err_id, std::forward<E>(e));
 #if LEAF_DIAGNOSTICS
 			else
@@ -1224,18 +2319,93 @@ namespace boost { namespace leaf {
 			return 0;
 		}
 
+		// A nullary function returning an E-type may be passed to load (or
+		// new_error) instead of an E-object. It is called only if a slot for
+		// the returned E-type is active (or if the E-object will be reported
+		// as unexpected), so that E-objects which would be discarded are not
+		// created at all.
+		template <class F, bool = function_traits<F>::arity==0 && !is_e_type<F>::value>
+		struct is_deferred_e: std::false_type
+		{
+		};
+
+		template <class F>
+		struct is_deferred_e<F, true>: is_e_type<typename std::decay<fn_return_type<F>>::type>
+		{
+		};
+
+		template <class E, bool = is_deferred_e<typename std::decay<E>::type>::value>
+		struct load_item
+		{
+			LEAF_CONSTEXPR static int load( id_type err_id, E && e, tl_slot_table table ) noexcept
+			{
+				count_load<typename std::decay<E>::type>(table);
+				return load_slot(err_id, std::forward<E>(e), table);
+			}
+		};
+
+		template <class F>
+		struct load_item<F, true>
+		{
+			LEAF_CONSTEXPR static int load( id_type err_id, F && f, tl_slot_table table ) noexcept
+			{
+				using E = typename std::decay<fn_return_type<F>>::type;
+				assert((err_id&3)==1);
+				count_load<E>(table);
+				if( slot<E> * p = tl_slot_ptr<E>(table) )
+					(void) p->put(err_id, std::forward<F>(f)());
+#if LEAF_DIAGNOSTICS
+				else
+				{
+					int c = tl_unexpected_enabled_counter();
+					assert(c>=0);
+					if( c )
+					{
+						load_unexpected_count<E>(err_id);
+						if( tl_slot_ptr<e_unexpected_info>(table) )
+							load_unexpected_info(err_id, std::forward<F>(f)());
+					}
+				}
+#endif
+				return 0;
+			}
+		};
+
+		template <class E>
+		LEAF_CONSTEXPR inline bool is_handled_impl( tl_slot_table table ) noexcept
+		{
+			if( tl_slot_ptr<E>(table) )
+				return true;
+#if LEAF_DIAGNOSTICS
+			int c = tl_unexpected_enabled_counter();
+			assert(c>=0);
+			if( c )
+				return tl_slot_ptr<e_unexpected_info>(table)!=0;
+#endif
+			return false;
+		}
+
 		template <class F>
-		LEAF_CONSTEXPR inline int accumulate_slot( int err_id, F && f ) noexcept
+		LEAF_CONSTEXPR inline int accumulate_slot( id_type err_id, F && f, tl_slot_table table = get_tl_slot_table() ) noexcept
 		{
 			static_assert(function_traits<F>::arity==1, "Lambdas passed to accumulate must take a single e-type argument by reference");
 			using E = typename std::decay<fn_arg_type<F,0>>::type;
 			static_assert(is_e_type<E>::value, "Lambdas passed to accumulate must take a single e-type argument by reference");
 			assert((err_id&3)==1);
-			if( auto sl = tl_slot_ptr<E>() )
-				if( auto v = sl->has_value(err_id) )
-					(void) std::forward<F>(f)(*v);
-				else
-					(void) std::forward<F>(f)(sl->put(err_id,E()));
+			E * e = 0;
+			if( auto sl = tl_slot_ptr<E>(table) )
+			{
+				e = sl->has_value(err_id);
+				if( !e )
+					e = sl->put(err_id, E());
+			}
+			if( e )
+			{
+				count_load_kept<E>();
+				(void) std::forward<F>(f)(*e);
+			}
+			else
+				count_load_discarded<E>();
 			return 0;
 		}
 	} // leaf_detail
@@ -1247,26 +2417,46 @@ namespace boost { namespace leaf {
 		template <class=void>
 		struct id_factory
 		{
-			static atomic_unsigned_int counter;
-			static LEAF_THREAD_LOCAL unsigned last_id;
-			static LEAF_THREAD_LOCAL unsigned next_id;
+			static atomic_unsigned_id counter;
+			static LEAF_THREAD_LOCAL unsigned_id_type last_id;
+			static LEAF_THREAD_LOCAL unsigned_id_type next_id;
+			static LEAF_THREAD_LOCAL unsigned_id_type block_next;
+			static LEAF_THREAD_LOCAL unsigned block_remaining;
 
-			LEAF_CONSTEXPR static unsigned generate_next_id() noexcept
+			LEAF_CONSTEXPR static unsigned_id_type generate_next_id() noexcept
 			{
-				return counter+=4;
+				if( LEAF_ID_BLOCK_SIZE==1 )
+					return counter+=4;
+				if( !block_remaining )
+				{
+					// Reserve LEAF_ID_BLOCK_SIZE ids with a single atomic operation;
+					// the ids in the block are handed out without touching counter.
+					block_next = (counter+=4*LEAF_ID_BLOCK_SIZE) - 4*(LEAF_ID_BLOCK_SIZE-1);
+					block_remaining = LEAF_ID_BLOCK_SIZE;
+				}
+				--block_remaining;
+				unsigned_id_type id = block_next;
+				block_next += 4;
+				return id;
 			}
 		};
 
 		template <class T>
-		atomic_unsigned_int id_factory<T>::counter(-3);
+		atomic_unsigned_id id_factory<T>::counter(-3);
+
+		template <class T>
+		LEAF_THREAD_LOCAL unsigned_id_type id_factory<T>::last_id(0);
+
+		template <class T>
+		LEAF_THREAD_LOCAL unsigned_id_type id_factory<T>::next_id(0);
 
 		template <class T>
-		LEAF_THREAD_LOCAL unsigned id_factory<T>::last_id(0);
+		LEAF_THREAD_LOCAL unsigned_id_type id_factory<T>::block_next(0);
 
 		template <class T>
-		LEAF_THREAD_LOCAL unsigned id_factory<T>::next_id(0);
+		LEAF_THREAD_LOCAL unsigned id_factory<T>::block_remaining(0);
 
-		inline int last_id() noexcept
+		inline id_type last_id() noexcept
 		{
 			if( auto id = id_factory<>::last_id )
 			{
@@ -1277,7 +2467,7 @@ namespace boost { namespace leaf {
 				return id;
 		}
 
-		inline int next_id() noexcept
+		inline id_type next_id() noexcept
 		{
 			if( auto id = id_factory<>::next_id )
 			{
@@ -1294,7 +2484,7 @@ namespace boost { namespace leaf {
 			}
 		}
 
-		inline int new_id() noexcept
+		inline id_type new_id() noexcept
 		{
 			if( auto id = id_factory<>::next_id )
 			{
@@ -1313,6 +2503,12 @@ namespace boost { namespace leaf {
 				return id;
 			}
 		}
+
+		inline void reset_last_id() noexcept
+		{
+			id_factory<>::last_id = 0;
+			id_factory<>::next_id = 0;
+		}
 	}
 
 	////////////////////////////////////////
@@ -1340,15 +2536,38 @@ namespace boost { namespace leaf {
 		template <class T>
 		leaf_category get_error_category<T>::cat;
 
-		inline int import_error_code( std::error_code const & ec ) noexcept
+#ifdef LEAF_USE_64BIT_ERROR_ID
+
+		// Only the low 32 bits of a 64-bit error ID fit in a std::error_code. The high
+		// bits are restored from the ID counter, under the assumption that the error ID
+		// was generated no more than 2^32 IDs ago.
+		inline id_type error_code_value_to_id( int value ) noexcept
+		{
+			unsigned_id_type const top = id_factory<>::counter;
+			unsigned_id_type id = (top & ~unsigned_id_type(0xffffffffu)) | unsigned(value);
+			if( id > top )
+				id -= unsigned_id_type(1)<<32;
+			return id;
+		}
+
+#else
+
+		LEAF_CONSTEXPR inline id_type error_code_value_to_id( int value ) noexcept
+		{
+			return value;
+		}
+
+#endif
+
+		inline id_type import_error_code( std::error_code const & ec ) noexcept
 		{
-			if( int err_id = ec.value() )
+			if( id_type err_id = ec.value() )
 			{
 				std::error_category const & cat = leaf_detail::get_error_category<>::cat;
 				if( &ec.category()==&cat )
 				{
 					assert((err_id&3)==1);
-					return err_id;
+					return error_code_value_to_id(ec.value());
 				}
 				else
 				{
@@ -1375,16 +2594,16 @@ namespace boost { namespace leaf {
 
 	namespace leaf_detail
 	{
-		LEAF_CONSTEXPR error_id make_error_id(int) noexcept;
+		LEAF_CONSTEXPR error_id make_error_id(id_type) noexcept;
 	}
 
 	class error_id
 	{
-		friend error_id LEAF_CONSTEXPR leaf_detail::make_error_id(int ) noexcept;
+		friend error_id LEAF_CONSTEXPR leaf_detail::make_error_id(leaf_detail::id_type) noexcept;
 
-		int value_;
+		leaf_detail::id_type value_;
 
-		LEAF_CONSTEXPR explicit error_id( int value ) noexcept:
+		LEAF_CONSTEXPR explicit error_id( leaf_detail::id_type value ) noexcept:
 			value_(value)
 		{
 			assert(value_==0 || ((value_&3)==1));
@@ -1411,9 +2630,10 @@ namespace boost { namespace leaf {
 		template <class... E>
 		LEAF_CONSTEXPR error_id load( E && ... e ) const noexcept
 		{
-			if( int err_id = value() )
+			if( leaf_detail::id_type err_id = value() )
 			{
-				auto _ = { leaf_detail::load_slot(err_id, std::forward<E>(e))... };
+				leaf_detail::tl_slot_table table = leaf_detail::get_tl_slot_table();
+				auto _ = { leaf_detail::load_item<E>::load(err_id, std::forward<E>(e), table)... };
 				(void) _;
 			}
 			return *this;
@@ -1427,9 +2647,10 @@ namespace boost { namespace leaf {
 		template <class... F>
 		LEAF_CONSTEXPR error_id accumulate( F && ... f ) const noexcept
 		{
-			if( int err_id = value() )
+			if( leaf_detail::id_type err_id = value() )
 			{
-				auto _ = { leaf_detail::accumulate_slot(err_id, std::forward<F>(f))... };
+				leaf_detail::tl_slot_table table = leaf_detail::get_tl_slot_table();
+				auto _ = { leaf_detail::accumulate_slot(err_id, std::forward<F>(f), table)... };
 				(void) _;
 			}
 			return *this;
@@ -1437,10 +2658,10 @@ namespace boost { namespace leaf {
 
 		std::error_code to_error_code() const noexcept
 		{
-			return std::error_code(value(), leaf_detail::get_error_category<>::cat);
+			return std::error_code(static_cast<int>(value()), leaf_detail::get_error_category<>::cat);
 		}
 
-		LEAF_CONSTEXPR int value() const noexcept
+		LEAF_CONSTEXPR leaf_detail::id_type value() const noexcept
 		{
 			assert(!value_ || ((value_&3)==1));
 			return value_;
@@ -1474,21 +2695,35 @@ namespace boost { namespace leaf {
 
 	namespace leaf_detail
 	{
-		LEAF_CONSTEXPR inline error_id make_error_id( int err_id ) noexcept
+		LEAF_CONSTEXPR inline error_id make_error_id( id_type err_id ) noexcept
 		{
 			return error_id(err_id);
 		}
+
+		// Generates the error ID for new_error. With LEAF_ENABLE_STACKTRACE, if
+		// an active context provides storage for an e_stacktrace, the stack is
+		// captured into it.
+		inline id_type new_error_id() noexcept
+		{
+			id_type err_id = new_id();
+#ifdef LEAF_ENABLE_STACKTRACE
+			if( slot<e_stacktrace> * p = tl_slot_ptr<e_stacktrace>() )
+				if( e_stacktrace * st = p->put(err_id, e_stacktrace()) )
+					st->capture();
+#endif
+			return err_id;
+		}
 	}
 
 	inline error_id new_error() noexcept
 	{
-		return leaf_detail::make_error_id(leaf_detail::new_id());
+		return leaf_detail::make_error_id(leaf_detail::new_error_id());
 	}
 
 	template <class E1, class... E>
-	inline typename std::enable_if<is_e_type<E1>::value, error_id>::type new_error( E1 && e1, E && ... e ) noexcept
+	inline typename std::enable_if<is_e_type<E1>::value || leaf_detail::is_deferred_e<typename std::decay<E1>::type>::value, error_id>::type new_error( E1 && e1, E && ... e ) noexcept
 	{
-		return leaf_detail::make_error_id(leaf_detail::new_id()).load(std::forward<E1>(e1), std::forward<E>(e)...);
+		return leaf_detail::make_error_id(leaf_detail::new_error_id()).load(std::forward<E1>(e1), std::forward<E>(e)...);
 	}
 
 	template <class E1, class... E>
@@ -1502,6 +2737,69 @@ namespace boost { namespace leaf {
 		return leaf_detail::make_error_id(leaf_detail::next_id());
 	}
 
+#if LEAF_DIAGNOSTICS==2
+
+	inline void set_diagnostics_enabled( bool enabled ) noexcept
+	{
+		leaf_detail::diagnostics_config<>::enabled = enabled;
+	}
+
+	inline void set_diagnostics_sample_rate( int n ) noexcept
+	{
+		assert(n>0);
+		leaf_detail::diagnostics_config<>::sample_rate = n;
+	}
+
+#endif
+
+#ifdef LEAF_COUNT_LOADS
+
+	struct load_count
+	{
+		type_name type;
+		unsigned long kept;
+		unsigned long discarded;
+		unsigned long unexpected;
+	};
+
+	inline std::vector<load_count> get_load_counts()
+	{
+		std::vector<load_count> v;
+		for( leaf_detail::load_counters * c = leaf_detail::load_counters_list<>::head; c; c=c->next )
+		{
+			load_count x = { c->type, c->kept, c->discarded, c->unexpected };
+			v.push_back(x);
+		}
+		return v;
+	}
+
+	inline void reset_load_counts() noexcept
+	{
+		for( leaf_detail::load_counters * c = leaf_detail::load_counters_list<>::head; c; c=c->next )
+		{
+			c->kept = 0;
+			c->discarded = 0;
+			c->unexpected = 0;
+		}
+	}
+
+#endif
+
+	template <class E>
+	inline bool is_handled() noexcept
+	{
+		using T = typename std::decay<E>::type;
+		static_assert(is_e_type<T>::value, "is_handled requires an E-type");
+		return leaf_detail::is_handled_impl<T>(leaf_detail::get_tl_slot_table());
+	}
+
+	template <class E, class F>
+	inline void if_handled( F && f )
+	{
+		if( is_handled<E>() )
+			std::forward<F>(f)();
+	}
+
 	namespace leaf_detail
 	{
 		template <class... E>
@@ -1517,6 +2815,116 @@ namespace boost { namespace leaf {
 
 	////////////////////////////////////////////
 
+#if LEAF_CONTEXT_POOL_SIZE
+
+	namespace leaf_detail
+	{
+		// A per-thread cache of up to LEAF_CONTEXT_POOL_SIZE memory blocks for
+		// objects of type T, obtained from (and eventually returned to) the
+		// stateless allocator Alloc. Used by make_shared_context and
+		// allocate_shared_context to recycle the memory of captured contexts.
+		//
+		// A block is returned to the cache of the thread that frees it, so
+		// recycling only helps threads that free the contexts they allocate.
+		// When contexts are allocated by one thread and freed by another, the
+		// allocating thread always gets new blocks, and the freeing thread
+		// keeps at most LEAF_CONTEXT_POOL_SIZE of them.
+		template <class T, class Alloc>
+		class context_block_cache
+		{
+			context_block_cache( context_block_cache const & ) = delete;
+			context_block_cache & operator=( context_block_cache const & ) = delete;
+
+			struct block
+			{
+				block * next;
+			};
+
+			static_assert(sizeof(T)>=sizeof(block), "Block too small");
+
+			using alloc_traits = typename std::allocator_traits<Alloc>::template rebind_traits<T>;
+			using allocator_type = typename alloc_traits::allocator_type;
+
+			allocator_type alloc_;
+			block * free_;
+			int cached_;
+
+			explicit context_block_cache( Alloc const & a ) noexcept:
+				alloc_(a),
+				free_(0),
+				cached_(0)
+			{
+			}
+
+			~context_block_cache() noexcept
+			{
+				while( block * b = free_ )
+				{
+					free_ = b->next;
+					alloc_traits::deallocate(alloc_, reinterpret_cast<T *>(b), 1);
+				}
+				tl_destroyed() = true;
+			}
+
+			// Set when the calling thread's cache is destroyed. It is kept
+			// apart from the cache (and is trivially destructible), so that
+			// blocks freed after that (e.g. by other thread_local objects)
+			// can go straight back to the allocator without touching it.
+			static bool & tl_destroyed() noexcept
+			{
+				static LEAF_THREAD_LOCAL bool d;
+				return d;
+			}
+
+			static context_block_cache & tl_instance( Alloc const & a ) noexcept
+			{
+				static LEAF_THREAD_LOCAL context_block_cache c(a);
+				return c;
+			}
+
+		public:
+
+			static T * allocate( Alloc const & a )
+			{
+				if( !tl_destroyed() )
+				{
+					context_block_cache & c = tl_instance(a);
+					if( block * b = c.free_ )
+					{
+						c.free_ = b->next;
+						--c.cached_;
+						return reinterpret_cast<T *>(b);
+					}
+				}
+				allocator_type al(a);
+				return alloc_traits::allocate(al, 1);
+			}
+
+			static void deallocate( Alloc const & a, T * p ) noexcept
+			{
+				assert(p!=0);
+				if( !tl_destroyed() )
+				{
+					context_block_cache & c = tl_instance(a);
+					if( c.cached_<LEAF_CONTEXT_POOL_SIZE )
+					{
+						block * b = reinterpret_cast<block *>(p);
+						b->next = c.free_;
+						c.free_ = b;
+						++c.cached_;
+						return;
+					}
+				}
+				allocator_type al(a);
+				alloc_traits::deallocate(al, p, 1);
+			}
+		};
+	}
+
+#endif
+
+	////////////////////////////////////////////
+
 	class polymorphic_context
 	{
 	protected:
@@ -1528,6 +2936,9 @@ namespace boost { namespace leaf {
 		virtual void deactivate( bool propagate_errors ) noexcept = 0;
 		virtual bool is_active() const noexcept = 0;
 		virtual void print( std::ostream & ) const = 0;
+		// Not pure, so that classes derived from polymorphic_context outside of
+		// LEAF need not implement it; by default no E-objects are serialized.
+		virtual std::size_t serialize( char *, std::size_t ) const { return 0; }
 		error_id captured_id_;
 	};
 
@@ -1588,7 +2999,7 @@ namespace boost { namespace leaf {
 						bool has_exception = LEAF_UNCAUGHT_EXCEPTIONS();
 						ctx_->deactivate(has_exception);
 						if( !has_exception )
-							(void) leaf_detail::new_id();
+							leaf_detail::reset_last_id();
 #endif
 					}
 					else
@@ -1610,6 +3021,20 @@ namespace boost { namespace leaf {
 
 	////////////////////////////////////////////
 
+	namespace leaf_detail
+	{
+#ifdef LEAF_NO_CAPTURE_IN_RESULT
+		using default_result_ctx_ptr = void;
+#else
+		using default_result_ctx_ptr = context_ptr;
+#endif
+	}
+
+	// A result<T, void> can't transport a context captured by capture, see
+	// nocapture_result.
+	template <class T, class CtxPtr = leaf_detail::default_result_ctx_ptr>
+	class result;
+
 	template <class R>
 	struct is_result_type: std::false_type
 	{
@@ -1636,9 +3061,66 @@ namespace boost { namespace leaf {
 		};
 	}
 
+	////////////////////////////////////////////
+
+#ifndef LEAF_NO_EXCEPTIONS
+
+	namespace leaf_detail
+	{
+		// Checking the dynamic type of an exception against a list of exception
+		// types takes one dynamic_cast per type. The result (bit I is set if the
+		// exception is of the I-th type) depends only on the dynamic type, so it
+		// is cached for the last type seen, per list of types and per thread.
+#ifndef LEAF_NO_RTTI
+		struct exception_type_cache
+		{
+			std::type_info const * type;
+			std::uint64_t mask;
+		};
+#endif
+
+		template <class... Ex, std::size_t... I>
+		inline std::uint64_t get_exception_type_mask_( std::exception const * ex, leaf_detail_mp11::index_sequence<I...> ) noexcept
+		{
+			std::uint64_t const bits[ ] = { 0, ((dynamic_cast<Ex const *>(ex)!=0 ? std::uint64_t(1) : 0) << I)... };
+			std::uint64_t mask = 0;
+			for( std::uint64_t b : bits )
+				mask |= b;
+			return mask;
+		}
+
+		template <class... Ex>
+		inline std::uint64_t get_exception_type_mask_( std::exception const *, leaf_detail_mp11::index_sequence<> ) noexcept
+		{
+			return 0;
+		}
+
+		template <class... Ex>
+		inline std::uint64_t get_exception_type_mask( std::exception const & ex ) noexcept
+		{
+			static_assert(sizeof...(Ex)<=64, "Too many exception types");
+#ifdef LEAF_NO_RTTI
+			return get_exception_type_mask_<Ex...>(&ex, leaf_detail_mp11::make_index_sequence<sizeof...(Ex)>());
+#else
+			static LEAF_THREAD_LOCAL exception_type_cache c;
+			std::type_info const * type = &typeid(ex);
+			if( c.type!=type )
+			{
+				c.mask = get_exception_type_mask_<Ex...>(&ex, leaf_detail_mp11::make_index_sequence<sizeof...(Ex)>());
+				c.type = type;
+			}
+			return c.mask;
+#endif
+		}
+	}
+
+#endif
+
 } }
 
 #undef LEAF_THREAD_LOCAL
+#undef LEAF_STACKTRACE_WINDOWS
+#undef LEAF_STACKTRACE_EXECINFO
 
 #endif
 // <<< #include <boost/leaf/error.hpp>
@@ -1784,6 +3266,7 @@ namespace boost { namespace leaf {
 		template <class R, class F, class... A>
 		inline decltype(std::declval<F>()(std::forward<A>(std::declval<A>())...)) capture_impl(is_result_tag<R, true>, context_ptr && ctx, F && f, A... a)
 		{
+			static_assert(std::is_constructible<R, context_ptr &&>::value, "capture can't be used with functions that return a nocapture_result");
 			auto active_context = activate_context(*ctx, on_deactivation::do_not_propagate);
 			try
 			{
@@ -1820,6 +3303,7 @@ namespace boost { namespace leaf {
 		template <class R, class F, class... A>
 		inline decltype(std::declval<F>()(std::forward<A>(std::declval<A>())...)) capture_impl(is_result_tag<R, true>, context_ptr && ctx, F && f, A... a)
 		{
+			static_assert(std::is_constructible<R, context_ptr &&>::value, "capture can't be used with functions that return a nocapture_result");
 			auto active_context = activate_context(*ctx, on_deactivation::do_not_propagate);
 			if( auto r = std::forward<F>(f)(std::forward<A>(a)...) )
 				return r;
@@ -1844,23 +3328,24 @@ namespace boost { namespace leaf {
 
 #ifndef LEAF_NO_EXCEPTIONS
 
-	template <class T>
-	class result;
-
 	namespace leaf_detail
 	{
-		inline error_id catch_exceptions_helper( std::exception const & ex, leaf_detail_mp11::mp_list<> )
+		inline error_id catch_exceptions_helper( std::exception const &, std::uint64_t, leaf_detail_mp11::mp_list<> )
 		{
 			return leaf::new_error(std::current_exception());
 		}
 
 		template <class Ex1, class... Ex>
-		inline error_id catch_exceptions_helper( std::exception const & ex, leaf_detail_mp11::mp_list<Ex1,Ex...> )
+		inline error_id catch_exceptions_helper( std::exception const & ex, std::uint64_t mask, leaf_detail_mp11::mp_list<Ex1,Ex...> )
 		{
-			if( Ex1 const * p = dynamic_cast<Ex1 const *>(&ex) )
-				return catch_exceptions_helper(ex, leaf_detail_mp11::mp_list<Ex...>{ }).load(*p);
+			if( mask & 1 )
+			{
+				Ex1 const * p = dynamic_cast<Ex1 const *>(&ex);
+				assert(p!=0);
+				return catch_exceptions_helper(ex, mask>>1, leaf_detail_mp11::mp_list<Ex...>{ }).load(*p);
+			}
 			else
-				return catch_exceptions_helper(ex, leaf_detail_mp11::mp_list<Ex...>{ });
+				return catch_exceptions_helper(ex, mask>>1, leaf_detail_mp11::mp_list<Ex...>{ });
 		}
 
 		template <class T>
@@ -1869,10 +3354,10 @@ namespace boost { namespace leaf {
 			using type = result<T>;
 		};
 
-		template <class T>
-		struct deduce_exception_to_result_return_type_impl<result<T>>
+		template <class T, class CtxPtr>
+		struct deduce_exception_to_result_return_type_impl<result<T, CtxPtr>>
 		{
-			using type = result<T>;
+			using type = result<T, CtxPtr>;
 		};
 
 		template <class T>
@@ -1888,7 +3373,7 @@ namespace boost { namespace leaf {
 		}
 		catch( std::exception const & ex )
 		{
-			return leaf_detail::catch_exceptions_helper(ex, leaf_detail_mp11::mp_list<Ex...>());
+			return leaf_detail::catch_exceptions_helper(ex, leaf_detail::get_exception_type_mask<Ex...>(ex), leaf_detail_mp11::mp_list<Ex...>());
 		}
 		catch(...)
 		{
@@ -2000,38 +3485,313 @@ namespace boost { namespace leaf {
 
 // Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
 
-// Distributed under the Boost Software License, Version 1.0. (See accompanying
-// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace boost { namespace leaf {
+
+	namespace leaf_detail
+	{
+		template <class E, bool>
+		struct serialize_slot;
+	}
+
+	class serialization_writer
+	{
+		serialization_writer( serialization_writer const & ) = delete;
+		serialization_writer & operator=( serialization_writer const & ) = delete;
+
+		template <class E, bool>
+		friend struct leaf_detail::serialize_slot;
+
+		char * const buf_;
+		std::size_t const capacity_;
+		std::size_t size_;
+
+		template <class T>
+		void patch_value( std::size_t pos, T const & x ) noexcept
+		{
+			assert(pos+sizeof(T)<=size_);
+			if( size_<=capacity_ )
+				std::memcpy(buf_+pos, &x, sizeof(T));
+		}
+
+	public:
+
+		serialization_writer( char * buf, std::size_t capacity ) noexcept:
+			buf_(buf),
+			capacity_(capacity),
+			size_(0)
+		{
+			assert(buf_!=0 || capacity_==0);
+		}
+
+		// Returns the number of bytes written so far. If it is greater than the
+		// capacity of the buffer, the excess bytes were not stored.
+		std::size_t size() const noexcept
+		{
+			return size_;
+		}
+
+		void write_bytes( void const * data, std::size_t n ) noexcept
+		{
+			if( size_<=capacity_ && n<=capacity_-size_ )
+				std::memcpy(buf_+size_, data, n);
+			size_ += n;
+		}
+
+		template <class T>
+		void write_value( T const & x ) noexcept
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "write_value requires a trivially copyable type");
+			write_bytes(&x, sizeof(T));
+		}
+
+		void write_string( char const * s, std::size_t n ) noexcept
+		{
+			write_value(std::uint32_t(n));
+			write_bytes(s, n);
+		}
+
+		void write_string( std::string const & s ) noexcept
+		{
+			write_string(s.data(), s.size());
+		}
+	};
+
+	class serialization_reader
+	{
+		serialization_reader( serialization_reader const & ) = delete;
+		serialization_reader & operator=( serialization_reader const & ) = delete;
+
+		char const * p_;
+		char const * const end_;
+
+	public:
+
+		serialization_reader( char const * buf, std::size_t size ) noexcept:
+			p_(buf),
+			end_(buf+size)
+		{
+			assert(buf!=0 || size==0);
+		}
+
+		std::size_t remaining() const noexcept
+		{
+			return std::size_t(end_-p_);
+		}
+
+		bool read_bytes( void * data, std::size_t n ) noexcept
+		{
+			if( n>remaining() )
+				return false;
+			std::memcpy(data, p_, n);
+			p_ += n;
+			return true;
+		}
+
+		bool skip( std::size_t n ) noexcept
+		{
+			if( n>remaining() )
+				return false;
+			p_ += n;
+			return true;
+		}
+
+		template <class T>
+		bool read_value( T & x ) noexcept
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "read_value requires a trivially copyable type");
+			return read_bytes(&x, sizeof(T));
+		}
+
+		bool read_string( std::string & s )
+		{
+			std::uint32_t n;
+			if( !read_value(n) || n>remaining() )
+				return false;
+			s.assign(p_, n);
+			p_ += n;
+			return true;
+		}
+	};
+
+	// Specialize to enable serialization of E-objects of type E, see serialize.
+	template <class E>
+	struct serialization;
+
+	template <class E>
+	struct trivial_serialization
+	{
+		static_assert(std::is_trivially_copyable<E>::value, "trivial_serialization requires a trivially copyable type");
+
+		static void write( serialization_writer & w, E const & e ) noexcept
+		{
+			w.write_value(e);
+		}
+
+		static bool read( serialization_reader & r, E & e ) noexcept
+		{
+			return r.read_value(e);
+		}
+	};
+
+	namespace leaf_detail
+	{
+		template <class E, class = void>
+		struct is_serializable: std::false_type
+		{
+		};
+
+		template <class E>
+		struct is_serializable<E, decltype(serialization<E>::write(std::declval<serialization_writer &>(), std::declval<E const &>()), void())>: std::true_type
+		{
+		};
+
+		// Serialized context format (native byte order):
+		//   char[4]       "LEAF"
+		//   std::uint32_t number of E-objects
+		//   For each E-object:
+		//     std::uint64_t type_name hash of its E-type
+		//     std::uint32_t size of the serialized E-object
+		//     char[size]    data written by serialization<E>::write
+		LEAF_CONSTEXPR inline char const * serialization_magic() noexcept { return "LEAF"; }
+		constexpr std::size_t serialization_magic_size = 4;
+
+		inline bool read_serialization_header( serialization_reader & r, std::uint32_t & n ) noexcept
+		{
+			char magic[serialization_magic_size];
+			return r.read_bytes(magic, sizeof(magic)) && std::memcmp(magic, serialization_magic(), sizeof(magic))==0 && r.read_value(n);
+		}
+
+		template <class E, bool = is_serializable<E>::value>
+		struct serialize_slot
+		{
+			static void count( slot<E> const &, id_type, std::uint32_t & ) noexcept
+			{
+			}
+
+			static void write( slot<E> const &, id_type, serialization_writer & ) noexcept
+			{
+			}
+
+			static bool read( slot<E> &, id_type, std::uint64_t, serialization_reader & ) noexcept
+			{
+				return false;
+			}
+		};
+
+		template <class E>
+		struct serialize_slot<E, true>
+		{
+			static void count( slot<E> const & sl, id_type err_id, std::uint32_t & n ) noexcept
+			{
+				if( sl.has_value(err_id) )
+					++n;
+			}
+
+			static void write( slot<E> const & sl, id_type err_id, serialization_writer & w )
+			{
+				if( E const * e = sl.has_value(err_id) )
+				{
+					w.write_value(type<E>().hash);
+					std::size_t const size_pos = w.size();
+					w.write_value(std::uint32_t(0));
+					serialization<E>::write(w, *e);
+					w.patch_value(size_pos, std::uint32_t(w.size()-size_pos-sizeof(std::uint32_t)));
+				}
+			}
+
+			// Returns false if the hash does not match E. The reader is
+			// bounded by the size of the serialized E-object.
+			static bool read( slot<E> & sl, id_type err_id, std::uint64_t hash, serialization_reader & r )
+			{
+				static_assert(std::is_default_constructible<E>::value, "deserialize requires serializable E-types to be default-constructible");
+				if( hash!=type<E>().hash )
+					return false;
+				E e{};
+				if( serialization<E>::read(r, e) )
+					(void) sl.put(err_id, std::move(e));
+				return true;
+			}
+		};
+
+		template <class E>
+		inline void serialize_slot_count( slot<E> const & sl, id_type err_id, std::uint32_t & n ) noexcept
+		{
+			serialize_slot<E>::count(sl, err_id, n);
+		}
 
+		template <class E>
+		inline void serialize_slot_write( slot<E> const & sl, id_type err_id, serialization_writer & w )
+		{
+			serialize_slot<E>::write(sl, err_id, w);
+		}
 
-namespace boost { namespace leaf {
+		template <class E>
+		inline bool serialize_slot_read( slot<E> & sl, id_type err_id, std::uint64_t hash, serialization_reader & r )
+		{
+			return serialize_slot<E>::read(sl, err_id, hash, r);
+		}
+	}
 
 	namespace leaf_detail
 	{
 		template <int I, class Tuple>
 		struct tuple_for_each
 		{
-			LEAF_CONSTEXPR static void activate( Tuple & tup ) noexcept
+			LEAF_CONSTEXPR static void activate( Tuple & tup, tl_slot_table table ) noexcept
+			{
+				tuple_for_each<I-1,Tuple>::activate(tup, table);
+				std::get<I-1>(tup).activate(table);
+			}
+
+			// Propagates errors only from the slots whose bits are set in
+			// propagate_mask. Returns the bits of the slots which still hold
+			// E-objects afterwards.
+			LEAF_CONSTEXPR static dirty_mask deactivate( Tuple & tup, dirty_mask propagate_mask ) noexcept
 			{
-				tuple_for_each<I-1,Tuple>::activate(tup);
-				std::get<I-1>(tup).activate();
+				dirty_mask const bit = dirty_bit(I-1);
+				dirty_mask holds_value = std::get<I-1>(tup).deactivate((propagate_mask & bit)!=0) ? bit : 0;
+				return tuple_for_each<I-1,Tuple>::deactivate(tup, propagate_mask) | holds_value;
 			}
 
-			LEAF_CONSTEXPR static void deactivate( Tuple & tup, bool propagate_errors ) noexcept
+			LEAF_CONSTEXPR static void bind_owner( Tuple & tup, dirty_mask * mask ) noexcept
 			{
-				std::get<I-1>(tup).deactivate(propagate_errors);
-				tuple_for_each<I-1,Tuple>::deactivate(tup, propagate_errors);
+				tuple_for_each<I-1,Tuple>::bind_owner(tup, mask);
+				std::get<I-1>(tup).bind_owner(mask, dirty_bit(I-1));
 			}
 
-			LEAF_CONSTEXPR static void propagate( Tuple & tup, int err_id ) noexcept
+			LEAF_CONSTEXPR static void propagate( Tuple & tup, id_type err_id, tl_slot_table table ) noexcept
 			{
 				auto & sl = std::get<I-1>(tup);
 				if( sl.has_value(err_id) )
-					leaf_detail::load_slot(err_id, std::move(sl).value(err_id));
-				tuple_for_each<I-1,Tuple>::propagate(tup, err_id);
+					leaf_detail::load_slot(err_id, std::move(sl).value(err_id), table);
+				tuple_for_each<I-1,Tuple>::propagate(tup, err_id, table);
+			}
+
+			static void serialize_count( Tuple const & tup, id_type err_id, std::uint32_t & n ) noexcept
+			{
+				tuple_for_each<I-1,Tuple>::serialize_count(tup, err_id, n);
+				serialize_slot_count(std::get<I-1>(tup), err_id, n);
 			}
 
-			static void print( std::ostream & os, void const * tup, int key_to_print )
+			static void serialize( Tuple const & tup, id_type err_id, serialization_writer & w )
+			{
+				tuple_for_each<I-1,Tuple>::serialize(tup, err_id, w);
+				serialize_slot_write(std::get<I-1>(tup), err_id, w);
+			}
+
+			static bool deserialize( Tuple & tup, id_type err_id, std::uint64_t hash, serialization_reader & r )
+			{
+				return serialize_slot_read(std::get<I-1>(tup), err_id, hash, r) || tuple_for_each<I-1,Tuple>::deserialize(tup, err_id, hash, r);
+			}
+
+			static void print( std::ostream & os, void const * tup, id_type key_to_print )
 			{
 				assert(tup!=0);
 				tuple_for_each<I-1,Tuple>::print(os, tup, key_to_print);
@@ -2042,10 +3802,14 @@ namespace boost { namespace leaf {
 		template <class Tuple>
 		struct tuple_for_each<0, Tuple>
 		{
-			LEAF_CONSTEXPR static void activate( Tuple & ) noexcept { }
-			LEAF_CONSTEXPR static void deactivate( Tuple &, bool ) noexcept { }
-			LEAF_CONSTEXPR static void propagate( Tuple & tup, int ) noexcept { }
-			static void print( std::ostream &, void const *, int ) { }
+			LEAF_CONSTEXPR static void activate( Tuple &, tl_slot_table ) noexcept { }
+			LEAF_CONSTEXPR static dirty_mask deactivate( Tuple &, dirty_mask ) noexcept { return 0; }
+			LEAF_CONSTEXPR static void bind_owner( Tuple &, dirty_mask * ) noexcept { }
+			LEAF_CONSTEXPR static void propagate( Tuple &, id_type, tl_slot_table ) noexcept { }
+			static void serialize_count( Tuple const &, id_type, std::uint32_t & ) noexcept { }
+			static void serialize( Tuple const &, id_type, serialization_writer & ) noexcept { }
+			static bool deserialize( Tuple &, id_type, std::uint64_t, serialization_reader & ) noexcept { return false; }
+			static void print( std::ostream &, void const *, id_type ) { }
 		};
 	}
 
@@ -2184,20 +3948,35 @@ namespace boost { namespace leaf {
 #if !defined(LEAF_NO_THREADS) && !defined(NDEBUG)
 			std::thread::id thread_id_;
 #endif
+			dirty_mask dirty_mask_; // The bits of the slots in tup_ that may hold E-objects, see slot<E>::put.
 			bool is_active_;
+#if LEAF_DIAGNOSTICS==2
+			bool unexpected_enabled_;
+#endif
 
 		public:
 
 			LEAF_CONSTEXPR context_base() noexcept:
+				dirty_mask_(0),
 				is_active_(false)
+#if LEAF_DIAGNOSTICS==2
+				, unexpected_enabled_(false)
+#endif
 			{
+				leaf_detail::tuple_for_each<std::tuple_size<Tup>::value,Tup>::bind_owner(tup_, &dirty_mask_);
 			}
 
 			LEAF_CONSTEXPR context_base( context_base && x ) noexcept:
 				tup_(std::move(x.tup_)),
+				dirty_mask_(x.dirty_mask_),
 				is_active_(false)
+#if LEAF_DIAGNOSTICS==2
+				, unexpected_enabled_(false)
+#endif
 			{
 				assert(!x.is_active());
+				x.dirty_mask_ = 0;
+				leaf_detail::tuple_for_each<std::tuple_size<Tup>::value,Tup>::bind_owner(tup_, &dirty_mask_);
 			}
 
 			~context_base() noexcept
@@ -2214,8 +3993,12 @@ namespace boost { namespace leaf {
 			{
 				using namespace leaf_detail;
 				assert(!is_active());
-				tuple_for_each<std::tuple_size<Tup>::value,Tup>::activate(tup_);
-#if LEAF_DIAGNOSTICS
+				tuple_for_each<std::tuple_size<Tup>::value,Tup>::activate(tup_, get_tl_slot_table());
+#if LEAF_DIAGNOSTICS==2
+				if( unexpected_requested<Tup>::value )
+					if( (unexpected_enabled_ = sample_diagnostics()) )
+						++tl_unexpected_enabled_counter();
+#elif LEAF_DIAGNOSTICS
 				if( unexpected_requested<Tup>::value )
 					++tl_unexpected_enabled_counter();
 #endif
@@ -2234,11 +4017,19 @@ namespace boost { namespace leaf {
 				assert(std::this_thread::get_id() == thread_id_);
 				thread_id_ = std::thread::id();
 #endif
-#if LEAF_DIAGNOSTICS
+#if LEAF_DIAGNOSTICS==2
+				if( unexpected_requested<Tup>::value && unexpected_enabled_ )
+					--tl_unexpected_enabled_counter();
+#elif LEAF_DIAGNOSTICS
 				if( unexpected_requested<Tup>::value )
 					--tl_unexpected_enabled_counter();
 #endif
-				tuple_for_each<std::tuple_size<Tup>::value,Tup>::deactivate(tup_, propagate_errors);
+				// Only the slots written to (since they were last emptied) are
+				// checked for E-objects to propagate.
+				if( propagate_errors )
+					dirty_mask_ = tuple_for_each<std::tuple_size<Tup>::value,Tup>::deactivate(tup_, dirty_mask_);
+				else
+					(void) tuple_for_each<std::tuple_size<Tup>::value,Tup>::deactivate(tup_, 0);
 			}
 
 			LEAF_CONSTEXPR bool is_active() const noexcept
@@ -2251,11 +4042,58 @@ namespace boost { namespace leaf {
 				leaf_detail::tuple_for_each<std::tuple_size<Tup>::value,Tup>::print(os, &tup_, 0);
 			}
 
+			std::size_t serialize( error_id err_id, char * buf, std::size_t size ) const
+			{
+				using namespace leaf_detail;
+				serialization_writer w(buf, size);
+				w.write_bytes(serialization_magic(), serialization_magic_size);
+				std::uint32_t n = 0;
+				tuple_for_each<std::tuple_size<Tup>::value,Tup>::serialize_count(tup_, err_id.value(), n);
+				w.write_value(n);
+				tuple_for_each<std::tuple_size<Tup>::value,Tup>::serialize(tup_, err_id.value(), w);
+				return w.size();
+			}
+
+			error_id deserialize( char const * buf, std::size_t size )
+			{
+				using namespace leaf_detail;
+				assert(!is_active());
+				std::uint32_t n;
+				{
+					// Check the whole buffer first, so that nothing is stored if
+					// it is truncated.
+					serialization_reader r(buf, size);
+					if( !read_serialization_header(r, n) )
+						return error_id();
+					for( std::uint32_t i=0; i!=n; ++i )
+					{
+						std::uint64_t hash;
+						std::uint32_t obj_size;
+						if( !r.read_value(hash) || !r.read_value(obj_size) || !r.skip(obj_size) )
+							return error_id();
+					}
+				}
+				serialization_reader r(buf, size);
+				(void) read_serialization_header(r, n);
+				error_id err_id = make_error_id(new_id());
+				for( ; n; --n )
+				{
+					std::uint64_t hash = 0;
+					std::uint32_t obj_size = 0;
+					(void) r.read_value(hash);
+					(void) r.read_value(obj_size);
+					serialization_reader obj(buf+(size-r.remaining()), obj_size);
+					(void) tuple_for_each<std::tuple_size<Tup>::value,Tup>::deserialize(tup_, err_id.value(), hash, obj);
+					(void) r.skip(obj_size);
+				}
+				return err_id;
+			}
+
 		protected:
 
 			LEAF_CONSTEXPR error_id propagate_captured_errors( error_id err_id ) noexcept
 			{
-				tuple_for_each<std::tuple_size<Tup>::value,Tup>::propagate(tup_, err_id.value());
+				tuple_for_each<std::tuple_size<Tup>::value,Tup>::propagate(tup_, err_id.value(), get_tl_slot_table());
 				return err_id;
 			}
 
@@ -2435,6 +4273,7 @@ namespace boost { namespace leaf {
 			void deactivate( bool propagate_errors ) noexcept final override { Ctx::deactivate(propagate_errors); }
 			bool is_active() const noexcept final override { return Ctx::is_active(); }
 			void print( std::ostream & os ) const final override { return Ctx::print(os); }
+			std::size_t serialize( char * buf, std::size_t size ) const final override { return Ctx::serialize(captured_id_, buf, size); }
 		};
 	}
 
@@ -2456,16 +4295,111 @@ namespace boost { namespace leaf {
 		return { };
 	}
 
-	template <class RemoteH>
-	inline context_ptr make_shared_context( RemoteH const * = 0 )
+	inline std::size_t serialize( polymorphic_context const & ctx, char * buf, std::size_t size )
+	{
+		return ctx.serialize(buf, size);
+	}
+
+	template <class Ctx>
+	inline error_id deserialize( char const * buf, std::size_t size, Ctx & ctx )
+	{
+		return ctx.deserialize(buf, size);
+	}
+
+	namespace leaf_detail
 	{
-		return std::make_shared<leaf_detail::polymorphic_context_impl<context_type_from_remote_handler<RemoteH>>>();
+#if LEAF_CONTEXT_POOL_SIZE
+		// An allocator which recycles single-object blocks through the calling
+		// thread's context_block_cache, falling back to Alloc. Passed to
+		// std::allocate_shared, it recycles the combined memory of the context
+		// and its shared_ptr control block, which is freed (into the cache of
+		// the thread which drops the last reference) together with the last
+		// result or exception that refers to the context.
+		template <class T, class Alloc>
+		class context_pool_allocator
+		{
+			template <class, class>
+			friend class context_pool_allocator;
+
+			Alloc alloc_;
+
+		public:
+
+			using value_type = T;
+
+			template <class U>
+			struct rebind
+			{
+				using other = context_pool_allocator<U, Alloc>;
+			};
+
+			explicit context_pool_allocator( Alloc const & a ) noexcept:
+				alloc_(a)
+			{
+			}
+
+			template <class U>
+			context_pool_allocator( context_pool_allocator<U, Alloc> const & x ) noexcept:
+				alloc_(x.alloc_)
+			{
+			}
+
+			T * allocate( std::size_t n )
+			{
+				if( n==1 )
+					return context_block_cache<T, Alloc>::allocate(alloc_);
+				typename std::allocator_traits<Alloc>::template rebind_alloc<T> a(alloc_);
+				return std::allocator_traits<decltype(a)>::allocate(a, n);
+			}
+
+			void deallocate( T * p, std::size_t n ) noexcept
+			{
+				if( n==1 )
+					return context_block_cache<T, Alloc>::deallocate(alloc_, p);
+				typename std::allocator_traits<Alloc>::template rebind_alloc<T> a(alloc_);
+				std::allocator_traits<decltype(a)>::deallocate(a, p, n);
+			}
+
+			template <class U>
+			bool operator==( context_pool_allocator<U, Alloc> const & ) const noexcept
+			{
+				return true;
+			}
+
+			template <class U>
+			bool operator!=( context_pool_allocator<U, Alloc> const & ) const noexcept
+			{
+				return false;
+			}
+		};
+
+		// Only stateless allocators can be pooled: a block cached by one
+		// allocator object may be handed out by (and returned to) another.
+		template <class Ctx, class Alloc>
+		inline context_ptr allocate_shared_context_impl( Alloc const & alloc, std::true_type )
+		{
+			return std::allocate_shared<Ctx>(context_pool_allocator<Ctx, Alloc>(alloc));
+		}
+#endif
+
+		template <class Ctx, class Alloc>
+		inline context_ptr allocate_shared_context_impl( Alloc const & alloc, std::false_type )
+		{
+			return std::allocate_shared<Ctx>(alloc);
+		}
 	}
 
 	template <class RemoteH, class Alloc>
 	inline context_ptr allocate_shared_context( Alloc alloc, RemoteH const * = 0 )
 	{
-		return std::make_shared<leaf_detail::polymorphic_context_impl<context_type_from_remote_handler<RemoteH>>>(alloc);
+		using pooled = std::integral_constant<bool, LEAF_CONTEXT_POOL_SIZE && std::is_empty<Alloc>::value>;
+		return leaf_detail::allocate_shared_context_impl<leaf_detail::polymorphic_context_impl<context_type_from_remote_handler<RemoteH>>>(alloc, pooled());
+	}
+
+	template <class RemoteH>
+	inline context_ptr make_shared_context( RemoteH const * h = 0 )
+	{
+		return allocate_shared_context(std::allocator<char>(), h);
 	}
 } }
 
@@ -2586,7 +4520,7 @@ namespace boost { namespace leaf {
 	{
 		leaf_detail::e_unexpected_count const * e_uc_;
 		void const * tup_;
-		void (*print_)( std::ostream &, void const * tup, int key_to_print );
+		void (*print_)( std::ostream &, void const * tup, leaf_detail::id_type key_to_print );
 
 	public:
 
@@ -2615,7 +4549,7 @@ namespace boost { namespace leaf {
 	{
 		leaf_detail::e_unexpected_info const * e_ui_;
 		void const * tup_;
-		void (*print_)( std::ostream &, void const * tup, int key_to_print );
+		void (*print_)( std::ostream &, void const * tup, leaf_detail::id_type key_to_print );
 
 	public:
 
@@ -2684,6 +4618,91 @@ namespace boost { namespace leaf {
 
 	////////////////////////////////////////
 
+	namespace leaf_detail
+	{
+		// Output goes to a caller-supplied buffer; whatever does not fit is
+		// discarded.
+		class buffer_streambuf: public std::streambuf
+		{
+		public:
+
+			buffer_streambuf( char * buf, std::size_t size ) noexcept
+			{
+				assert(buf!=0);
+				assert(size>0);
+				setp(buf, buf+size-1);
+			}
+
+			std::size_t finish() noexcept
+			{
+				*pptr() = 0;
+				return std::size_t(pptr()-pbase());
+			}
+		};
+
+		// Output is collected in an internal buffer which is passed to the sink
+		// only when it is full, and once more by finish().
+		template <class Sink>
+		class sink_streambuf: public std::streambuf
+		{
+			Sink & sink_;
+			char buf_[512];
+
+			void flush_buf()
+			{
+				if( std::size_t n = std::size_t(pptr()-pbase()) )
+					sink_(static_cast<char const *>(buf_), n);
+				setp(buf_, buf_+sizeof(buf_));
+			}
+
+			int_type overflow( int_type c ) final override
+			{
+				flush_buf();
+				if( !traits_type::eq_int_type(c, traits_type::eof()) )
+				{
+					*pptr() = traits_type::to_char_type(c);
+					pbump(1);
+				}
+				return traits_type::not_eof(c);
+			}
+
+		public:
+
+			explicit sink_streambuf( Sink & sink ) noexcept:
+				sink_(sink)
+			{
+				setp(buf_, buf_+sizeof(buf_));
+			}
+
+			void finish()
+			{
+				flush_buf();
+			}
+		};
+	}
+
+	template <class T>
+	std::size_t format_to_buffer( char * buf, std::size_t size, T const & x )
+	{
+		leaf_detail::buffer_streambuf sb(buf, size);
+		std::ostream os(&sb);
+		os << x;
+		return sb.finish();
+	}
+
+	template <class Sink, class T>
+	void format_to_sink( Sink && sink, T const & x )
+	{
+		leaf_detail::sink_streambuf<typename std::remove_reference<Sink>::type> sb(sink);
+		{
+			std::ostream os(&sb);
+			os << x;
+		}
+		sb.finish();
+	}
+
+	////////////////////////////////////////
+
 	namespace leaf_detail
 	{
 		template <class T, class... List>
@@ -2715,6 +4734,40 @@ namespace boost { namespace leaf {
 		{
 			return err ? std::get<tuple_type_index<slot<E>,SlotsTuple>::value>(tup).has_value(err.value()) : 0;
 		}
+
+		// With LEAF_HANDLER_PRESENCE_MASK, bit I of the presence mask of a slots
+		// tuple is set if the I-th slot holds an E-object associated with the
+		// error being handled. Slots past the 64th are not represented in the
+		// mask, and are checked with peek instead.
+		using presence_mask = std::uint64_t;
+
+		template <int I>
+		constexpr presence_mask slot_bit() noexcept
+		{
+			return I<64 ? presence_mask(1)<<(I%64) : 0;
+		}
+
+		template <class E, class SlotsTuple>
+		struct slot_mask
+		{
+			constexpr static presence_mask value = slot_bit<tuple_type_index<slot<E>,SlotsTuple>::value>();
+		};
+
+		template <class SlotsTuple, std::size_t... I>
+		LEAF_CONSTEXPR inline presence_mask get_presence_mask_( SlotsTuple const & tup, id_type err_id, leaf_detail_mp11::index_sequence<I...> ) noexcept
+		{
+			presence_mask const bits[ ] = { 0, (slot_bit<I>() * (std::get<I>(tup).key()==err_id))... };
+			presence_mask pm = 0;
+			for( presence_mask b : bits )
+				pm |= b;
+			return pm;
+		}
+
+		template <class SlotsTuple>
+		LEAF_CONSTEXPR inline presence_mask get_presence_mask( SlotsTuple const & tup, error_id err ) noexcept
+		{
+			return err ? get_presence_mask_(tup, err.value(), leaf_detail_mp11::make_index_sequence<std::tuple_size<SlotsTuple>::value>()) : 0;
+		}
 	}
 
 	////////////////////////////////////////
@@ -2807,6 +4860,115 @@ namespace boost { namespace leaf {
 		{
 			return x==v1 || check_value_pack(x,v_rest...);
 		}
+
+		// When a match<> pack has at least LEAF_MATCH_LOOKUP_TABLE_MIN integral or
+		// enum values that fit in a small range (no more than 64 possible values per
+		// value in the pack), it is converted at compile time to a bitset indexed by
+		// the value being matched, so it is checked with a single load instead of a
+		// chain of == comparisons.
+
+		constexpr std::intmax_t min_enumerator( std::intmax_t v ) noexcept
+		{
+			return v;
+		}
+
+		template <class... Rest>
+		constexpr std::intmax_t min_enumerator( std::intmax_t v1, std::intmax_t v2, Rest... v_rest ) noexcept
+		{
+			return min_enumerator(v1<v2 ? v1 : v2, v_rest...);
+		}
+
+		constexpr std::intmax_t max_enumerator( std::intmax_t v ) noexcept
+		{
+			return v;
+		}
+
+		template <class... Rest>
+		constexpr std::intmax_t max_enumerator( std::intmax_t v1, std::intmax_t v2, Rest... v_rest ) noexcept
+		{
+			return max_enumerator(v1<v2 ? v2 : v1, v_rest...);
+		}
+
+		constexpr std::uint64_t enumerator_bitset_word( std::intmax_t, std::size_t ) noexcept
+		{
+			return 0;
+		}
+
+		template <class... Rest>
+		constexpr std::uint64_t enumerator_bitset_word( std::intmax_t min, std::size_t word, std::intmax_t v1, Rest... v_rest ) noexcept
+		{
+			return
+				((std::uint64_t(v1)-std::uint64_t(min))/64==word ? std::uint64_t(1)<<((std::uint64_t(v1)-std::uint64_t(min))%64) : 0) |
+				enumerator_bitset_word(min, word, v_rest...);
+		}
+
+		template <class Enumerator, Enumerator... V>
+		struct enumerator_range
+		{
+			constexpr static std::intmax_t min = min_enumerator(std::intmax_t(V)...);
+			constexpr static std::uint64_t size = std::uint64_t(max_enumerator(std::intmax_t(V)...)) - std::uint64_t(min) + 1;
+		};
+
+		template <bool Integral, class Enumerator, Enumerator... V>
+		struct use_enumerator_bitset_impl: std::false_type
+		{
+		};
+
+		template <class Enumerator, Enumerator... V>
+		struct use_enumerator_bitset_impl<true, Enumerator, V...>: std::integral_constant<bool,
+			enumerator_range<Enumerator, V...>::size!=0 &&
+			(enumerator_range<Enumerator, V...>::size-1)/64 < sizeof...(V)>
+		{
+		};
+
+		template <class MatchType, class Enumerator, Enumerator... V>
+		struct use_enumerator_bitset: use_enumerator_bitset_impl<
+			LEAF_MATCH_LOOKUP_TABLE_MIN!=0 && sizeof...(V)>=LEAF_MATCH_LOOKUP_TABLE_MIN &&
+			std::is_same<MatchType, Enumerator>::value &&
+			(std::is_integral<Enumerator>::value || std::is_enum<Enumerator>::value),
+			Enumerator, V...>
+		{
+		};
+
+		template <class Words, class Enumerator, Enumerator... V>
+		struct enumerator_bitset;
+
+		template <std::size_t... W, class Enumerator, Enumerator... V>
+		struct enumerator_bitset<leaf_detail_mp11::index_sequence<W...>, Enumerator, V...>
+		{
+			using range = enumerator_range<Enumerator, V...>;
+
+			constexpr static std::uint64_t words[ ] = { enumerator_bitset_word(range::min, W, std::intmax_t(V)...)... };
+
+			LEAF_CONSTEXPR static bool check( Enumerator x ) noexcept
+			{
+				std::uint64_t i = std::uint64_t(std::intmax_t(x)) - std::uint64_t(range::min);
+				return i<range::size && ((words[i/64] >> (i%64)) & 1);
+			}
+		};
+
+		template <std::size_t... W, class Enumerator, Enumerator... V>
+		constexpr std::uint64_t enumerator_bitset<leaf_detail_mp11::index_sequence<W...>, Enumerator, V...>::words[ ];
+
+		template <class MatchType, class Enumerator, Enumerator... V>
+		struct check_value_pack_
+		{
+			LEAF_CONSTEXPR static bool check( MatchType const & x, std::false_type ) noexcept
+			{
+				return check_value_pack(x, V...);
+			}
+
+			LEAF_CONSTEXPR static bool check( MatchType const & x, std::true_type ) noexcept
+			{
+				using range = enumerator_range<Enumerator, V...>;
+				return enumerator_bitset<leaf_detail_mp11::make_index_sequence<(range::size-1)/64+1>, Enumerator, V...>::check(x);
+			}
+
+			LEAF_CONSTEXPR static bool check( MatchType const & x ) noexcept
+			{
+				return check(x, use_enumerator_bitset<MatchType, Enumerator, V...>());
+			}
+		};
 	}
 
 	template <class E, typename leaf_detail::match_traits<E>::enumerator... V>
@@ -2827,7 +4989,7 @@ namespace boost { namespace leaf {
 
 		LEAF_CONSTEXPR bool operator()() const noexcept
 		{
-			return value_ && leaf_detail::check_value_pack(*value_,V...);
+			return value_ && leaf_detail::check_value_pack_<type, typename leaf_detail::match_traits<E>::enumerator, V...>::check(*value_);
 		}
 
 		LEAF_CONSTEXPR type const & value() const noexcept
@@ -2852,15 +5014,23 @@ namespace boost { namespace leaf {
 		template <class SlotsTuple,class T>
 		struct check_one_argument
 		{
+			constexpr static presence_mask required_mask = slot_mask<T,SlotsTuple>::value;
+
 			LEAF_CONSTEXPR static bool check( SlotsTuple const & tup, error_info const & ei ) noexcept
 			{
+#ifdef LEAF_HANDLER_PRESENCE_MASK
+				return required_mask!=0 || peek<T>(tup, ei.error())!=0;
+#else
 				return peek<T>(tup, ei.error())!=0;
+#endif
 			}
 		};
 
 		template <class SlotsTuple,class T>
 		struct check_one_argument<SlotsTuple,T *>
 		{
+			constexpr static presence_mask required_mask = 0;
+
 			constexpr static bool check( SlotsTuple const &, error_info const & ) noexcept
 			{
 				return true;
@@ -2870,6 +5040,8 @@ namespace boost { namespace leaf {
 		template <class SlotsTuple>
 		struct check_one_argument<SlotsTuple,error_info>
 		{
+			constexpr static presence_mask required_mask = 0;
+
 			constexpr static bool check( SlotsTuple const &, error_info const & )
 			{
 				return true;
@@ -2879,6 +5051,8 @@ namespace boost { namespace leaf {
 		template <class SlotsTuple>
 		struct check_one_argument<SlotsTuple,diagnostic_info>
 		{
+			constexpr static presence_mask required_mask = 0;
+
 			constexpr static bool check( SlotsTuple const &, error_info const & ) noexcept
 			{
 				return true;
@@ -2888,6 +5062,8 @@ namespace boost { namespace leaf {
 		template <class SlotsTuple>
 		struct check_one_argument<SlotsTuple,verbose_diagnostic_info>
 		{
+			constexpr static presence_mask required_mask = 0;
+
 			constexpr static bool check( SlotsTuple const &, error_info const & ) noexcept
 			{
 				return true;
@@ -2897,6 +5073,8 @@ namespace boost { namespace leaf {
 		template <class SlotsTuple>
 		struct check_one_argument<SlotsTuple,std::error_code>
 		{
+			constexpr static presence_mask required_mask = 0;
+
 			constexpr static bool check( SlotsTuple const &, error_info const & ) noexcept
 			{
 				return true;
@@ -2906,6 +5084,8 @@ namespace boost { namespace leaf {
 		template <class SlotsTuple, class T, typename match_traits<T>::enumerator... V>
 		struct check_one_argument<SlotsTuple,match<T,V...>>
 		{
+			constexpr static presence_mask required_mask = slot_mask<typename match_traits<T>::e_type,SlotsTuple>::value;
+
 			LEAF_CONSTEXPR static bool check( SlotsTuple const & tup, error_info const & ei ) noexcept
 			{
 				return match<T,V...>(match_traits<T>::read(tup,ei))();
@@ -2918,6 +5098,8 @@ namespace boost { namespace leaf {
 		template <class SlotsTuple, class Car, class... Cdr>
 		struct check_arguments<SlotsTuple, Car, Cdr...>
 		{
+			constexpr static presence_mask required_mask = check_one_argument<SlotsTuple,Car>::required_mask | check_arguments<SlotsTuple,Cdr...>::required_mask;
+
 			LEAF_CONSTEXPR static bool check( SlotsTuple const & tup, error_info const & ei ) noexcept
 			{
 				return check_one_argument<SlotsTuple,Car>::check(tup,ei) && check_arguments<SlotsTuple,Cdr...>::check(tup,ei);
@@ -2927,6 +5109,8 @@ namespace boost { namespace leaf {
 		template <class SlotsTuple>
 		struct check_arguments<SlotsTuple>
 		{
+			constexpr static presence_mask required_mask = 0;
+
 			constexpr static bool check( SlotsTuple const &, error_info const & ) noexcept
 			{
 				return true;
@@ -2998,7 +5182,7 @@ namespace boost { namespace leaf {
 		struct get_one_argument<diagnostic_info>
 		{
 			template <class SlotsTuple>
-			LEAF_CONSTEXPR static diagnostic_info get( SlotsTuple const & tup, error_info const & ei ) noexcept
+			LEAF_CONSTEXPR static diagnostic_info get( SlotsTuple const &, error_info const & ei ) noexcept
 			{
 				return diagnostic_info(ei);
 			}
@@ -3008,7 +5192,7 @@ namespace boost { namespace leaf {
 		struct get_one_argument<verbose_diagnostic_info>
 		{
 			template <class SlotsTuple>
-			LEAF_CONSTEXPR static verbose_diagnostic_info get( SlotsTuple const & tup, error_info const & ei ) noexcept
+			LEAF_CONSTEXPR static verbose_diagnostic_info get( SlotsTuple const &, error_info const & ei ) noexcept
 			{
 				return verbose_diagnostic_info(ei);
 			}
@@ -3073,12 +5257,28 @@ namespace boost { namespace leaf {
 
 	namespace leaf_detail
 	{
+#ifdef LEAF_HANDLER_PRESENCE_MASK
+
+		// The E-objects required by the handler are checked all at once against
+		// the presence mask; only the arguments which need more than that (e.g.
+		// match<>) are checked individually.
+		template <class Tup, class... T>
+		LEAF_CONSTEXPR inline bool check_handler_( Tup const & e_objects, error_info const & ei, presence_mask pm, leaf_detail_mp11::mp_list<T...> ) noexcept
+		{
+			using check = check_arguments<Tup,typename std::remove_cv<typename std::remove_reference<T>::type>::type...>;
+			return (pm & check::required_mask)==check::required_mask && check::check(e_objects, ei);
+		}
+
+#else
+
 		template <class Tup, class... T>
-		LEAF_CONSTEXPR inline bool check_handler_( Tup const & e_objects, error_info const & ei, leaf_detail_mp11::mp_list<T...> ) noexcept
+		LEAF_CONSTEXPR inline bool check_handler_( Tup const & e_objects, error_info const & ei, presence_mask, leaf_detail_mp11::mp_list<T...> ) noexcept
 		{
 			return check_arguments<Tup,typename std::remove_cv<typename std::remove_reference<T>::type>::type...>::check(e_objects, ei);
 		}
 
+#endif
+
 		template <class R, class F, bool IsResult = is_result_type<R>::value, class FReturnType = fn_return_type<F>>
 		struct handler_caller
 		{
@@ -3103,19 +5303,29 @@ namespace boost { namespace leaf {
 		};
 
 		template <class R, class Tup, class F>
-		LEAF_CONSTEXPR inline R handle_error_( Tup const & e_objects, error_info const & ei, F && f )
+		LEAF_CONSTEXPR inline R select_handler_( Tup const & e_objects, error_info const & ei, presence_mask, F && f )
 		{
 			static_assert( handler_matches_any_error<fn_mp_args<F>>::value, "The last handler passed to handle_all must match any error." );
 			return handler_caller<R, F>::call( e_objects, ei, std::forward<F>(f), fn_mp_args<F>{ } );
 		}
 
 		template <class R, class Tup, class CarF, class... CdrF>
-		LEAF_CONSTEXPR inline R handle_error_( Tup const & e_objects, error_info const & ei, CarF && car_f, CdrF && ... cdr_f )
+		LEAF_CONSTEXPR inline R select_handler_( Tup const & e_objects, error_info const & ei, presence_mask pm, CarF && car_f, CdrF && ... cdr_f )
 		{
-			if( handler_matches_any_error<fn_mp_args<CarF>>::value || check_handler_( e_objects, ei, fn_mp_args<CarF>{ } ) )
+			if( handler_matches_any_error<fn_mp_args<CarF>>::value || check_handler_( e_objects, ei, pm, fn_mp_args<CarF>{ } ) )
 				return handler_caller<R, CarF>::call( e_objects, ei, std::forward<CarF>(car_f), fn_mp_args<CarF>{ } );
 			else
-				return handle_error_<R>( e_objects, ei, std::forward<CdrF>(cdr_f)...);
+				return select_handler_<R>( e_objects, ei, pm, std::forward<CdrF>(cdr_f)...);
+		}
+
+		template <class R, class Tup, class... H>
+		LEAF_CONSTEXPR inline R handle_error_( Tup const & e_objects, error_info const & ei, H && ... h )
+		{
+#ifdef LEAF_HANDLER_PRESENCE_MASK
+			return select_handler_<R>( e_objects, ei, get_presence_mask(e_objects, ei.error()), std::forward<H>(h)...);
+#else
+			return select_handler_<R>( e_objects, ei, presence_mask(0), std::forward<H>(h)...);
+#endif
 		}
 	}
 
@@ -3569,30 +5779,10 @@ namespace boost { namespace leaf {
 #endif
 
 #endif
-// <<< #include <boost/leaf/detail/demangle.hpp>
-#line 17 "boost/leaf/handle_exception.hpp"
-
-namespace boost { namespace leaf {
-
-	namespace leaf_detail
-	{
-		template <class Ex>
-		LEAF_CONSTEXPR inline bool check_exception_pack( std::exception const * ex, Ex const * ) noexcept
-		{
-			return dynamic_cast<Ex const *>(ex)!=0;
-		}
-
-		template <class Ex, class... ExRest>
-		LEAF_CONSTEXPR inline bool check_exception_pack( std::exception const * ex, Ex const *, ExRest const * ... ex_rest ) noexcept
-		{
-			return dynamic_cast<Ex const *>(ex)!=0 || check_exception_pack(ex, ex_rest...);
-		}
+// <<< #include <boost/leaf/detail/demangle.hpp>
+#line 17 "boost/leaf/handle_exception.hpp"
 
-		LEAF_CONSTEXPR inline bool check_exception_pack( std::exception const * )
-		{
-			return true;
-		}
-	}
+namespace boost { namespace leaf {
 
 	template <class... Ex>
 	class catch_
@@ -3608,7 +5798,7 @@ namespace boost { namespace leaf {
 
 		LEAF_CONSTEXPR bool operator()() const noexcept
 		{
-			return value_ && leaf_detail::check_exception_pack(value_,static_cast<Ex const *>(0)...);
+			return value_ && (sizeof...(Ex)==0 || leaf_detail::get_exception_type_mask<Ex...>(*value_)!=0);
 		}
 
 		LEAF_CONSTEXPR std::exception const & value() const noexcept
@@ -3626,7 +5816,7 @@ namespace boost { namespace leaf {
 	public:
 
 		LEAF_CONSTEXPR explicit catch_( std::exception const * value ) noexcept:
-			value_(dynamic_cast<Ex const *>(value))
+			value_(value && leaf_detail::get_exception_type_mask<Ex>(*value) ? dynamic_cast<Ex const *>(value) : 0)
 		{
 		}
 
@@ -3652,6 +5842,8 @@ namespace boost { namespace leaf {
 		template <class SlotsTuple, class... Ex>
 		struct check_one_argument<SlotsTuple,catch_<Ex...>>
 		{
+			constexpr static presence_mask required_mask = 0;
+
 			LEAF_CONSTEXPR static bool check( SlotsTuple const &, error_info const & ei ) noexcept
 			{
 				if( ei.exception_caught() )
@@ -4010,6 +6202,8 @@ namespace boost { namespace leaf {
 // file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
 
 
+#define LEAF_ERROR_TRACE auto leaf_error_trace_ = ::boost::leaf::accumulate(::boost::leaf::leaf_detail::error_trace_frame{__FILE__,__LINE__,__FUNCTION__})
+
 namespace boost { namespace leaf {
 
 	namespace leaf_detail
@@ -4017,7 +6211,7 @@ namespace boost { namespace leaf {
 		template <int I, class Tuple>
 		struct tuple_for_each_preload
 		{
-			LEAF_CONSTEXPR static void trigger( Tuple & tup, int err_id ) noexcept
+			LEAF_CONSTEXPR static void trigger( Tuple & tup, id_type err_id ) noexcept
 			{
 				assert((err_id&3)==1);
 				tuple_for_each_preload<I-1,Tuple>::trigger(tup,err_id);
@@ -4028,7 +6222,7 @@ namespace boost { namespace leaf {
 		template <class Tuple>
 		struct tuple_for_each_preload<0, Tuple>
 		{
-			LEAF_CONSTEXPR static void trigger( Tuple const &, int ) noexcept { }
+			LEAF_CONSTEXPR static void trigger( Tuple const &, id_type ) noexcept { }
 		};
 	} // leaf_detail
 
@@ -4044,29 +6238,32 @@ namespace boost { namespace leaf {
 
 		public:
 
-			LEAF_CONSTEXPR explicit preloaded_item( E && e ) noexcept:
-				s_(tl_slot_ptr<E>()),
+			LEAF_CONSTEXPR explicit preloaded_item( E && e, tl_slot_table table = get_tl_slot_table() ) noexcept:
+				s_(tl_slot_ptr<E>(table)),
 				e_(std::forward<E>(e))
 			{
 			}
 
-			LEAF_CONSTEXPR void trigger( int err_id ) noexcept
+			LEAF_CONSTEXPR void trigger( id_type err_id ) noexcept
 			{
 				assert((err_id&3)==1);
 				if( s_ )
 				{
-					if( !s_->has_value(err_id) )
-						s_->put(err_id, std::move(e_));
+					if( !s_->has_value(err_id) && s_->put(err_id, std::move(e_)) )
+						count_load_kept<E>();
+					else
+						count_load_discarded<E>();
 				}
-#if LEAF_DIAGNOSTICS
 				else
 				{
+					count_load_missed<E>();
+#if LEAF_DIAGNOSTICS
 					int c = tl_unexpected_enabled_counter();
 					assert(c>=0);
 					if( c )
 						load_unexpected(err_id, std::forward<E>(e_));
-				}
 #endif
+				}
 			}
 		};
 
@@ -4077,7 +6274,7 @@ namespace boost { namespace leaf {
 
 			std::tuple<preloaded_item<E>...> p_;
 			bool moved_;
-			int err_id_;
+			id_type err_id_;
 
 		public:
 
@@ -4100,8 +6297,8 @@ namespace boost { namespace leaf {
 			{
 				if( moved_ )
 					return;
-				int const err_id = last_id();
-				if( err_id==err_id_ )
+				id_type const err_id = last_id();
+				if( err_id==err_id_ || !err_id )
 				{
 #ifndef LEAF_NO_EXCEPTIONS
 					if( LEAF_UNCAUGHT_EXCEPTIONS() )
@@ -4133,29 +6330,32 @@ namespace boost { namespace leaf {
 
 		public:
 
-			LEAF_CONSTEXPR explicit deferred_item( F && f ) noexcept:
-				s_(tl_slot_ptr<E>()),
+			LEAF_CONSTEXPR explicit deferred_item( F && f, tl_slot_table table = get_tl_slot_table() ) noexcept:
+				s_(tl_slot_ptr<E>(table)),
 				f_(std::forward<F>(f))
 			{
 			}
 
-			LEAF_CONSTEXPR void trigger( int err_id ) noexcept
+			LEAF_CONSTEXPR void trigger( id_type err_id ) noexcept
 			{
 				assert((err_id&3)==1);
 				if( s_ )
 				{
-					if( !s_->has_value(err_id) )
-						s_->put(err_id, f_());
+					if( !s_->has_value(err_id) && s_->put(err_id, f_()) )
+						count_load_kept<E>();
+					else
+						count_load_discarded<E>();
 				}
-#if LEAF_DIAGNOSTICS
 				else
 				{
+					count_load_missed<E>();
+#if LEAF_DIAGNOSTICS
 					int c = tl_unexpected_enabled_counter();
 					assert(c>=0);
 					if( c )
 						load_unexpected(err_id, std::forward<E>(f_()));
-				}
 #endif
+				}
 			}
 		};
 
@@ -4165,7 +6365,7 @@ namespace boost { namespace leaf {
 			deferred & operator=( deferred const & ) = delete;
 			std::tuple<deferred_item<F>...> d_;
 			bool moved_;
-			int err_id_;
+			id_type err_id_;
 
 		public:
 
@@ -4188,8 +6388,8 @@ namespace boost { namespace leaf {
 			{
 				if( moved_ )
 					return;
-				int const err_id = last_id();
-				if( err_id==err_id_ )
+				id_type const err_id = last_id();
+				if( err_id==err_id_ || !err_id )
 				{
 #ifndef LEAF_NO_EXCEPTIONS
 					if( LEAF_UNCAUGHT_EXCEPTIONS() )
@@ -4208,6 +6408,40 @@ namespace boost { namespace leaf {
 		return leaf_detail::deferred<F...>(std::forward<F>(f)...);
 	}
 
+	namespace leaf_detail
+	{
+		// A nullary function object which constructs an E-object from a
+		// reference to a value which outlives it; used by preload_ref to
+		// defer copying the value until an error is actually reported.
+		template <class E, class A>
+		class e_from_ref
+		{
+			A const * a_;
+
+		public:
+
+			LEAF_CONSTEXPR explicit e_from_ref( A const & a ) noexcept:
+				a_(&a)
+			{
+			}
+
+			LEAF_CONSTEXPR E operator()() const
+			{
+				return E{*a_};
+			}
+		};
+	} // leaf_detail
+
+	template <class E, class A>
+	LEAF_CONSTEXPR inline leaf_detail::deferred<leaf_detail::e_from_ref<E, A>> preload_ref( A const & a ) noexcept
+	{
+		static_assert(is_e_type<E>::value, "preload_ref requires an E-type");
+		return leaf_detail::deferred<leaf_detail::e_from_ref<E, A>>(leaf_detail::e_from_ref<E, A>(a));
+	}
+
+	template <class E, class A>
+	void preload_ref( A const && ) = delete;
+
 	////////////////////////////////////////
 
 	namespace leaf_detail
@@ -4224,20 +6458,29 @@ namespace boost { namespace leaf {
 
 		public:
 
-			LEAF_CONSTEXPR explicit accumulating_item( F && f ) noexcept:
-				s_(tl_slot_ptr<E>()),
+			LEAF_CONSTEXPR explicit accumulating_item( F && f, tl_slot_table table = get_tl_slot_table() ) noexcept:
+				s_(tl_slot_ptr<E>(table)),
 				f_(std::forward<F>(f))
 			{
 			}
 
-			LEAF_CONSTEXPR void trigger( int err_id ) noexcept
+			LEAF_CONSTEXPR void trigger( id_type err_id ) noexcept
 			{
 				assert((err_id&3)==1);
+				E * e = 0;
 				if( s_ )
-					if( E * e = s_->has_value(err_id) )
-						(void) f_(*e);
-					else
-						(void) f_(s_->put(err_id, E()));
+				{
+					e = s_->has_value(err_id);
+					if( !e )
+						e = s_->put(err_id, E());
+				}
+				if( e )
+				{
+					count_load_kept<E>();
+					(void) f_(*e);
+				}
+				else
+					count_load_discarded<E>();
 			}
 		};
 
@@ -4247,7 +6490,7 @@ namespace boost { namespace leaf {
 			accumulating & operator=( accumulating const & ) = delete;
 			std::tuple<accumulating_item<F>...> a_;
 			bool moved_;
-			int err_id_;
+			id_type err_id_;
 
 		public:
 
@@ -4270,8 +6513,8 @@ namespace boost { namespace leaf {
 			{
 				if( moved_ )
 					return;
-				int const err_id = last_id();
-				if( err_id==err_id_ )
+				id_type const err_id = last_id();
+				if( err_id==err_id_ || !err_id )
 				{
 #ifndef LEAF_NO_EXCEPTIONS
 					if( LEAF_UNCAUGHT_EXCEPTIONS() )
@@ -4290,6 +6533,107 @@ namespace boost { namespace leaf {
 		return leaf_detail::accumulating<F...>(std::forward<F>(f)...);
 	}
 
+	////////////////////////////////////////
+
+	namespace leaf_detail
+	{
+		// Selects the item type for each argument passed to on_error: a nullary
+		// function returning an E-type is deferred, a function taking a single
+		// E-object by reference is accumulating, anything else is preloaded.
+		template <class T, int Kind =
+			is_deferred_e<T>::value ? 1 :
+			function_traits<T>::arity==1 && !is_e_type<T>::value ? 2 :
+			0>
+		struct on_error_item_impl
+		{
+			using type = preloaded_item<T>;
+		};
+
+		template <class F>
+		struct on_error_item_impl<F, 1>
+		{
+			using type = deferred_item<F>;
+		};
+
+		template <class F>
+		struct on_error_item_impl<F, 2>
+		{
+			using type = accumulating_item<F>;
+		};
+
+		template <class T>
+		using on_error_item = typename on_error_item_impl<typename std::decay<T>::type>::type;
+
+		// Unlike using separate preload / defer / accumulate objects, the items
+		// share one error ID snapshot and one check in the destructor, and the
+		// slot pointers are all looked up through a single tl_slot_table.
+		template <class... Item>
+		class on_error_guard
+		{
+			on_error_guard & operator=( on_error_guard const & ) = delete;
+			std::tuple<Item...> i_;
+			bool moved_;
+			id_type err_id_;
+
+		public:
+
+			template <class... T>
+			LEAF_CONSTEXPR explicit on_error_guard( tl_slot_table table, T && ... x ) noexcept:
+				i_(Item(typename std::decay<T>::type(std::forward<T>(x)), table)...),
+				moved_(false),
+				err_id_(last_id())
+			{
+			}
+
+			LEAF_CONSTEXPR on_error_guard( on_error_guard && x ) noexcept:
+				i_(std::move(x.i_)),
+				moved_(false),
+				err_id_(x.err_id_)
+			{
+				x.moved_ = true;
+			}
+
+			~on_error_guard() noexcept
+			{
+				if( moved_ )
+					return;
+				id_type const err_id = last_id();
+				if( err_id==err_id_ || !err_id )
+				{
+#ifndef LEAF_NO_EXCEPTIONS
+					if( LEAF_UNCAUGHT_EXCEPTIONS() )
+						leaf_detail::tuple_for_each_preload<sizeof...(Item),decltype(i_)>::trigger(i_,next_id());
+#endif
+				}
+				else
+					leaf_detail::tuple_for_each_preload<sizeof...(Item),decltype(i_)>::trigger(i_,err_id);
+			}
+		};
+	} // leaf_detail
+
+	template <class... T>
+	LEAF_CONSTEXPR inline leaf_detail::on_error_guard<leaf_detail::on_error_item<T>...> on_error( T && ... x ) noexcept
+	{
+		return leaf_detail::on_error_guard<leaf_detail::on_error_item<T>...>(leaf_detail::get_tl_slot_table(), std::forward<T>(x)...);
+	}
+
+	////////////////////////////////////////
+
+	namespace leaf_detail
+	{
+		struct error_trace_frame
+		{
+			char const * file;
+			int line;
+			char const * function;
+
+			void operator()( e_error_trace & tr ) const
+			{
+				tr.push(file, line, function);
+			}
+		};
+	} // leaf_detail
+
 } }
 
 #endif
@@ -4334,7 +6678,7 @@ namespace boost { namespace leaf {
 	{
 		class result_discriminant
 		{
-			unsigned state_;
+			leaf_detail::unsigned_id_type state_;
 
 		public:
 
@@ -4379,12 +6723,249 @@ namespace boost { namespace leaf {
 
 	////////////////////////////////////////
 
-	template <class T>
-	class result
+	namespace leaf_detail
 	{
-		template <class U>
+		// A captured context is held through a pointer to a context_ptr stored
+		// in a memory block from the per-thread heap_block_cache, which keeps
+		// the union in result<T> at 8 bytes instead of sizeof(std::shared_ptr).
+		// Each result owns its block, so it can be moved to (and destroyed by)
+		// another thread. Returns 0 (leaving ctx unchanged) if out of memory.
+		inline context_ptr * hold_context( context_ptr & ctx ) noexcept
+		{
+			assert(ctx);
+			if( void * p = heap_block_cache<sizeof(context_ptr)>::allocate() )
+				return new (p) context_ptr(std::move(ctx));
+			return 0;
+		}
+
+		inline void drop_context( context_ptr * p ) noexcept
+		{
+			if( p )
+			{
+				p->~context_ptr();
+				heap_block_cache<sizeof(context_ptr)>::deallocate(p);
+			}
+		}
+
+		template <class T, bool CanCapture, bool Trivial = !CanCapture && std::is_trivially_copyable<T>::value>
+		class result_storage
+		{
+			template <class, bool, bool>
+			friend class result_storage;
+
+		protected:
+
+			union
+			{
+				T value_;
+				context_ptr * ctx_;
+			};
+
+			result_discriminant what_;
+
+			LEAF_CONSTEXPR void destroy() const noexcept
+			{
+				switch(this->what_.kind())
+				{
+				case result_discriminant::val:
+					value_.~T();
+					break;
+				case result_discriminant::ctx_ptr:
+					assert(!ctx_ || (*ctx_)->captured_id_);
+					drop_context(ctx_);
+				default:
+					break;
+				}
+			}
+
+			LEAF_CONSTEXPR context_ptr * release_context() noexcept
+			{
+				assert(what_.kind()==result_discriminant::ctx_ptr);
+				context_ptr * ctx = ctx_;
+				ctx_ = 0;
+				return ctx;
+			}
+
+			LEAF_CONSTEXPR error_id captured_id() const noexcept
+			{
+				assert(what_.kind()==result_discriminant::ctx_ptr);
+				return (*ctx_)->captured_id_;
+			}
+
+			LEAF_CONSTEXPR error_id propagate_captured_errors() noexcept
+			{
+				assert(what_.kind()==result_discriminant::ctx_ptr);
+				return (*ctx_)->propagate_captured_errors();
+			}
+
+			template <class U, bool C, bool B>
+			LEAF_CONSTEXPR result_discriminant move_from( result_storage<U, C, B> && x ) noexcept
+			{
+				auto x_what = x.what_;
+				switch(x_what.kind())
+				{
+				case result_discriminant::val:
+					(void) new(&value_) T(std::move(x.value_));
+					break;
+				case result_discriminant::ctx_ptr:
+					ctx_ = x.release_context();
+				default:
+					break;
+				}
+				return x_what;
+			}
+
+			LEAF_CONSTEXPR result_storage( result_storage && x ) noexcept:
+				what_(move_from(std::move(x)))
+			{
+			}
+
+			template <class U, bool C, bool B>
+			LEAF_CONSTEXPR explicit result_storage( result_storage<U, C, B> && x ) noexcept:
+				what_(move_from(std::move(x)))
+			{
+			}
+
+			LEAF_CONSTEXPR explicit result_storage( result_discriminant what ) noexcept:
+				ctx_(0),
+				what_(what)
+			{
+			}
+
+			template <class... A>
+			LEAF_CONSTEXPR explicit result_storage( result_discriminant::kind_val k, A && ... a ):
+				value_(std::forward<A>(a)...),
+				what_(k)
+			{
+			}
+
+			LEAF_CONSTEXPR explicit result_storage( context_ptr * ctx ) noexcept:
+				ctx_(ctx),
+				what_(result_discriminant::kind_ctx_ptr{})
+			{
+			}
+
+			// If the context_ptr can't be stored, the result holds the captured
+			// error ID instead, without the E-objects stored in the context.
+			LEAF_CONSTEXPR explicit result_storage( context_ptr && ctx ) noexcept:
+				ctx_(hold_context(ctx)),
+				what_(ctx_ ? result_discriminant(result_discriminant::kind_ctx_ptr{}) : result_discriminant(ctx->captured_id_))
+			{
+			}
+
+			LEAF_CONSTEXPR result_storage & operator=( result_storage && x ) noexcept
+			{
+				destroy();
+				what_ = move_from(std::move(x));
+				return *this;
+			}
+
+			~result_storage() noexcept
+			{
+				destroy();
+			}
+		};
+
+		// When T is trivially copyable and the result can not hold a captured
+		// context, all special member functions are trivial, so the result
+		// can be passed in registers and relocated with memcpy.
+		template <class T>
+		class result_storage<T, false, true>
+		{
+			template <class, bool, bool>
+			friend class result_storage;
+
+		protected:
+
+			// raw_ gives the error states a defined object representation, so
+			// that copying a result which holds no value is not a read of an
+			// uninitialized T.
+			union
+			{
+				T value_;
+				unsigned char raw_[sizeof(T)];
+			};
+
+			result_discriminant what_;
+
+			LEAF_CONSTEXPR void destroy() const noexcept
+			{
+			}
+
+			// A result which can't hold a captured context is never in the
+			// ctx_ptr state.
+			LEAF_CONSTEXPR context_ptr * release_context() noexcept
+			{
+				assert(what_.kind()!=result_discriminant::ctx_ptr);
+				return 0;
+			}
+
+			LEAF_CONSTEXPR error_id captured_id() const noexcept
+			{
+				assert(what_.kind()!=result_discriminant::ctx_ptr);
+				return error_id();
+			}
+
+			LEAF_CONSTEXPR error_id propagate_captured_errors() noexcept
+			{
+				assert(what_.kind()!=result_discriminant::ctx_ptr);
+				return error_id();
+			}
+
+			template <class U, bool C, bool B>
+			LEAF_CONSTEXPR result_discriminant move_from( result_storage<U, C, B> && x ) noexcept
+			{
+				assert(x.what_.kind()!=result_discriminant::ctx_ptr);
+				if( x.what_.kind()==result_discriminant::val )
+					(void) new(&value_) T(std::move(x.value_));
+				return x.what_;
+			}
+
+			template <class U, bool C, bool B>
+			LEAF_CONSTEXPR explicit result_storage( result_storage<U, C, B> && x ) noexcept:
+				what_(move_from(std::move(x)))
+			{
+			}
+
+			LEAF_CONSTEXPR explicit result_storage( result_discriminant what ) noexcept:
+				raw_(),
+				what_(what)
+			{
+			}
+
+			template <class... A>
+			LEAF_CONSTEXPR explicit result_storage( result_discriminant::kind_val k, A && ... a ):
+				value_(std::forward<A>(a)...),
+				what_(k)
+			{
+			}
+		};
+	}
+
+	////////////////////////////////////////
+
+	template <class T, class CtxPtr>
+	class result:
+		leaf_detail::result_storage<T, !std::is_void<CtxPtr>::value>
+	{
+		static_assert(std::is_void<CtxPtr>::value || std::is_same<CtxPtr, context_ptr>::value, "The second template parameter of result must be context_ptr or void");
+
+		template <class, class>
 		friend class result;
 
+		typedef leaf_detail::result_storage<T, !std::is_void<CtxPtr>::value> storage;
+
+		using storage::value_;
+		using storage::what_;
+		using storage::destroy;
+		using storage::move_from;
+
+		// Whether a result<T, CtxPtr> may be initialized from a result<U, C>:
+		// a result which can't hold a captured context can't be initialized
+		// from one that can.
+		template <class C>
+		using enable_from = typename std::enable_if<!std::is_void<CtxPtr>::value || std::is_void<C>::value>::type;
+
 		struct error_result
 		{
 			error_result( error_result && ) = default;
@@ -4398,18 +6979,18 @@ namespace boost { namespace leaf {
 
 			result & r_;
 
-			template <class U>
-			LEAF_CONSTEXPR operator result<U>() noexcept
+			template <class U, class C>
+			LEAF_CONSTEXPR operator result<U, C>() noexcept
 			{
 				using leaf_detail::result_discriminant;
 				switch(r_.what_.kind())
 				{
 				case result_discriminant::val:
-					return result<U>(error_id());
+					return result<U, C>(error_id());
 				case result_discriminant::ctx_ptr:
-					return result<U>(std::move(r_.ctx_));
+					return r_.template move_context<U>(std::is_void<C>());
 				default:
-					return result<U>(std::move(r_.what_));
+					return result<U, C>(std::move(r_.what_));
 				}
 			}
 
@@ -4421,58 +7002,40 @@ namespace boost { namespace leaf {
 				case result_discriminant::val:
 					return error_id();
 				case result_discriminant::ctx_ptr:
-					return r_.ctx_->propagate_captured_errors();
+					return r_.propagate_captured_errors();
 				default:
 					return r_.what_.get_error_id();
 				}
 			}
 		};
 
-		union
+		template <class U>
+		LEAF_CONSTEXPR result<U, context_ptr> move_context( std::false_type ) noexcept
 		{
-			T value_;
-			context_ptr ctx_;
-		};
+			return result<U, context_ptr>(storage::release_context());
+		}
 
-		leaf_detail::result_discriminant what_;
+		// The captured context can't be transported further: its E-objects
+		// are loaded into the active contexts instead.
+		template <class U>
+		LEAF_CONSTEXPR result<U, void> move_context( std::true_type ) noexcept
+		{
+			return result<U, void>(storage::propagate_captured_errors());
+		}
 
-		LEAF_CONSTEXPR void destroy() const noexcept
+		LEAF_CONSTEXPR explicit result( context_ptr * ctx ) noexcept:
+			storage(ctx)
 		{
-			using leaf_detail::result_discriminant;
-			switch(this->what_.kind())
-			{
-			case result_discriminant::val:
-				value_.~T();
-				break;
-			case result_discriminant::ctx_ptr:
-				assert(!ctx_ || ctx_->captured_id_);
-				ctx_.~context_ptr();
-			default:
-				break;
-			}
 		}
 
-		template <class U>
-		LEAF_CONSTEXPR leaf_detail::result_discriminant move_from( result<U> && x ) noexcept
+		template <class U, class C>
+		LEAF_CONSTEXPR static typename result<U, C>::storage && storage_of( result<U, C> && x ) noexcept
 		{
-			using leaf_detail::result_discriminant;
-			auto x_what = x.what_;
-			switch(x_what.kind())
-			{
-			case result_discriminant::val:
-				(void) new(&value_) T(std::move(x.value_));
-				break;
-			case result_discriminant::ctx_ptr:
-				assert(!x.ctx_ || x.ctx_->captured_id_);
-				(void) new(&ctx_) context_ptr(std::move(x.ctx_));
-			default:
-				break;
-			}
-			return x_what;
+			return std::move(x);
 		}
 
 		LEAF_CONSTEXPR result( leaf_detail::result_discriminant && what ) noexcept:
-			what_(std::move(what))
+			storage(std::move(what))
 		{
 			using leaf_detail::result_discriminant;
 			assert(what_.kind()==result_discriminant::err_id || what_.kind()==result_discriminant::no_error);
@@ -4482,69 +7045,52 @@ namespace boost { namespace leaf {
 
 		typedef T value_type;
 
-		~result() noexcept
-		{
-			destroy();
-		}
-
-		LEAF_CONSTEXPR result( result && x ) noexcept:
-			what_(move_from(std::move(x)))
-		{
-		}
-
-		template <class U>
-		LEAF_CONSTEXPR result( result<U> && x ) noexcept:
-			what_(move_from(std::move(x)))
+		result( result && ) = default;
 
+		template <class U, class C, class = enable_from<C>>
+		LEAF_CONSTEXPR result( result<U, C> && x ) noexcept:
+			storage(storage_of(std::move(x)))
 		{
 		}
 
 		LEAF_CONSTEXPR result():
-			value_(T()),
-			what_(leaf_detail::result_discriminant::kind_val{})
+			storage(leaf_detail::result_discriminant::kind_val{}, T())
 		{
 		}
 
 		LEAF_CONSTEXPR result( T && v ) noexcept:
-			value_(std::move(v)),
-			what_(leaf_detail::result_discriminant::kind_val{})
+			storage(leaf_detail::result_discriminant::kind_val{}, std::move(v))
 		{
 		}
 
 		LEAF_CONSTEXPR result( T const & v ):
-			value_(v),
-			what_(leaf_detail::result_discriminant::kind_val{})
+			storage(leaf_detail::result_discriminant::kind_val{}, v)
 		{
 		}
 
 		LEAF_CONSTEXPR result( error_id err ) noexcept:
-			what_(err)
+			storage(leaf_detail::result_discriminant(err))
 		{
 		}
 
 		LEAF_CONSTEXPR result( std::error_code const & ec ) noexcept:
-			what_(error_id(ec))
+			storage(leaf_detail::result_discriminant(error_id(ec)))
 		{
 		}
 
+		template <class C = CtxPtr, class = typename std::enable_if<!std::is_void<C>::value>::type>
 		LEAF_CONSTEXPR result( context_ptr && ctx ) noexcept:
-			ctx_(std::move(ctx)),
-			what_(leaf_detail::result_discriminant::kind_ctx_ptr{})
+			storage(std::move(ctx))
 		{
 		}
 
-		LEAF_CONSTEXPR result & operator=( result && x ) noexcept
-		{
-			destroy();
-			what_ = move_from(std::move(x));
-			return *this;
-		}
+		result & operator=( result && ) = default;
 
-		template <class U>
-		LEAF_CONSTEXPR result & operator=( result<U> && x ) noexcept
+		template <class U, class C, class = enable_from<C>>
+		LEAF_CONSTEXPR result & operator=( result<U, C> && x ) noexcept
 		{
 			destroy();
-			what_ = move_from(std::move(x));
+			what_ = move_from(storage_of(std::move(x)));
 			return *this;
 		}
 
@@ -4594,7 +7140,9 @@ namespace boost { namespace leaf {
 		{
 			using leaf_detail::result_discriminant;
 			assert(what_.kind()!=result_discriminant::val);
-			return what_.kind()==result_discriminant::ctx_ptr ? ctx_->captured_id_ : what_.get_error_id();
+			if( what_.kind()==result_discriminant::ctx_ptr )
+				return storage::captured_id();
+			return what_.get_error_id();
 		}
 
 		LEAF_CONSTEXPR error_result error() noexcept
@@ -4617,16 +7165,16 @@ namespace boost { namespace leaf {
 
 	////////////////////////////////////////
 
-	template <>
-	class result<void>:
-		result<bool>
+	template <class CtxPtr>
+	class result<void, CtxPtr>:
+		result<bool, CtxPtr>
 	{
-		typedef result<bool> base;
+		typedef result<bool, CtxPtr> base;
 
-		template <class U>
+		template <class, class>
 		friend class result;
 
-		LEAF_CONSTEXPR result( result<bool> && rb ):
+		LEAF_CONSTEXPR result( result<bool, CtxPtr> && rb ):
 			base(std::move(rb))
 		{
 		}
@@ -4636,18 +7184,18 @@ namespace boost { namespace leaf {
 		{
 		}
 
+		LEAF_CONSTEXPR explicit result( context_ptr * ctx ) noexcept:
+			base(ctx)
+		{
+		}
+
 	public:
 
 		typedef void value_type;
 
-		~result() noexcept
-		{
-		}
+		result( result && ) = default;
 
-		LEAF_CONSTEXPR result( result && x ) noexcept:
-			base(std::move(x))
-		{
-		}
+		result & operator=( result && ) = default;
 
 		LEAF_CONSTEXPR result() noexcept
 		{
@@ -4663,6 +7211,7 @@ namespace boost { namespace leaf {
 		{
 		}
 
+		template <class C = CtxPtr, class = typename std::enable_if<!std::is_void<C>::value>::type>
 		LEAF_CONSTEXPR result( context_ptr && ctx ) noexcept:
 			base(std::move(ctx))
 		{
@@ -4692,13 +7241,18 @@ namespace boost { namespace leaf {
 		using base::accumulate;
 	};
 
+	// A result<T> which can't hold a context captured by capture. If T is
+	// trivially copyable, so is nocapture_result<T>.
+	template <class T>
+	using nocapture_result = result<T, void>;
+
 	////////////////////////////////////////
 
 	template <class R>
 	struct is_result_type;
 
-	template <class T>
-	struct is_result_type<result<T>>: std::true_type
+	template <class T, class CtxPtr>
+	struct is_result_type<result<T, CtxPtr>>: std::true_type
 	{
 	};
 } }
@@ -64,6 +64,7 @@ namespace boost { namespace leaf {
 		template <class R, class F, class... A>
 		inline decltype(std::declval<F>()(std::forward<A>(std::declval<A>())...)) capture_impl(is_result_tag<R, true>, context_ptr && ctx, F && f, A... a)
 		{
+			static_assert(std::is_constructible<R, context_ptr &&>::value, "capture can't be used with functions that return a nocapture_result");
 			auto active_context = activate_context(*ctx, on_deactivation::do_not_propagate);
 			try
 			{
@@ -100,6 +101,7 @@ namespace boost { namespace leaf {
 		template <class R, class F, class... A>
 		inline decltype(std::declval<F>()(std::forward<A>(std::declval<A>())...)) capture_impl(is_result_tag<R, true>, context_ptr && ctx, F && f, A... a)
 		{
+			static_assert(std::is_constructible<R, context_ptr &&>::value, "capture can't be used with functions that return a nocapture_result");
 			auto active_context = activate_context(*ctx, on_deactivation::do_not_propagate);
 			if( auto r = std::forward<F>(f)(std::forward<A>(a)...) )
 				return r;
@@ -124,23 +126,24 @@ namespace boost { namespace leaf {
 
 #ifndef LEAF_NO_EXCEPTIONS
 
-	template <class T>
-	class result;
-
 	namespace leaf_detail
 	{
-		inline error_id catch_exceptions_helper( std::exception const & ex, leaf_detail_mp11::mp_list<> )
+		inline error_id catch_exceptions_helper( std::exception const &, std::uint64_t, leaf_detail_mp11::mp_list<> )
 		{
 			return leaf::new_error(std::current_exception());
 		}
 
 		template <class Ex1, class... Ex>
-		inline error_id catch_exceptions_helper( std::exception const & ex, leaf_detail_mp11::mp_list<Ex1,Ex...> )
+		inline error_id catch_exceptions_helper( std::exception const & ex, std::uint64_t mask, leaf_detail_mp11::mp_list<Ex1,Ex...> )
 		{
-			if( Ex1 const * p = dynamic_cast<Ex1 const *>(&ex) )
-				return catch_exceptions_helper(ex, leaf_detail_mp11::mp_list<Ex...>{ }).load(*p);
+			if( mask & 1 )
+			{
+				Ex1 const * p = dynamic_cast<Ex1 const *>(&ex);
+				assert(p!=0);
+				return catch_exceptions_helper(ex, mask>>1, leaf_detail_mp11::mp_list<Ex...>{ }).load(*p);
+			}
 			else
-				return catch_exceptions_helper(ex, leaf_detail_mp11::mp_list<Ex...>{ });
+				return catch_exceptions_helper(ex, mask>>1, leaf_detail_mp11::mp_list<Ex...>{ });
 		}
 
 		template <class T>
@@ -149,10 +152,10 @@ namespace boost { namespace leaf {
 			using type = result<T>;
 		};
 
-		template <class T>
-		struct deduce_exception_to_result_return_type_impl<result<T>>
+		template <class T, class CtxPtr>
+		struct deduce_exception_to_result_return_type_impl<result<T, CtxPtr>>
 		{
-			using type = result<T>;
+			using type = result<T, CtxPtr>;
 		};
 
 		template <class T>
@@ -168,7 +171,7 @@ namespace boost { namespace leaf {
 		}
 		catch( std::exception const & ex )
 		{
-			return leaf_detail::catch_exceptions_helper(ex, leaf_detail_mp11::mp_list<Ex...>());
+			return leaf_detail::catch_exceptions_helper(ex, leaf_detail::get_exception_type_mask<Ex...>(ex), leaf_detail_mp11::mp_list<Ex...>());
 		}
 		catch(...)
 		{
@@ -93,18 +93,93 @@
 
 #endif
 
+// Configure LEAF_NO_RTTI, unless already #defined
+#ifndef LEAF_NO_RTTI
+#	if defined(__GNUC__) && !defined(__GXX_RTTI)
+#		define LEAF_NO_RTTI
+#	elif defined(_MSC_VER) && !defined(_CPPRTTI)
+#		define LEAF_NO_RTTI
+#	endif
+#endif
+
 #ifndef LEAF_DIAGNOSTICS
 #	define LEAF_DIAGNOSTICS 1
 #endif
 
-#if LEAF_DIAGNOSTICS!=0 && LEAF_DIAGNOSTICS!=1
-#	error LEAF_DIAGNOSTICS must be 0 or 1.
+#if LEAF_DIAGNOSTICS!=0 && LEAF_DIAGNOSTICS!=1 && LEAF_DIAGNOSTICS!=2
+#	error LEAF_DIAGNOSTICS must be 0, 1 or 2.
+#endif
+
+#ifndef LEAF_UNEXPECTED_INFO_BUFFER_SIZE
+#	define LEAF_UNEXPECTED_INFO_BUFFER_SIZE 256
+#endif
+
+#if LEAF_UNEXPECTED_INFO_BUFFER_SIZE<1
+#	error LEAF_UNEXPECTED_INFO_BUFFER_SIZE must be greater than 0.
+#endif
+
+#ifndef LEAF_TLS_ARRAY_SIZE
+#	define LEAF_TLS_ARRAY_SIZE 64
+#endif
+
+#if LEAF_TLS_ARRAY_SIZE<1
+#	error LEAF_TLS_ARRAY_SIZE must be greater than 0.
+#endif
+
+#ifndef LEAF_SLOT_HEAP_THRESHOLD
+#	define LEAF_SLOT_HEAP_THRESHOLD 0
+#endif
+
+#if LEAF_SLOT_HEAP_THRESHOLD<0
+#	error LEAF_SLOT_HEAP_THRESHOLD must not be negative.
+#endif
+
+#ifndef LEAF_ID_BLOCK_SIZE
+#	define LEAF_ID_BLOCK_SIZE 1
+#endif
+
+#if LEAF_ID_BLOCK_SIZE<1 || (LEAF_ID_BLOCK_SIZE&(LEAF_ID_BLOCK_SIZE-1))!=0
+#	error LEAF_ID_BLOCK_SIZE must be a power of 2.
+#endif
+
+#ifndef LEAF_MATCH_LOOKUP_TABLE_MIN
+#	define LEAF_MATCH_LOOKUP_TABLE_MIN 8
+#endif
+
+#if LEAF_MATCH_LOOKUP_TABLE_MIN<0
+#	error LEAF_MATCH_LOOKUP_TABLE_MIN must not be negative.
+#endif
+
+#ifndef LEAF_ERROR_TRACE_CAPACITY
+#	define LEAF_ERROR_TRACE_CAPACITY 32
+#endif
+
+#if LEAF_ERROR_TRACE_CAPACITY<1
+#	error LEAF_ERROR_TRACE_CAPACITY must be positive.
+#endif
+
+#ifndef LEAF_CONTEXT_POOL_SIZE
+#	define LEAF_CONTEXT_POOL_SIZE 0
+#endif
+
+#if LEAF_CONTEXT_POOL_SIZE<0
+#	error LEAF_CONTEXT_POOL_SIZE must not be negative.
+#endif
+
+#ifndef LEAF_STACKTRACE_MAX_FRAMES
+#	define LEAF_STACKTRACE_MAX_FRAMES 32
+#endif
+
+#if LEAF_STACKTRACE_MAX_FRAMES<1
+#	error LEAF_STACKTRACE_MAX_FRAMES must be positive.
 #endif
 
 #ifdef _MSC_VER
 #	define LEAF_ALWAYS_INLINE __forceinline
+#	define LEAF_NOINLINE __declspec(noinline)
 #else
 #	define LEAF_ALWAYS_INLINE __attribute__((always_inline)) inline
+#	define LEAF_NOINLINE __attribute__((noinline))
 #endif
 
 #if __cplusplus > 201402L
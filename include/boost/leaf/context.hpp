@@ -7,35 +7,310 @@
 // file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
 
 #include <boost/leaf/error.hpp>
+#include <cstdint>
+#include <cstring>
+#include <string>
 
 namespace boost { namespace leaf {
 
+	namespace leaf_detail
+	{
+		template <class E, bool>
+		struct serialize_slot;
+	}
+
+	class serialization_writer
+	{
+		serialization_writer( serialization_writer const & ) = delete;
+		serialization_writer & operator=( serialization_writer const & ) = delete;
+
+		template <class E, bool>
+		friend struct leaf_detail::serialize_slot;
+
+		char * const buf_;
+		std::size_t const capacity_;
+		std::size_t size_;
+
+		template <class T>
+		void patch_value( std::size_t pos, T const & x ) noexcept
+		{
+			assert(pos+sizeof(T)<=size_);
+			if( size_<=capacity_ )
+				std::memcpy(buf_+pos, &x, sizeof(T));
+		}
+
+	public:
+
+		serialization_writer( char * buf, std::size_t capacity ) noexcept:
+			buf_(buf),
+			capacity_(capacity),
+			size_(0)
+		{
+			assert(buf_!=0 || capacity_==0);
+		}
+
+		// Returns the number of bytes written so far. If it is greater than the
+		// capacity of the buffer, the excess bytes were not stored.
+		std::size_t size() const noexcept
+		{
+			return size_;
+		}
+
+		void write_bytes( void const * data, std::size_t n ) noexcept
+		{
+			if( size_<=capacity_ && n<=capacity_-size_ )
+				std::memcpy(buf_+size_, data, n);
+			size_ += n;
+		}
+
+		template <class T>
+		void write_value( T const & x ) noexcept
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "write_value requires a trivially copyable type");
+			write_bytes(&x, sizeof(T));
+		}
+
+		void write_string( char const * s, std::size_t n ) noexcept
+		{
+			write_value(std::uint32_t(n));
+			write_bytes(s, n);
+		}
+
+		void write_string( std::string const & s ) noexcept
+		{
+			write_string(s.data(), s.size());
+		}
+	};
+
+	class serialization_reader
+	{
+		serialization_reader( serialization_reader const & ) = delete;
+		serialization_reader & operator=( serialization_reader const & ) = delete;
+
+		char const * p_;
+		char const * const end_;
+
+	public:
+
+		serialization_reader( char const * buf, std::size_t size ) noexcept:
+			p_(buf),
+			end_(buf+size)
+		{
+			assert(buf!=0 || size==0);
+		}
+
+		std::size_t remaining() const noexcept
+		{
+			return std::size_t(end_-p_);
+		}
+
+		bool read_bytes( void * data, std::size_t n ) noexcept
+		{
+			if( n>remaining() )
+				return false;
+			std::memcpy(data, p_, n);
+			p_ += n;
+			return true;
+		}
+
+		bool skip( std::size_t n ) noexcept
+		{
+			if( n>remaining() )
+				return false;
+			p_ += n;
+			return true;
+		}
+
+		template <class T>
+		bool read_value( T & x ) noexcept
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "read_value requires a trivially copyable type");
+			return read_bytes(&x, sizeof(T));
+		}
+
+		bool read_string( std::string & s )
+		{
+			std::uint32_t n;
+			if( !read_value(n) || n>remaining() )
+				return false;
+			s.assign(p_, n);
+			p_ += n;
+			return true;
+		}
+	};
+
+	// Specialize to enable serialization of E-objects of type E, see serialize.
+	template <class E>
+	struct serialization;
+
+	template <class E>
+	struct trivial_serialization
+	{
+		static_assert(std::is_trivially_copyable<E>::value, "trivial_serialization requires a trivially copyable type");
+
+		static void write( serialization_writer & w, E const & e ) noexcept
+		{
+			w.write_value(e);
+		}
+
+		static bool read( serialization_reader & r, E & e ) noexcept
+		{
+			return r.read_value(e);
+		}
+	};
+
+	namespace leaf_detail
+	{
+		template <class E, class = void>
+		struct is_serializable: std::false_type
+		{
+		};
+
+		template <class E>
+		struct is_serializable<E, decltype(serialization<E>::write(std::declval<serialization_writer &>(), std::declval<E const &>()), void())>: std::true_type
+		{
+		};
+
+		// Serialized context format (native byte order):
+		//   char[4]       "LEAF"
+		//   std::uint32_t number of E-objects
+		//   For each E-object:
+		//     std::uint64_t type_name hash of its E-type
+		//     std::uint32_t size of the serialized E-object
+		//     char[size]    data written by serialization<E>::write
+		LEAF_CONSTEXPR inline char const * serialization_magic() noexcept { return "LEAF"; }
+		constexpr std::size_t serialization_magic_size = 4;
+
+		inline bool read_serialization_header( serialization_reader & r, std::uint32_t & n ) noexcept
+		{
+			char magic[serialization_magic_size];
+			return r.read_bytes(magic, sizeof(magic)) && std::memcmp(magic, serialization_magic(), sizeof(magic))==0 && r.read_value(n);
+		}
+
+		template <class E, bool = is_serializable<E>::value>
+		struct serialize_slot
+		{
+			static void count( slot<E> const &, id_type, std::uint32_t & ) noexcept
+			{
+			}
+
+			static void write( slot<E> const &, id_type, serialization_writer & ) noexcept
+			{
+			}
+
+			static bool read( slot<E> &, id_type, std::uint64_t, serialization_reader & ) noexcept
+			{
+				return false;
+			}
+		};
+
+		template <class E>
+		struct serialize_slot<E, true>
+		{
+			static void count( slot<E> const & sl, id_type err_id, std::uint32_t & n ) noexcept
+			{
+				if( sl.has_value(err_id) )
+					++n;
+			}
+
+			static void write( slot<E> const & sl, id_type err_id, serialization_writer & w )
+			{
+				if( E const * e = sl.has_value(err_id) )
+				{
+					w.write_value(type<E>().hash);
+					std::size_t const size_pos = w.size();
+					w.write_value(std::uint32_t(0));
+					serialization<E>::write(w, *e);
+					w.patch_value(size_pos, std::uint32_t(w.size()-size_pos-sizeof(std::uint32_t)));
+				}
+			}
+
+			// Returns false if the hash does not match E. The reader is
+			// bounded by the size of the serialized E-object.
+			static bool read( slot<E> & sl, id_type err_id, std::uint64_t hash, serialization_reader & r )
+			{
+				static_assert(std::is_default_constructible<E>::value, "deserialize requires serializable E-types to be default-constructible");
+				if( hash!=type<E>().hash )
+					return false;
+				E e{};
+				if( serialization<E>::read(r, e) )
+					(void) sl.put(err_id, std::move(e));
+				return true;
+			}
+		};
+
+		template <class E>
+		inline void serialize_slot_count( slot<E> const & sl, id_type err_id, std::uint32_t & n ) noexcept
+		{
+			serialize_slot<E>::count(sl, err_id, n);
+		}
+
+		template <class E>
+		inline void serialize_slot_write( slot<E> const & sl, id_type err_id, serialization_writer & w )
+		{
+			serialize_slot<E>::write(sl, err_id, w);
+		}
+
+		template <class E>
+		inline bool serialize_slot_read( slot<E> & sl, id_type err_id, std::uint64_t hash, serialization_reader & r )
+		{
+			return serialize_slot<E>::read(sl, err_id, hash, r);
+		}
+	}
+
 	namespace leaf_detail
 	{
 		template <int I, class Tuple>
 		struct tuple_for_each
 		{
-			LEAF_CONSTEXPR static void activate( Tuple & tup ) noexcept
+			LEAF_CONSTEXPR static void activate( Tuple & tup, tl_slot_table table ) noexcept
 			{
-				tuple_for_each<I-1,Tuple>::activate(tup);
-				std::get<I-1>(tup).activate();
+				tuple_for_each<I-1,Tuple>::activate(tup, table);
+				std::get<I-1>(tup).activate(table);
 			}
 
-			LEAF_CONSTEXPR static void deactivate( Tuple & tup, bool propagate_errors ) noexcept
+			// Propagates errors only from the slots whose bits are set in
+			// propagate_mask. Returns the bits of the slots which still hold
+			// E-objects afterwards.
+			LEAF_CONSTEXPR static dirty_mask deactivate( Tuple & tup, dirty_mask propagate_mask ) noexcept
 			{
-				std::get<I-1>(tup).deactivate(propagate_errors);
-				tuple_for_each<I-1,Tuple>::deactivate(tup, propagate_errors);
+				dirty_mask const bit = dirty_bit(I-1);
+				dirty_mask holds_value = std::get<I-1>(tup).deactivate((propagate_mask & bit)!=0) ? bit : 0;
+				return tuple_for_each<I-1,Tuple>::deactivate(tup, propagate_mask) | holds_value;
 			}
 
-			LEAF_CONSTEXPR static void propagate( Tuple & tup, int err_id ) noexcept
+			LEAF_CONSTEXPR static void bind_owner( Tuple & tup, dirty_mask * mask ) noexcept
+			{
+				tuple_for_each<I-1,Tuple>::bind_owner(tup, mask);
+				std::get<I-1>(tup).bind_owner(mask, dirty_bit(I-1));
+			}
+
+			LEAF_CONSTEXPR static void propagate( Tuple & tup, id_type err_id, tl_slot_table table ) noexcept
 			{
 				auto & sl = std::get<I-1>(tup);
 				if( sl.has_value(err_id) )
-					leaf_detail::load_slot(err_id, std::move(sl).value(err_id));
-				tuple_for_each<I-1,Tuple>::propagate(tup, err_id);
+					leaf_detail::load_slot(err_id, std::move(sl).value(err_id), table);
+				tuple_for_each<I-1,Tuple>::propagate(tup, err_id, table);
+			}
+
+			static void serialize_count( Tuple const & tup, id_type err_id, std::uint32_t & n ) noexcept
+			{
+				tuple_for_each<I-1,Tuple>::serialize_count(tup, err_id, n);
+				serialize_slot_count(std::get<I-1>(tup), err_id, n);
+			}
+
+			static void serialize( Tuple const & tup, id_type err_id, serialization_writer & w )
+			{
+				tuple_for_each<I-1,Tuple>::serialize(tup, err_id, w);
+				serialize_slot_write(std::get<I-1>(tup), err_id, w);
+			}
+
+			static bool deserialize( Tuple & tup, id_type err_id, std::uint64_t hash, serialization_reader & r )
+			{
+				return serialize_slot_read(std::get<I-1>(tup), err_id, hash, r) || tuple_for_each<I-1,Tuple>::deserialize(tup, err_id, hash, r);
 			}
 
-			static void print( std::ostream & os, void const * tup, int key_to_print )
+			static void print( std::ostream & os, void const * tup, id_type key_to_print )
 			{
 				assert(tup!=0);
 				tuple_for_each<I-1,Tuple>::print(os, tup, key_to_print);
@@ -46,10 +321,14 @@ namespace boost { namespace leaf {
 		template <class Tuple>
 		struct tuple_for_each<0, Tuple>
 		{
-			LEAF_CONSTEXPR static void activate( Tuple & ) noexcept { }
-			LEAF_CONSTEXPR static void deactivate( Tuple &, bool ) noexcept { }
-			LEAF_CONSTEXPR static void propagate( Tuple & tup, int ) noexcept { }
-			static void print( std::ostream &, void const *, int ) { }
+			LEAF_CONSTEXPR static void activate( Tuple &, tl_slot_table ) noexcept { }
+			LEAF_CONSTEXPR static dirty_mask deactivate( Tuple &, dirty_mask ) noexcept { return 0; }
+			LEAF_CONSTEXPR static void bind_owner( Tuple &, dirty_mask * ) noexcept { }
+			LEAF_CONSTEXPR static void propagate( Tuple &, id_type, tl_slot_table ) noexcept { }
+			static void serialize_count( Tuple const &, id_type, std::uint32_t & ) noexcept { }
+			static void serialize( Tuple const &, id_type, serialization_writer & ) noexcept { }
+			static bool deserialize( Tuple &, id_type, std::uint64_t, serialization_reader & ) noexcept { return false; }
+			static void print( std::ostream &, void const *, id_type ) { }
 		};
 	}
 
@@ -188,20 +467,35 @@ namespace boost { namespace leaf {
 #if !defined(LEAF_NO_THREADS) && !defined(NDEBUG)
 			std::thread::id thread_id_;
 #endif
+			dirty_mask dirty_mask_; // The bits of the slots in tup_ that may hold E-objects, see slot<E>::put.
 			bool is_active_;
+#if LEAF_DIAGNOSTICS==2
+			bool unexpected_enabled_;
+#endif
 
 		public:
 
 			LEAF_CONSTEXPR context_base() noexcept:
+				dirty_mask_(0),
 				is_active_(false)
+#if LEAF_DIAGNOSTICS==2
+				, unexpected_enabled_(false)
+#endif
 			{
+				leaf_detail::tuple_for_each<std::tuple_size<Tup>::value,Tup>::bind_owner(tup_, &dirty_mask_);
 			}
 
 			LEAF_CONSTEXPR context_base( context_base && x ) noexcept:
 				tup_(std::move(x.tup_)),
+				dirty_mask_(x.dirty_mask_),
 				is_active_(false)
+#if LEAF_DIAGNOSTICS==2
+				, unexpected_enabled_(false)
+#endif
 			{
 				assert(!x.is_active());
+				x.dirty_mask_ = 0;
+				leaf_detail::tuple_for_each<std::tuple_size<Tup>::value,Tup>::bind_owner(tup_, &dirty_mask_);
 			}
 
 			~context_base() noexcept
@@ -218,8 +512,12 @@ namespace boost { namespace leaf {
 			{
 				using namespace leaf_detail;
 				assert(!is_active());
-				tuple_for_each<std::tuple_size<Tup>::value,Tup>::activate(tup_);
-#if LEAF_DIAGNOSTICS
+				tuple_for_each<std::tuple_size<Tup>::value,Tup>::activate(tup_, get_tl_slot_table());
+#if LEAF_DIAGNOSTICS==2
+				if( unexpected_requested<Tup>::value )
+					if( (unexpected_enabled_ = sample_diagnostics()) )
+						++tl_unexpected_enabled_counter();
+#elif LEAF_DIAGNOSTICS
 				if( unexpected_requested<Tup>::value )
 					++tl_unexpected_enabled_counter();
 #endif
@@ -238,11 +536,19 @@ namespace boost { namespace leaf {
 				assert(std::this_thread::get_id() == thread_id_);
 				thread_id_ = std::thread::id();
 #endif
-#if LEAF_DIAGNOSTICS
+#if LEAF_DIAGNOSTICS==2
+				if( unexpected_requested<Tup>::value && unexpected_enabled_ )
+					--tl_unexpected_enabled_counter();
+#elif LEAF_DIAGNOSTICS
 				if( unexpected_requested<Tup>::value )
 					--tl_unexpected_enabled_counter();
 #endif
-				tuple_for_each<std::tuple_size<Tup>::value,Tup>::deactivate(tup_, propagate_errors);
+				// Only the slots written to (since they were last emptied) are
+				// checked for E-objects to propagate.
+				if( propagate_errors )
+					dirty_mask_ = tuple_for_each<std::tuple_size<Tup>::value,Tup>::deactivate(tup_, dirty_mask_);
+				else
+					(void) tuple_for_each<std::tuple_size<Tup>::value,Tup>::deactivate(tup_, 0);
 			}
 
 			LEAF_CONSTEXPR bool is_active() const noexcept
@@ -255,11 +561,58 @@ namespace boost { namespace leaf {
 				leaf_detail::tuple_for_each<std::tuple_size<Tup>::value,Tup>::print(os, &tup_, 0);
 			}
 
+			std::size_t serialize( error_id err_id, char * buf, std::size_t size ) const
+			{
+				using namespace leaf_detail;
+				serialization_writer w(buf, size);
+				w.write_bytes(serialization_magic(), serialization_magic_size);
+				std::uint32_t n = 0;
+				tuple_for_each<std::tuple_size<Tup>::value,Tup>::serialize_count(tup_, err_id.value(), n);
+				w.write_value(n);
+				tuple_for_each<std::tuple_size<Tup>::value,Tup>::serialize(tup_, err_id.value(), w);
+				return w.size();
+			}
+
+			error_id deserialize( char const * buf, std::size_t size )
+			{
+				using namespace leaf_detail;
+				assert(!is_active());
+				std::uint32_t n;
+				{
+					// Check the whole buffer first, so that nothing is stored if
+					// it is truncated.
+					serialization_reader r(buf, size);
+					if( !read_serialization_header(r, n) )
+						return error_id();
+					for( std::uint32_t i=0; i!=n; ++i )
+					{
+						std::uint64_t hash;
+						std::uint32_t obj_size;
+						if( !r.read_value(hash) || !r.read_value(obj_size) || !r.skip(obj_size) )
+							return error_id();
+					}
+				}
+				serialization_reader r(buf, size);
+				(void) read_serialization_header(r, n);
+				error_id err_id = make_error_id(new_id());
+				for( ; n; --n )
+				{
+					std::uint64_t hash = 0;
+					std::uint32_t obj_size = 0;
+					(void) r.read_value(hash);
+					(void) r.read_value(obj_size);
+					serialization_reader obj(buf+(size-r.remaining()), obj_size);
+					(void) tuple_for_each<std::tuple_size<Tup>::value,Tup>::deserialize(tup_, err_id.value(), hash, obj);
+					(void) r.skip(obj_size);
+				}
+				return err_id;
+			}
+
 		protected:
 
 			LEAF_CONSTEXPR error_id propagate_captured_errors( error_id err_id ) noexcept
 			{
-				tuple_for_each<std::tuple_size<Tup>::value,Tup>::propagate(tup_, err_id.value());
+				tuple_for_each<std::tuple_size<Tup>::value,Tup>::propagate(tup_, err_id.value(), get_tl_slot_table());
 				return err_id;
 			}
 
@@ -439,6 +792,7 @@ namespace boost { namespace leaf {
 			void deactivate( bool propagate_errors ) noexcept final override { Ctx::deactivate(propagate_errors); }
 			bool is_active() const noexcept final override { return Ctx::is_active(); }
 			void print( std::ostream & os ) const final override { return Ctx::print(os); }
+			std::size_t serialize( char * buf, std::size_t size ) const final override { return Ctx::serialize(captured_id_, buf, size); }
 		};
 	}
 
@@ -460,16 +814,111 @@ namespace boost { namespace leaf {
 		return { };
 	}
 
-	template <class RemoteH>
-	inline context_ptr make_shared_context( RemoteH const * = 0 )
+	inline std::size_t serialize( polymorphic_context const & ctx, char * buf, std::size_t size )
+	{
+		return ctx.serialize(buf, size);
+	}
+
+	template <class Ctx>
+	inline error_id deserialize( char const * buf, std::size_t size, Ctx & ctx )
+	{
+		return ctx.deserialize(buf, size);
+	}
+
+	namespace leaf_detail
 	{
-		return std::make_shared<leaf_detail::polymorphic_context_impl<context_type_from_remote_handler<RemoteH>>>();
+#if LEAF_CONTEXT_POOL_SIZE
+		// An allocator which recycles single-object blocks through the calling
+		// thread's context_block_cache, falling back to Alloc. Passed to
+		// std::allocate_shared, it recycles the combined memory of the context
+		// and its shared_ptr control block, which is freed (into the cache of
+		// the thread which drops the last reference) together with the last
+		// result or exception that refers to the context.
+		template <class T, class Alloc>
+		class context_pool_allocator
+		{
+			template <class, class>
+			friend class context_pool_allocator;
+
+			Alloc alloc_;
+
+		public:
+
+			using value_type = T;
+
+			template <class U>
+			struct rebind
+			{
+				using other = context_pool_allocator<U, Alloc>;
+			};
+
+			explicit context_pool_allocator( Alloc const & a ) noexcept:
+				alloc_(a)
+			{
+			}
+
+			template <class U>
+			context_pool_allocator( context_pool_allocator<U, Alloc> const & x ) noexcept:
+				alloc_(x.alloc_)
+			{
+			}
+
+			T * allocate( std::size_t n )
+			{
+				if( n==1 )
+					return context_block_cache<T, Alloc>::allocate(alloc_);
+				typename std::allocator_traits<Alloc>::template rebind_alloc<T> a(alloc_);
+				return std::allocator_traits<decltype(a)>::allocate(a, n);
+			}
+
+			void deallocate( T * p, std::size_t n ) noexcept
+			{
+				if( n==1 )
+					return context_block_cache<T, Alloc>::deallocate(alloc_, p);
+				typename std::allocator_traits<Alloc>::template rebind_alloc<T> a(alloc_);
+				std::allocator_traits<decltype(a)>::deallocate(a, p, n);
+			}
+
+			template <class U>
+			bool operator==( context_pool_allocator<U, Alloc> const & ) const noexcept
+			{
+				return true;
+			}
+
+			template <class U>
+			bool operator!=( context_pool_allocator<U, Alloc> const & ) const noexcept
+			{
+				return false;
+			}
+		};
+
+		// Only stateless allocators can be pooled: a block cached by one
+		// allocator object may be handed out by (and returned to) another.
+		template <class Ctx, class Alloc>
+		inline context_ptr allocate_shared_context_impl( Alloc const & alloc, std::true_type )
+		{
+			return std::allocate_shared<Ctx>(context_pool_allocator<Ctx, Alloc>(alloc));
+		}
+#endif
+
+		template <class Ctx, class Alloc>
+		inline context_ptr allocate_shared_context_impl( Alloc const & alloc, std::false_type )
+		{
+			return std::allocate_shared<Ctx>(alloc);
+		}
 	}
 
 	template <class RemoteH, class Alloc>
 	inline context_ptr allocate_shared_context( Alloc alloc, RemoteH const * = 0 )
 	{
-		return std::make_shared<leaf_detail::polymorphic_context_impl<context_type_from_remote_handler<RemoteH>>>(alloc);
+		using pooled = std::integral_constant<bool, LEAF_CONTEXT_POOL_SIZE && std::is_empty<Alloc>::value>;
+		return leaf_detail::allocate_shared_context_impl<leaf_detail::polymorphic_context_impl<context_type_from_remote_handler<RemoteH>>>(alloc, pooled());
+	}
+
+	template <class RemoteH>
+	inline context_ptr make_shared_context( RemoteH const * h = 0 )
+	{
+		return allocate_shared_context(std::allocator<char>(), h);
 	}
 } }
 
@@ -101,7 +101,7 @@ namespace boost { namespace leaf {
 	{
 		leaf_detail::e_unexpected_count const * e_uc_;
 		void const * tup_;
-		void (*print_)( std::ostream &, void const * tup, int key_to_print );
+		void (*print_)( std::ostream &, void const * tup, leaf_detail::id_type key_to_print );
 
 	public:
 
@@ -130,7 +130,7 @@ namespace boost { namespace leaf {
 	{
 		leaf_detail::e_unexpected_info const * e_ui_;
 		void const * tup_;
-		void (*print_)( std::ostream &, void const * tup, int key_to_print );
+		void (*print_)( std::ostream &, void const * tup, leaf_detail::id_type key_to_print );
 
 	public:
 
@@ -199,6 +199,91 @@ namespace boost { namespace leaf {
 
 	////////////////////////////////////////
 
+	namespace leaf_detail
+	{
+		// Output goes to a caller-supplied buffer; whatever does not fit is
+		// discarded.
+		class buffer_streambuf: public std::streambuf
+		{
+		public:
+
+			buffer_streambuf( char * buf, std::size_t size ) noexcept
+			{
+				assert(buf!=0);
+				assert(size>0);
+				setp(buf, buf+size-1);
+			}
+
+			std::size_t finish() noexcept
+			{
+				*pptr() = 0;
+				return std::size_t(pptr()-pbase());
+			}
+		};
+
+		// Output is collected in an internal buffer which is passed to the sink
+		// only when it is full, and once more by finish().
+		template <class Sink>
+		class sink_streambuf: public std::streambuf
+		{
+			Sink & sink_;
+			char buf_[512];
+
+			void flush_buf()
+			{
+				if( std::size_t n = std::size_t(pptr()-pbase()) )
+					sink_(static_cast<char const *>(buf_), n);
+				setp(buf_, buf_+sizeof(buf_));
+			}
+
+			int_type overflow( int_type c ) final override
+			{
+				flush_buf();
+				if( !traits_type::eq_int_type(c, traits_type::eof()) )
+				{
+					*pptr() = traits_type::to_char_type(c);
+					pbump(1);
+				}
+				return traits_type::not_eof(c);
+			}
+
+		public:
+
+			explicit sink_streambuf( Sink & sink ) noexcept:
+				sink_(sink)
+			{
+				setp(buf_, buf_+sizeof(buf_));
+			}
+
+			void finish()
+			{
+				flush_buf();
+			}
+		};
+	}
+
+	template <class T>
+	std::size_t format_to_buffer( char * buf, std::size_t size, T const & x )
+	{
+		leaf_detail::buffer_streambuf sb(buf, size);
+		std::ostream os(&sb);
+		os << x;
+		return sb.finish();
+	}
+
+	template <class Sink, class T>
+	void format_to_sink( Sink && sink, T const & x )
+	{
+		leaf_detail::sink_streambuf<typename std::remove_reference<Sink>::type> sb(sink);
+		{
+			std::ostream os(&sb);
+			os << x;
+		}
+		sb.finish();
+	}
+
+	////////////////////////////////////////
+
 	namespace leaf_detail
 	{
 		template <class T, class... List>
@@ -230,6 +315,40 @@ namespace boost { namespace leaf {
 		{
 			return err ? std::get<tuple_type_index<slot<E>,SlotsTuple>::value>(tup).has_value(err.value()) : 0;
 		}
+
+		// With LEAF_HANDLER_PRESENCE_MASK, bit I of the presence mask of a slots
+		// tuple is set if the I-th slot holds an E-object associated with the
+		// error being handled. Slots past the 64th are not represented in the
+		// mask, and are checked with peek instead.
+		using presence_mask = std::uint64_t;
+
+		template <int I>
+		constexpr presence_mask slot_bit() noexcept
+		{
+			return I<64 ? presence_mask(1)<<(I%64) : 0;
+		}
+
+		template <class E, class SlotsTuple>
+		struct slot_mask
+		{
+			constexpr static presence_mask value = slot_bit<tuple_type_index<slot<E>,SlotsTuple>::value>();
+		};
+
+		template <class SlotsTuple, std::size_t... I>
+		LEAF_CONSTEXPR inline presence_mask get_presence_mask_( SlotsTuple const & tup, id_type err_id, leaf_detail_mp11::index_sequence<I...> ) noexcept
+		{
+			presence_mask const bits[ ] = { 0, (slot_bit<I>() * (std::get<I>(tup).key()==err_id))... };
+			presence_mask pm = 0;
+			for( presence_mask b : bits )
+				pm |= b;
+			return pm;
+		}
+
+		template <class SlotsTuple>
+		LEAF_CONSTEXPR inline presence_mask get_presence_mask( SlotsTuple const & tup, error_id err ) noexcept
+		{
+			return err ? get_presence_mask_(tup, err.value(), leaf_detail_mp11::make_index_sequence<std::tuple_size<SlotsTuple>::value>()) : 0;
+		}
 	}
 
 	////////////////////////////////////////
@@ -322,6 +441,115 @@ namespace boost { namespace leaf {
 		{
 			return x==v1 || check_value_pack(x,v_rest...);
 		}
+
+		// When a match<> pack has at least LEAF_MATCH_LOOKUP_TABLE_MIN integral or
+		// enum values that fit in a small range (no more than 64 possible values per
+		// value in the pack), it is converted at compile time to a bitset indexed by
+		// the value being matched, so it is checked with a single load instead of a
+		// chain of == comparisons.
+
+		constexpr std::intmax_t min_enumerator( std::intmax_t v ) noexcept
+		{
+			return v;
+		}
+
+		template <class... Rest>
+		constexpr std::intmax_t min_enumerator( std::intmax_t v1, std::intmax_t v2, Rest... v_rest ) noexcept
+		{
+			return min_enumerator(v1<v2 ? v1 : v2, v_rest...);
+		}
+
+		constexpr std::intmax_t max_enumerator( std::intmax_t v ) noexcept
+		{
+			return v;
+		}
+
+		template <class... Rest>
+		constexpr std::intmax_t max_enumerator( std::intmax_t v1, std::intmax_t v2, Rest... v_rest ) noexcept
+		{
+			return max_enumerator(v1<v2 ? v2 : v1, v_rest...);
+		}
+
+		constexpr std::uint64_t enumerator_bitset_word( std::intmax_t, std::size_t ) noexcept
+		{
+			return 0;
+		}
+
+		template <class... Rest>
+		constexpr std::uint64_t enumerator_bitset_word( std::intmax_t min, std::size_t word, std::intmax_t v1, Rest... v_rest ) noexcept
+		{
+			return
+				((std::uint64_t(v1)-std::uint64_t(min))/64==word ? std::uint64_t(1)<<((std::uint64_t(v1)-std::uint64_t(min))%64) : 0) |
+				enumerator_bitset_word(min, word, v_rest...);
+		}
+
+		template <class Enumerator, Enumerator... V>
+		struct enumerator_range
+		{
+			constexpr static std::intmax_t min = min_enumerator(std::intmax_t(V)...);
+			constexpr static std::uint64_t size = std::uint64_t(max_enumerator(std::intmax_t(V)...)) - std::uint64_t(min) + 1;
+		};
+
+		template <bool Integral, class Enumerator, Enumerator... V>
+		struct use_enumerator_bitset_impl: std::false_type
+		{
+		};
+
+		template <class Enumerator, Enumerator... V>
+		struct use_enumerator_bitset_impl<true, Enumerator, V...>: std::integral_constant<bool,
+			enumerator_range<Enumerator, V...>::size!=0 &&
+			(enumerator_range<Enumerator, V...>::size-1)/64 < sizeof...(V)>
+		{
+		};
+
+		template <class MatchType, class Enumerator, Enumerator... V>
+		struct use_enumerator_bitset: use_enumerator_bitset_impl<
+			LEAF_MATCH_LOOKUP_TABLE_MIN!=0 && sizeof...(V)>=LEAF_MATCH_LOOKUP_TABLE_MIN &&
+			std::is_same<MatchType, Enumerator>::value &&
+			(std::is_integral<Enumerator>::value || std::is_enum<Enumerator>::value),
+			Enumerator, V...>
+		{
+		};
+
+		template <class Words, class Enumerator, Enumerator... V>
+		struct enumerator_bitset;
+
+		template <std::size_t... W, class Enumerator, Enumerator... V>
+		struct enumerator_bitset<leaf_detail_mp11::index_sequence<W...>, Enumerator, V...>
+		{
+			using range = enumerator_range<Enumerator, V...>;
+
+			constexpr static std::uint64_t words[ ] = { enumerator_bitset_word(range::min, W, std::intmax_t(V)...)... };
+
+			LEAF_CONSTEXPR static bool check( Enumerator x ) noexcept
+			{
+				std::uint64_t i = std::uint64_t(std::intmax_t(x)) - std::uint64_t(range::min);
+				return i<range::size && ((words[i/64] >> (i%64)) & 1);
+			}
+		};
+
+		template <std::size_t... W, class Enumerator, Enumerator... V>
+		constexpr std::uint64_t enumerator_bitset<leaf_detail_mp11::index_sequence<W...>, Enumerator, V...>::words[ ];
+
+		template <class MatchType, class Enumerator, Enumerator... V>
+		struct check_value_pack_
+		{
+			LEAF_CONSTEXPR static bool check( MatchType const & x, std::false_type ) noexcept
+			{
+				return check_value_pack(x, V...);
+			}
+
+			LEAF_CONSTEXPR static bool check( MatchType const & x, std::true_type ) noexcept
+			{
+				using range = enumerator_range<Enumerator, V...>;
+				return enumerator_bitset<leaf_detail_mp11::make_index_sequence<(range::size-1)/64+1>, Enumerator, V...>::check(x);
+			}
+
+			LEAF_CONSTEXPR static bool check( MatchType const & x ) noexcept
+			{
+				return check(x, use_enumerator_bitset<MatchType, Enumerator, V...>());
+			}
+		};
 	}
 
 	template <class E, typename leaf_detail::match_traits<E>::enumerator... V>
@@ -342,7 +570,7 @@ namespace boost { namespace leaf {
 
 		LEAF_CONSTEXPR bool operator()() const noexcept
 		{
-			return value_ && leaf_detail::check_value_pack(*value_,V...);
+			return value_ && leaf_detail::check_value_pack_<type, typename leaf_detail::match_traits<E>::enumerator, V...>::check(*value_);
 		}
 
 		LEAF_CONSTEXPR type const & value() const noexcept
@@ -367,15 +595,23 @@ namespace boost { namespace leaf {
 		template <class SlotsTuple,class T>
 		struct check_one_argument
 		{
+			constexpr static presence_mask required_mask = slot_mask<T,SlotsTuple>::value;
+
 			LEAF_CONSTEXPR static bool check( SlotsTuple const & tup, error_info const & ei ) noexcept
 			{
+#ifdef LEAF_HANDLER_PRESENCE_MASK
+				return required_mask!=0 || peek<T>(tup, ei.error())!=0;
+#else
 				return peek<T>(tup, ei.error())!=0;
+#endif
 			}
 		};
 
 		template <class SlotsTuple,class T>
 		struct check_one_argument<SlotsTuple,T *>
 		{
+			constexpr static presence_mask required_mask = 0;
+
 			constexpr static bool check( SlotsTuple const &, error_info const & ) noexcept
 			{
 				return true;
@@ -385,6 +621,8 @@ namespace boost { namespace leaf {
 		template <class SlotsTuple>
 		struct check_one_argument<SlotsTuple,error_info>
 		{
+			constexpr static presence_mask required_mask = 0;
+
 			constexpr static bool check( SlotsTuple const &, error_info const & )
 			{
 				return true;
@@ -394,6 +632,8 @@ namespace boost { namespace leaf {
 		template <class SlotsTuple>
 		struct check_one_argument<SlotsTuple,diagnostic_info>
 		{
+			constexpr static presence_mask required_mask = 0;
+
 			constexpr static bool check( SlotsTuple const &, error_info const & ) noexcept
 			{
 				return true;
@@ -403,6 +643,8 @@ namespace boost { namespace leaf {
 		template <class SlotsTuple>
 		struct check_one_argument<SlotsTuple,verbose_diagnostic_info>
 		{
+			constexpr static presence_mask required_mask = 0;
+
 			constexpr static bool check( SlotsTuple const &, error_info const & ) noexcept
 			{
 				return true;
@@ -412,6 +654,8 @@ namespace boost { namespace leaf {
 		template <class SlotsTuple>
 		struct check_one_argument<SlotsTuple,std::error_code>
 		{
+			constexpr static presence_mask required_mask = 0;
+
 			constexpr static bool check( SlotsTuple const &, error_info const & ) noexcept
 			{
 				return true;
@@ -421,6 +665,8 @@ namespace boost { namespace leaf {
 		template <class SlotsTuple, class T, typename match_traits<T>::enumerator... V>
 		struct check_one_argument<SlotsTuple,match<T,V...>>
 		{
+			constexpr static presence_mask required_mask = slot_mask<typename match_traits<T>::e_type,SlotsTuple>::value;
+
 			LEAF_CONSTEXPR static bool check( SlotsTuple const & tup, error_info const & ei ) noexcept
 			{
 				return match<T,V...>(match_traits<T>::read(tup,ei))();
@@ -433,6 +679,8 @@ namespace boost { namespace leaf {
 		template <class SlotsTuple, class Car, class... Cdr>
 		struct check_arguments<SlotsTuple, Car, Cdr...>
 		{
+			constexpr static presence_mask required_mask = check_one_argument<SlotsTuple,Car>::required_mask | check_arguments<SlotsTuple,Cdr...>::required_mask;
+
 			LEAF_CONSTEXPR static bool check( SlotsTuple const & tup, error_info const & ei ) noexcept
 			{
 				return check_one_argument<SlotsTuple,Car>::check(tup,ei) && check_arguments<SlotsTuple,Cdr...>::check(tup,ei);
@@ -442,6 +690,8 @@ namespace boost { namespace leaf {
 		template <class SlotsTuple>
 		struct check_arguments<SlotsTuple>
 		{
+			constexpr static presence_mask required_mask = 0;
+
 			constexpr static bool check( SlotsTuple const &, error_info const & ) noexcept
 			{
 				return true;
@@ -513,7 +763,7 @@ namespace boost { namespace leaf {
 		struct get_one_argument<diagnostic_info>
 		{
 			template <class SlotsTuple>
-			LEAF_CONSTEXPR static diagnostic_info get( SlotsTuple const & tup, error_info const & ei ) noexcept
+			LEAF_CONSTEXPR static diagnostic_info get( SlotsTuple const &, error_info const & ei ) noexcept
 			{
 				return diagnostic_info(ei);
 			}
@@ -523,7 +773,7 @@ namespace boost { namespace leaf {
 		struct get_one_argument<verbose_diagnostic_info>
 		{
 			template <class SlotsTuple>
-			LEAF_CONSTEXPR static verbose_diagnostic_info get( SlotsTuple const & tup, error_info const & ei ) noexcept
+			LEAF_CONSTEXPR static verbose_diagnostic_info get( SlotsTuple const &, error_info const & ei ) noexcept
 			{
 				return verbose_diagnostic_info(ei);
 			}
@@ -588,12 +838,28 @@ namespace boost { namespace leaf {
 
 	namespace leaf_detail
 	{
+#ifdef LEAF_HANDLER_PRESENCE_MASK
+
+		// The E-objects required by the handler are checked all at once against
+		// the presence mask; only the arguments which need more than that (e.g.
+		// match<>) are checked individually.
+		template <class Tup, class... T>
+		LEAF_CONSTEXPR inline bool check_handler_( Tup const & e_objects, error_info const & ei, presence_mask pm, leaf_detail_mp11::mp_list<T...> ) noexcept
+		{
+			using check = check_arguments<Tup,typename std::remove_cv<typename std::remove_reference<T>::type>::type...>;
+			return (pm & check::required_mask)==check::required_mask && check::check(e_objects, ei);
+		}
+
+#else
+
 		template <class Tup, class... T>
-		LEAF_CONSTEXPR inline bool check_handler_( Tup const & e_objects, error_info const & ei, leaf_detail_mp11::mp_list<T...> ) noexcept
+		LEAF_CONSTEXPR inline bool check_handler_( Tup const & e_objects, error_info const & ei, presence_mask, leaf_detail_mp11::mp_list<T...> ) noexcept
 		{
 			return check_arguments<Tup,typename std::remove_cv<typename std::remove_reference<T>::type>::type...>::check(e_objects, ei);
 		}
 
+#endif
+
 		template <class R, class F, bool IsResult = is_result_type<R>::value, class FReturnType = fn_return_type<F>>
 		struct handler_caller
 		{
@@ -618,19 +884,29 @@ namespace boost { namespace leaf {
 		};
 
 		template <class R, class Tup, class F>
-		LEAF_CONSTEXPR inline R handle_error_( Tup const & e_objects, error_info const & ei, F && f )
+		LEAF_CONSTEXPR inline R select_handler_( Tup const & e_objects, error_info const & ei, presence_mask, F && f )
 		{
 			static_assert( handler_matches_any_error<fn_mp_args<F>>::value, "The last handler passed to handle_all must match any error." );
 			return handler_caller<R, F>::call( e_objects, ei, std::forward<F>(f), fn_mp_args<F>{ } );
 		}
 
 		template <class R, class Tup, class CarF, class... CdrF>
-		LEAF_CONSTEXPR inline R handle_error_( Tup const & e_objects, error_info const & ei, CarF && car_f, CdrF && ... cdr_f )
+		LEAF_CONSTEXPR inline R select_handler_( Tup const & e_objects, error_info const & ei, presence_mask pm, CarF && car_f, CdrF && ... cdr_f )
 		{
-			if( handler_matches_any_error<fn_mp_args<CarF>>::value || check_handler_( e_objects, ei, fn_mp_args<CarF>{ } ) )
+			if( handler_matches_any_error<fn_mp_args<CarF>>::value || check_handler_( e_objects, ei, pm, fn_mp_args<CarF>{ } ) )
 				return handler_caller<R, CarF>::call( e_objects, ei, std::forward<CarF>(car_f), fn_mp_args<CarF>{ } );
 			else
-				return handle_error_<R>( e_objects, ei, std::forward<CdrF>(cdr_f)...);
+				return select_handler_<R>( e_objects, ei, pm, std::forward<CdrF>(cdr_f)...);
+		}
+
+		template <class R, class Tup, class... H>
+		LEAF_CONSTEXPR inline R handle_error_( Tup const & e_objects, error_info const & ei, H && ... h )
+		{
+#ifdef LEAF_HANDLER_PRESENCE_MASK
+			return select_handler_<R>( e_objects, ei, get_presence_mask(e_objects, ei.error()), std::forward<H>(h)...);
+#else
+			return select_handler_<R>( e_objects, ei, presence_mask(0), std::forward<H>(h)...);
+#endif
 		}
 	}
 
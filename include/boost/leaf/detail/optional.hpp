@@ -13,12 +13,23 @@
 
 namespace boost { namespace leaf {
 
+	namespace leaf_detail
+	{
+#ifdef LEAF_USE_64BIT_ERROR_ID
+		using id_type = long long;
+		using unsigned_id_type = unsigned long long;
+#else
+		using id_type = int;
+		using unsigned_id_type = unsigned int;
+#endif
+	}
+
 	namespace leaf_detail
 	{
 		template <class T>
 		class optional
 		{
-			int key_;
+			id_type key_;
 			union { T value_; };
 
 		public:
@@ -47,14 +58,14 @@ namespace boost { namespace leaf {
 				}
 			}
 
-			LEAF_CONSTEXPR optional( int key, T const & v ):
+			LEAF_CONSTEXPR optional( id_type key, T const & v ):
 				key_(key),
 				value_(v)
 			{
 				assert(!empty());
 			}
 
-			LEAF_CONSTEXPR optional( int key, T && v ) noexcept:
+			LEAF_CONSTEXPR optional( id_type key, T && v ) noexcept:
 				key_(key),
 				value_(std::move(v))
 			{
@@ -64,7 +75,7 @@ namespace boost { namespace leaf {
 			LEAF_CONSTEXPR optional & operator=( optional const & x )
 			{
 				reset();
-				if( int key = x.key() )
+				if( id_type key = x.key() )
 				{
 					put(key, x.value_);
 					key_ = key;
@@ -75,7 +86,7 @@ namespace boost { namespace leaf {
 			LEAF_CONSTEXPR optional & operator=( optional && x ) noexcept
 			{
 				reset();
-				if( int key = x.key() )
+				if( id_type key = x.key() )
 				{
 					put(key, std::move(x.value_));
 					x.reset();
@@ -93,12 +104,12 @@ namespace boost { namespace leaf {
 				return key_==0;
 			}
 
-			LEAF_CONSTEXPR int key() const noexcept
+			LEAF_CONSTEXPR id_type key() const noexcept
 			{
 				return key_;
 			}
 
-			LEAF_CONSTEXPR void set_key( int key ) noexcept
+			LEAF_CONSTEXPR void set_key( id_type key ) noexcept
 			{
 				assert(!empty());
 				key_ = key;
@@ -113,7 +124,7 @@ namespace boost { namespace leaf {
 				}
 			}
 
-			LEAF_CONSTEXPR T & put( int key, T const & v )
+			LEAF_CONSTEXPR T & put( id_type key, T const & v )
 			{
 				assert(key);
 				reset();
@@ -122,7 +133,7 @@ namespace boost { namespace leaf {
 				return value_;
 			}
 
-			LEAF_CONSTEXPR T & put( int key, T && v ) noexcept
+			LEAF_CONSTEXPR T & put( id_type key, T && v ) noexcept
 			{
 				assert(key);
 				reset();
@@ -131,37 +142,37 @@ namespace boost { namespace leaf {
 				return value_;
 			}
 
-			LEAF_CONSTEXPR T const * has_value(int key) const noexcept
+			LEAF_CONSTEXPR T const * has_value(id_type key) const noexcept
 			{
 				assert(key);
 				return key_==key ? &value_ : 0;
 			}
 
-			LEAF_CONSTEXPR T * has_value(int key) noexcept
+			LEAF_CONSTEXPR T * has_value(id_type key) noexcept
 			{
 				assert(key);
 				return key_==key ? &value_ : 0;
 			}
 
-			LEAF_CONSTEXPR T const & value(int key) const & noexcept
+			LEAF_CONSTEXPR T const & value(id_type key) const & noexcept
 			{
 				assert(has_value(key)!=0);
 				return value_;
 			}
 
-			LEAF_CONSTEXPR T & value(int key) & noexcept
+			LEAF_CONSTEXPR T & value(id_type key) & noexcept
 			{
 				assert(has_value(key)!=0);
 				return value_;
 			}
 
-			LEAF_CONSTEXPR T const && value(int key) const && noexcept
+			LEAF_CONSTEXPR T const && value(id_type key) const && noexcept
 			{
 				assert(has_value(key)!=0);
 				return value_;
 			}
 
-			LEAF_CONSTEXPR T value(int key) && noexcept
+			LEAF_CONSTEXPR T value(id_type key) && noexcept
 			{
 				assert(has_value(key)!=0);
 				T tmp(std::move(value_));
@@ -169,7 +180,7 @@ namespace boost { namespace leaf {
 				return tmp;
 			}
 
-			void print( std::ostream &, int key_to_print ) const;
+			void print( std::ostream &, id_type key_to_print ) const;
 		};
 
 	} // leaf_detail
@@ -11,43 +11,109 @@
 #include <exception>
 #include <ostream>
 #include <cstring>
+#include <cstdint>
 #include <cassert>
 
 namespace boost { namespace leaf {
 
-	namespace leaf_detail
+	struct type_name
 	{
-		template <int N>
-		LEAF_CONSTEXPR inline char const * check_prefix( char const * t, char const (&prefix)[N] )
+		char const * name; // Not null-terminated
+		int length;
+		std::uint64_t hash;
+
+		friend bool operator==( type_name const & a, type_name const & b ) noexcept
 		{
-			return std::strncmp(t,prefix,sizeof(prefix)-1)==0 ? t+sizeof(prefix)-1 : t;
+			return a.hash==b.hash && a.length==b.length && std::memcmp(a.name, b.name, a.length)==0;
 		}
-	}
 
-	template <class Name>
-	LEAF_CONSTEXPR inline char const * type() noexcept
+		friend bool operator!=( type_name const & a, type_name const & b ) noexcept
+		{
+			return !(a==b);
+		}
+
+		friend std::ostream & operator<<( std::ostream & os, type_name const & x )
+		{
+			return os.write(x.name, x.length);
+		}
+	};
+
+	namespace leaf_detail
 	{
-	char const * t =
+		// The functions below are written in the C++11 constexpr style, and
+		// process long strings in steps of several characters, to keep the
+		// recursion depth low.
+
+		constexpr bool starts_with( char const * s, char const * prefix, int prefix_length ) noexcept
+		{
+			return prefix_length==0 || (*s==*prefix && starts_with(s+1, prefix+1, prefix_length-1));
+		}
+
+		constexpr int find( char const * s, int length, char const * substr, int substr_length, int i=0 ) noexcept
+		{
+			return i+substr_length>length ? -1 : starts_with(s+i, substr, substr_length) ? i : find(s, length, substr, substr_length, i+1);
+		}
+
+		constexpr int rfind( char const * s, char c, int i ) noexcept
+		{
+			return i<0 ? -1 : s[i]==c ? i : rfind(s, c, i-1);
+		}
+
+		constexpr std::uint64_t fnv1a_step( std::uint64_t h, char c ) noexcept
+		{
+			return (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+		}
+
+		constexpr std::uint64_t fnv1a( char const * s, int length, std::uint64_t h = 14695981039346656037ull ) noexcept
+		{
+			return
+				length>=8 ? fnv1a(s+8, length-8, fnv1a_step(fnv1a_step(fnv1a_step(fnv1a_step(fnv1a_step(fnv1a_step(fnv1a_step(fnv1a_step(h, s[0]), s[1]), s[2]), s[3]), s[4]), s[5]), s[6]), s[7])) :
+				length>0 ? fnv1a(s+1, length-1, fnv1a_step(h, s[0])) :
+				h;
+		}
+
+		constexpr type_name make_type_name( char const * s, int begin, int end ) noexcept
+		{
+			return type_name{ s+begin, end-begin, fnv1a(s+begin, end-begin) };
+		}
+
+		// Finds the name of T in the signature of type_name_of<T>, which
+		// looks like this:
+		// gcc:   "constexpr boost::leaf::type_name boost::leaf::leaf_detail::type_name_of() [with T = NAME]"
+		// clang: "boost::leaf::type_name boost::leaf::leaf_detail::type_name_of() [T = NAME]"
+		// msvc:  "struct boost::leaf::type_name __cdecl boost::leaf::leaf_detail::type_name_of<NAME>(void)"
+		constexpr type_name parse_type_name( char const * s, int length, int prefix, int prefix_length, char terminator ) noexcept
+		{
+			return prefix<0 || rfind(s, terminator, length-1)<prefix+prefix_length ?
+				make_type_name(s, 0, length) :
+				make_type_name(s, prefix+prefix_length, rfind(s, terminator, length-1));
+		}
+
+		template <class T>
+		constexpr type_name type_name_of() noexcept
+		{
+			return
 #ifdef __FUNCSIG__
-		__FUNCSIG__;
-#else
-		__PRETTY_FUNCTION__;
-#endif
-#if defined(__clang__)
-		assert(leaf_detail::check_prefix(t,"const char *boost::leaf::type() ")==t+32);
-		return t+32;
-#elif defined(__GNUC__)
-		assert(leaf_detail::check_prefix(t,"const char* boost::leaf::type() ")==t+32);
-		return t+32;
+				parse_type_name(__FUNCSIG__, sizeof(__FUNCSIG__)-1, find(__FUNCSIG__, sizeof(__FUNCSIG__)-1, "type_name_of<", 13), 13, '>');
 #else
-		char const * clang_style = leaf_detail::check_prefix(t,"const char *boost::leaf::type() ");
-		if( clang_style!=t )
-			return clang_style;
-		char const * gcc_style = leaf_detail::check_prefix(t,"const char* boost::leaf::type() ");
-		if( gcc_style!=t )
-			return gcc_style;
+				parse_type_name(__PRETTY_FUNCTION__, sizeof(__PRETTY_FUNCTION__)-1, find(__PRETTY_FUNCTION__, sizeof(__PRETTY_FUNCTION__)-1, "T = ", 4), 4, ']');
 #endif
-		return t;
+		}
+
+		template <class T>
+		struct type_name_holder
+		{
+			static constexpr type_name value = type_name_of<T>();
+		};
+
+		template <class T>
+		constexpr type_name type_name_holder<T>::value;
+	}
+
+	template <class T>
+	constexpr type_name type() noexcept
+	{
+		return leaf_detail::type_name_holder<T>::value;
 	}
 
 	namespace leaf_detail
@@ -119,22 +185,28 @@ namespace boost { namespace leaf {
 		};
 
 		template <class T>
-		void optional<T>::print( std::ostream & os, int key_to_print ) const
+		void print_e_object( std::ostream & os, T const & value, id_type k, id_type key_to_print )
 		{
 			if( !diagnostic<T>::is_invisible )
-				if( int k = key() )
+			{
+				if( key_to_print )
 				{
-					if( key_to_print )
-					{
-						if( key_to_print!=k )
-							return;
-					}
-					else
-						os << '[' << k << ']';
-					os << type<T>() << ": ";
-					diagnostic<T>::print(os, value_);
-					os << std::endl;
+					if( key_to_print!=k )
+						return;
 				}
+				else
+					os << '[' << k << ']';
+				os << type<T>() << ": ";
+				diagnostic<T>::print(os, value);
+				os << '\n';
+			}
+		}
+
+		template <class T>
+		void optional<T>::print( std::ostream & os, id_type key_to_print ) const
+		{
+			if( id_type k = key() )
+				print_e_object(os, value_, k, key_to_print);
 		}
 	} // leaf_detail
 
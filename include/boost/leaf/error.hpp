@@ -12,14 +12,37 @@
 #include <type_traits>
 #include <sstream>
 #include <memory>
-#include <set>
+#include <typeinfo>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#ifdef LEAF_COUNT_LOADS
+#	include <vector>
+#endif
+
+#ifdef LEAF_ENABLE_STACKTRACE
+#	if defined(_WIN32)
+#		define LEAF_STACKTRACE_WINDOWS
+		// Declared here rather than by including <Windows.h>.
+		extern "C" __declspec(dllimport) unsigned short __stdcall RtlCaptureStackBackTrace( unsigned long, unsigned long, void * *, unsigned long * );
+#	elif defined(__GLIBC__) || defined(__APPLE__)
+#		include <execinfo.h>
+#		include <cxxabi.h>
+#		include <cstdlib>
+#		include <cstring>
+#		define LEAF_STACKTRACE_EXECINFO
+#	endif
+#endif
 
 #ifdef LEAF_NO_THREADS
 #	define LEAF_THREAD_LOCAL
 	namespace boost { namespace leaf {
 		namespace leaf_detail
 		{
-			using atomic_unsigned_int = unsigned int;
+			using atomic_unsigned_id = unsigned_id_type;
+			using atomic_int = int;
+			using atomic_unsigned_long = unsigned long;
 		}
 	} }
 #else
@@ -29,7 +52,9 @@
 	namespace boost { namespace leaf {
 		namespace leaf_detail
 		{
-			using atomic_unsigned_int = std::atomic<unsigned int>;
+			using atomic_unsigned_id = std::atomic<unsigned_id_type>;
+			using atomic_int = std::atomic<int>;
+			using atomic_unsigned_long = std::atomic<unsigned long>;
 		}
 	} }
 #endif
@@ -98,6 +123,215 @@ namespace boost { namespace leaf {
 
 	////////////////////////////////////////
 
+	// Records the source locations an error passes through, in a ring buffer
+	// stored in the object itself, so that adding a record never allocates.
+	// Once LEAF_ERROR_TRACE_CAPACITY records are stored, each new record
+	// overwrites the oldest one.
+	class e_error_trace
+	{
+	public:
+
+		struct record
+		{
+			char const * file;
+			int line;
+			char const * function;
+		};
+
+	private:
+
+		record rec_[LEAF_ERROR_TRACE_CAPACITY];
+		unsigned count_;
+
+		// Only the first size() elements of rec_ are initialized.
+		void copy_from( e_error_trace const & x ) noexcept
+		{
+			count_ = x.count_;
+			for( int i=0, n=size(); i!=n; ++i )
+				rec_[i] = x.rec_[i];
+		}
+
+	public:
+
+		e_error_trace() noexcept:
+			count_(0)
+		{
+		}
+
+		e_error_trace( e_error_trace const & x ) noexcept
+		{
+			copy_from(x);
+		}
+
+		e_error_trace & operator=( e_error_trace const & x ) noexcept
+		{
+			if( this!=&x )
+				copy_from(x);
+			return *this;
+		}
+
+		constexpr static int capacity() noexcept
+		{
+			return LEAF_ERROR_TRACE_CAPACITY;
+		}
+
+		int size() const noexcept
+		{
+			return count_<unsigned(capacity()) ? int(count_) : capacity();
+		}
+
+		unsigned dropped() const noexcept
+		{
+			return count_ - unsigned(size());
+		}
+
+		record const & operator[]( int i ) const noexcept
+		{
+			assert(i>=0 && i<size());
+			return rec_[count_<unsigned(capacity()) ? i : (count_+unsigned(i)) % unsigned(capacity())];
+		}
+
+		void push( char const * file, int line, char const * function ) noexcept
+		{
+			record & r = rec_[count_ % unsigned(capacity())];
+			r.file = file;
+			r.line = line;
+			r.function = function;
+			++count_;
+		}
+
+		friend std::ostream & operator<<( std::ostream & os, e_error_trace const & x )
+		{
+			os << leaf::type<e_error_trace>() << ':';
+			if( unsigned d = x.dropped() )
+				os << " (" << d << " oldest records dropped)";
+			for( int i=0; i!=x.size(); ++i )
+				os << "\n\t" << x[i].file << '(' << x[i].line << ") in function " << x[i].function;
+			return os;
+		}
+	};
+
+	template <>
+	struct is_e_type<e_error_trace>: std::true_type
+	{
+	};
+
+	////////////////////////////////////////
+
+#ifdef LEAF_ENABLE_STACKTRACE
+
+	namespace leaf_detail
+	{
+#ifdef LEAF_STACKTRACE_EXECINFO
+		inline void print_stacktrace_frame( std::ostream & os, char const * sym )
+		{
+			// glibc formats symbols as "module(mangled+offset) [address]".
+			char const * b = std::strchr(sym, '(');
+			char const * e = b ? std::strchr(b, '+') : 0;
+			if( b && e && e>b+1 )
+			{
+				std::string mangled(b+1, e);
+				int status = 0;
+				if( char * demangled = abi::__cxa_demangle(mangled.c_str(), 0, 0, &status) )
+				{
+					os.write(sym, b+1-sym) << demangled << (e);
+					std::free(demangled);
+					return;
+				}
+			}
+			os << sym;
+		}
+
+		inline void print_stacktrace( std::ostream & os, void * const * frames, int size )
+		{
+			if( char * * syms = ::backtrace_symbols(frames, size) )
+			{
+				for( int i=0; i!=size; ++i )
+				{
+					os << "\n\t#" << i << ' ';
+					print_stacktrace_frame(os, syms[i]);
+				}
+				std::free(syms);
+			}
+			else
+				for( int i=0; i!=size; ++i )
+					os << "\n\t#" << i << ' ' << frames[i];
+		}
+#else
+		inline void print_stacktrace( std::ostream & os, void * const * frames, int size )
+		{
+			for( int i=0; i!=size; ++i )
+				os << "\n\t#" << i << ' ' << frames[i];
+		}
+#endif
+	} // leaf_detail
+
+	// Stores the return addresses of the calling thread's stack, without
+	// symbolizing them; symbols are only looked up when the object is
+	// printed. new_error captures an e_stacktrace automatically, but only
+	// if an active context provides storage for it. Available only if
+	// LEAF_ENABLE_STACKTRACE is defined.
+	class e_stacktrace
+	{
+		void * frames_[LEAF_STACKTRACE_MAX_FRAMES];
+		int size_;
+
+	public:
+
+		e_stacktrace() noexcept:
+			size_(0)
+		{
+		}
+
+		constexpr static int capacity() noexcept
+		{
+			return LEAF_STACKTRACE_MAX_FRAMES;
+		}
+
+		int size() const noexcept
+		{
+			return size_;
+		}
+
+		void * operator[]( int i ) const noexcept
+		{
+			assert(i>=0 && i<size_);
+			return frames_[i];
+		}
+
+		// Captures the stack of the calling function (the frame of capture
+		// itself is not included).
+		LEAF_NOINLINE void capture() noexcept
+		{
+#if defined(LEAF_STACKTRACE_EXECINFO)
+			void * frames[LEAF_STACKTRACE_MAX_FRAMES+1];
+			int n = ::backtrace(frames, LEAF_STACKTRACE_MAX_FRAMES+1);
+			size_ = n>1 ? n-1 : 0;
+			std::memcpy(frames_, frames+1, size_*sizeof(void *));
+#elif defined(LEAF_STACKTRACE_WINDOWS)
+			size_ = ::RtlCaptureStackBackTrace(1, LEAF_STACKTRACE_MAX_FRAMES, frames_, 0);
+#else
+			size_ = 0;
+#endif
+		}
+
+		friend std::ostream & operator<<( std::ostream & os, e_stacktrace const & x )
+		{
+			os << leaf::type<e_stacktrace>() << ": " << x.size_ << " frames";
+			leaf_detail::print_stacktrace(os, x.frames_, x.size_);
+			return os;
+		}
+	};
+
+	template <>
+	struct is_e_type<e_stacktrace>: std::true_type
+	{
+	};
+
+#endif
+
+	////////////////////////////////////////
+
 #if LEAF_DIAGNOSTICS
 
 	namespace leaf_detail
@@ -106,10 +340,10 @@ namespace boost { namespace leaf {
 		{
 		public:
 
-			char const * (*first_type)();
+			type_name first_type;
 			int count;
 
-			LEAF_CONSTEXPR explicit e_unexpected_count( char const * (*first_type)() ) noexcept:
+			LEAF_CONSTEXPR explicit e_unexpected_count( type_name first_type ) noexcept:
 				first_type(first_type),
 				count(1)
 			{
@@ -117,14 +351,13 @@ namespace boost { namespace leaf {
 
 			void print( std::ostream & os ) const
 			{
-				assert(first_type!=0);
 				assert(count>0);
 				os << "Detected ";
 				if( count==1 )
 					os << "1 attempt to communicate an unexpected error object";
 				else
 					os << count << " attempts to communicate unexpected error objects, the first one";
-				os << " of type " << first_type() << std::endl;
+				os << " of type " << first_type << '\n';
 			}
 		};
 
@@ -142,41 +375,186 @@ namespace boost { namespace leaf {
 			}
 		};
 
+		// Stores the first E-object of each E-type which was not expected by any
+		// active context, so that it can be printed by verbose_diagnostic_info.
+		// The objects are copied (or moved) into a fixed-size buffer, type-erased,
+		// and only formatted when printed. Objects which do not fit, and objects
+		// which can't be copied (or moved) without throwing, for example an
+		// lvalue holding a std::string, are only counted. A slot<e_unexpected_info>
+		// keeps the buffer out of line (see is_stored_out_of_line), so moving it
+		// between nested contexts transfers a pointer.
 		class e_unexpected_info
 		{
-			std::string s_;
-			std::set<char const *(*)()> already_;
+			e_unexpected_info( e_unexpected_info const & ) = delete;
+			e_unexpected_info & operator=( e_unexpected_info const & ) = delete;
+
+			struct entry_type
+			{
+				type_name type;
+				void (*print)( std::ostream &, void const * );
+				void (*move)( void * to, void * from ) noexcept;
+				void (*destroy)( void * ) noexcept;
+			};
+
+			template <class E>
+			struct entry_type_of
+			{
+				static void print( std::ostream & os, void const * p )
+				{
+					diagnostic<E>::print(os, *static_cast<E const *>(p));
+				}
+
+				static void move( void * to, void * from ) noexcept
+				{
+					(void) new (to) E(std::move(*static_cast<E *>(from)));
+				}
+
+				static void destroy( void * p ) noexcept
+				{
+					static_cast<E *>(p)->~E();
+				}
+
+				static entry_type const & get() noexcept
+				{
+					static entry_type const et = { type<E>(), &print, &move, &destroy };
+					return et;
+				}
+			};
+
+			struct header
+			{
+				entry_type const * et;
+				std::size_t obj;
+				std::size_t end;
+			};
+
+			static LEAF_CONSTEXPR std::size_t align( std::size_t n, std::size_t a ) noexcept
+			{
+				return (n + a - 1) & ~(a - 1);
+			}
+
+			alignas(std::max_align_t) unsigned char buf_[LEAF_UNEXPECTED_INFO_BUFFER_SIZE];
+			std::size_t size_;
+			int dropped_;
+
+			header & header_at( std::size_t i ) noexcept
+			{
+				return *reinterpret_cast<header *>(buf_ + i);
+			}
+
+			header const & header_at( std::size_t i ) const noexcept
+			{
+				return *reinterpret_cast<header const *>(buf_ + i);
+			}
+
+			void move_from( e_unexpected_info & x ) noexcept
+			{
+				assert(size_==0);
+				for( std::size_t i=0; i<x.size_; i=align(x.header_at(i).end, alignof(header)) )
+				{
+					header const & h = *new (buf_ + i) header(x.header_at(i));
+					h.et->move(buf_ + h.obj, x.buf_ + h.obj);
+				}
+				size_ = x.size_;
+				dropped_ = x.dropped_;
+				x.reset();
+			}
+
+			template <class T, class E>
+			void add_impl( E && e, std::true_type ) noexcept
+			{
+				for( std::size_t i=0; i<size_; i=align(header_at(i).end, alignof(header)) )
+					if( header_at(i).et->type==type<T>() )
+						return;
+				std::size_t const h = align(size_, alignof(header));
+				std::size_t const obj = align(h + sizeof(header), alignof(T));
+				std::size_t const end = obj + sizeof(T);
+				if( end>sizeof(buf_) )
+				{
+					++dropped_;
+					return;
+				}
+				(void) new (buf_ + obj) T(std::forward<E>(e));
+				header & hd = *new (buf_ + h) header;
+				hd.et = &entry_type_of<T>::get();
+				hd.obj = obj;
+				hd.end = end;
+				size_ = end;
+			}
+
+			template <class T, class E>
+			void add_impl( E &&, std::false_type ) noexcept
+			{
+				if( !diagnostic<T>::is_invisible )
+					++dropped_;
+			}
 
 		public:
 
-			e_unexpected_info() noexcept
+			e_unexpected_info() noexcept:
+				size_(0),
+				dropped_(0)
 			{
 			}
 
-			void reset() noexcept
+			e_unexpected_info( e_unexpected_info && x ) noexcept:
+				size_(0),
+				dropped_(0)
 			{
-				s_.clear();
-				already_.clear();
+				move_from(x);
 			}
 
-			template <class E>
-			void add( E const & e )
+			e_unexpected_info & operator=( e_unexpected_info && x ) noexcept
 			{
-				std::stringstream s;
-				if( !leaf_detail::diagnostic<E>::is_invisible )
+				if( this!=&x )
 				{
-					leaf_detail::diagnostic<E>::print(s,e);
-					if( already_.insert(&type<E>).second  )
-					{
-						s << std::endl;
-						s_ += s.str();
-					}
+					reset();
+					move_from(x);
 				}
+				return *this;
+			}
+
+			~e_unexpected_info() noexcept
+			{
+				reset();
+			}
+
+			void reset() noexcept
+			{
+				for( std::size_t i=0; i<size_; i=align(header_at(i).end, alignof(header)) )
+				{
+					header const & h = header_at(i);
+					h.et->destroy(buf_ + h.obj);
+				}
+				size_ = 0;
+				dropped_ = 0;
+			}
+
+			// Copies lvalues and moves rvalues; objects that can't be copied (or
+			// moved) without throwing are only counted.
+			template <class E>
+			void add( E && e ) noexcept
+			{
+				using T = typename std::decay<E>::type;
+				add_impl<T>(std::forward<E>(e), std::integral_constant<bool,
+					!diagnostic<T>::is_invisible &&
+					std::is_nothrow_constructible<T, E &&>::value &&
+					std::is_nothrow_move_constructible<T>::value &&
+					alignof(T)<=alignof(std::max_align_t) &&
+					sizeof(header)+sizeof(T)<=LEAF_UNEXPECTED_INFO_BUFFER_SIZE>());
 			}
 
 			void print( std::ostream & os ) const
 			{
-				os << "Unexpected error objects:\n" << s_;
+				os << "Unexpected error objects:\n";
+				for( std::size_t i=0; i<size_; i=align(header_at(i).end, alignof(header)) )
+				{
+					header const & h = header_at(i);
+					h.et->print(os, buf_ + h.obj);
+					os << '\n';
+				}
+				if( dropped_ )
+					os << "(" << dropped_ << " more not captured: too large for LEAF_UNEXPECTED_INFO_BUFFER_SIZE, or not nothrow copyable)" << '\n';
 			}
 		};
 
@@ -199,133 +577,692 @@ namespace boost { namespace leaf {
 			static LEAF_THREAD_LOCAL int c;
 			return c;
 		}
+
+#if LEAF_DIAGNOSTICS==2
+
+		template <class=void>
+		struct diagnostics_config
+		{
+			static atomic_int enabled;
+			static atomic_int sample_rate;
+		};
+
+		template <class T>
+		atomic_int diagnostics_config<T>::enabled(1);
+
+		template <class T>
+		atomic_int diagnostics_config<T>::sample_rate(1);
+
+		// Called when a context that can produce diagnostic_info or
+		// verbose_diagnostic_info is activated, to decide whether that context
+		// collects diagnostic information. Sampling uses a per-thread countdown,
+		// so that the only data shared between threads is read-only.
+		inline bool sample_diagnostics() noexcept
+		{
+			if( !diagnostics_config<>::enabled )
+				return false;
+			int n = diagnostics_config<>::sample_rate;
+			if( n<=1 )
+				return true;
+			static LEAF_THREAD_LOCAL int countdown;
+			if( countdown>0 )
+			{
+				--countdown;
+				return false;
+			}
+			countdown = n-1;
+			return true;
+		}
+
+#endif
 	}
 
 #endif
 
-	////////////////////////////////////////
-
-	namespace leaf_detail
-	{
+	////////////////////////////////////////
+
+	namespace leaf_detail
+	{
+		template <class E>
+		class slot;
+
+#ifdef LEAF_USE_TLS_ARRAY
+
+		// All slot head pointers live in a single thread-local array, so that
+		// activating a context or loading E-objects accesses one TLS variable
+		// regardless of the number of E-types involved: the address of the
+		// array is obtained once and passed down as a tl_slot_table. Each
+		// E-type is assigned an index into the array the first time it is used.
+
+		template <class=void>
+		struct tls_slot_array
+		{
+			static LEAF_THREAD_LOCAL void * ptr[LEAF_TLS_ARRAY_SIZE];
+			static atomic_int next_index;
+		};
+
+		template <class T>
+		LEAF_THREAD_LOCAL void * tls_slot_array<T>::ptr[LEAF_TLS_ARRAY_SIZE];
+
+		template <class T>
+		atomic_int tls_slot_array<T>::next_index(0);
+
+		using tl_slot_table = void * *;
+
+		inline tl_slot_table get_tl_slot_table() noexcept
+		{
+			return tls_slot_array<>::ptr;
+		}
+
+		template <class E>
+		inline int tls_slot_index() noexcept
+		{
+			static int const index = tls_slot_array<>::next_index++;
+			return index;
+		}
+
+		template <class E>
+		inline void * & tl_slot_overflow() noexcept
+		{
+			static LEAF_THREAD_LOCAL void * s;
+			return s;
+		}
+
+		template <class E>
+		inline void * & tl_slot_head( tl_slot_table table ) noexcept
+		{
+			int const index = tls_slot_index<E>();
+			if( index < LEAF_TLS_ARRAY_SIZE )
+				return table[index];
+			else
+				return tl_slot_overflow<E>(); // The array is full, use a TLS variable for this E-type.
+		}
+
+#else
+
+		struct tl_slot_table { };
+
+		LEAF_CONSTEXPR inline tl_slot_table get_tl_slot_table() noexcept
+		{
+			return tl_slot_table();
+		}
+
+		template <class E>
+		inline slot<E> * & tl_slot_head( tl_slot_table ) noexcept
+		{
+			static LEAF_THREAD_LOCAL slot<E> * s;
+			return s;
+		}
+
+#endif
+
+		template <class E>
+		inline slot<E> * tl_slot_ptr( tl_slot_table table = get_tl_slot_table() ) noexcept
+		{
+			return static_cast<slot<E> *>(tl_slot_head<E>(table));
+		}
+
+		// A per-thread cache of memory blocks of size S, used by heap_optional.
+		template <std::size_t S>
+		class heap_block_cache
+		{
+			heap_block_cache( heap_block_cache const & ) = delete;
+			heap_block_cache & operator=( heap_block_cache const & ) = delete;
+
+			struct block
+			{
+				block * next;
+			};
+
+			enum { max_cached = 8 };
+
+			block * free_;
+			int cached_;
+
+			heap_block_cache() noexcept:
+				free_(0),
+				cached_(0)
+			{
+			}
+
+			~heap_block_cache() noexcept
+			{
+				while( block * b = free_ )
+				{
+					free_ = b->next;
+					::operator delete(b);
+				}
+				tl_destroyed() = true;
+			}
+
+			// Set when the calling thread's cache is destroyed, so that blocks
+			// released after that (e.g. by a thread_local context) do not
+			// touch it.
+			static bool & tl_destroyed() noexcept
+			{
+				static LEAF_THREAD_LOCAL bool d;
+				return d;
+			}
+
+			static heap_block_cache & tl_instance() noexcept
+			{
+				static LEAF_THREAD_LOCAL heap_block_cache c;
+				return c;
+			}
+
+		public:
+
+			// Returns 0 if out of memory.
+			static void * allocate() noexcept
+			{
+				if( !tl_destroyed() )
+				{
+					heap_block_cache & c = tl_instance();
+					if( block * b = c.free_ )
+					{
+						c.free_ = b->next;
+						--c.cached_;
+						return b;
+					}
+				}
+				return ::operator new(S<sizeof(block) ? sizeof(block) : S, std::nothrow);
+			}
+
+			static void deallocate( void * p ) noexcept
+			{
+				assert(p!=0);
+				if( !tl_destroyed() )
+				{
+					heap_block_cache & c = tl_instance();
+					if( c.cached_<max_cached )
+					{
+						block * b = static_cast<block *>(p);
+						b->next = c.free_;
+						c.free_ = b;
+						++c.cached_;
+						return;
+					}
+				}
+				::operator delete(p);
+			}
+		};
+
+		// Like optional<T>, but the T object is stored out of line. The memory is
+		// obtained from the per-thread heap_block_cache the first time a value is
+		// put, and is retained until the heap_optional is destroyed. Moving a
+		// heap_optional transfers the pointer instead of moving the T object.
+		// If the memory can't be allocated, put does not store the value and
+		// returns 0.
+		template <class T>
+		class heap_optional
+		{
+			heap_optional( heap_optional const & ) = delete;
+			heap_optional & operator=( heap_optional const & ) = delete;
+
+			id_type key_;
+			T * value_;
+
+			T * storage() noexcept
+			{
+				if( !value_ )
+					value_ = static_cast<T *>(heap_block_cache<sizeof(T)>::allocate());
+				return value_;
+			}
+
+			void release_storage() noexcept
+			{
+				if( value_ )
+				{
+					heap_block_cache<sizeof(T)>::deallocate(value_);
+					value_ = 0;
+				}
+			}
+
+		public:
+
+			typedef T value_type;
+
+			LEAF_CONSTEXPR heap_optional() noexcept:
+				key_(0),
+				value_(0)
+			{
+			}
+
+			LEAF_CONSTEXPR heap_optional( heap_optional && x ) noexcept:
+				key_(x.key_),
+				value_(x.value_)
+			{
+				x.key_ = 0;
+				x.value_ = 0;
+			}
+
+			LEAF_CONSTEXPR heap_optional & operator=( heap_optional && x ) noexcept
+			{
+				reset();
+				release_storage();
+				key_ = x.key_;
+				value_ = x.value_;
+				x.key_ = 0;
+				x.value_ = 0;
+				return *this;
+			}
+
+			~heap_optional() noexcept
+			{
+				reset();
+				release_storage();
+			}
+
+			LEAF_CONSTEXPR bool empty() const noexcept
+			{
+				return key_==0;
+			}
+
+			LEAF_CONSTEXPR id_type key() const noexcept
+			{
+				return key_;
+			}
+
+			LEAF_CONSTEXPR void set_key( id_type key ) noexcept
+			{
+				assert(!empty());
+				key_ = key;
+			}
+
+			LEAF_CONSTEXPR void reset() noexcept
+			{
+				if( key_ )
+				{
+					value_->~T();
+					key_=0;
+				}
+			}
+
+			LEAF_CONSTEXPR T * put( id_type key, T const & v )
+			{
+				assert(key);
+				reset();
+				if( T * p = storage() )
+				{
+					(void) new(p) T(v);
+					key_=key;
+					return p;
+				}
+				return 0;
+			}
+
+			LEAF_CONSTEXPR T * put( id_type key, T && v ) noexcept
+			{
+				assert(key);
+				reset();
+				if( T * p = storage() )
+				{
+					(void) new(p) T(std::move(v));
+					key_=key;
+					return p;
+				}
+				return 0;
+			}
+
+			LEAF_CONSTEXPR T const * has_value(id_type key) const noexcept
+			{
+				assert(key);
+				return key_==key ? value_ : 0;
+			}
+
+			LEAF_CONSTEXPR T * has_value(id_type key) noexcept
+			{
+				assert(key);
+				return key_==key ? value_ : 0;
+			}
+
+			LEAF_CONSTEXPR T const & value(id_type key) const & noexcept
+			{
+				assert(has_value(key)!=0);
+				return *value_;
+			}
+
+			LEAF_CONSTEXPR T & value(id_type key) & noexcept
+			{
+				assert(has_value(key)!=0);
+				return *value_;
+			}
+
+			LEAF_CONSTEXPR T const && value(id_type key) const && noexcept
+			{
+				assert(has_value(key)!=0);
+				return std::move(*value_);
+			}
+
+			LEAF_CONSTEXPR T value(id_type key) && noexcept
+			{
+				assert(has_value(key)!=0);
+				T tmp(std::move(*value_));
+				reset();
+				return tmp;
+			}
+
+			void print( std::ostream & os, id_type key_to_print ) const
+			{
+				if( id_type k = key() )
+					print_e_object(os, *value_, k, key_to_print);
+			}
+		};
+
+		// E-objects larger than LEAF_SLOT_HEAP_THRESHOLD bytes (if non-zero) are
+		// stored out of line, so that a context does not reserve stack space for
+		// them and propagating them between nested contexts does not copy them.
+		template <class E>
+		struct is_stored_out_of_line: std::integral_constant<bool,
+			LEAF_SLOT_HEAP_THRESHOLD!=0 &&
+			(sizeof(E) > LEAF_SLOT_HEAP_THRESHOLD) &&
+			alignof(E) <= alignof(std::max_align_t)>
+		{
+		};
+
+#if LEAF_DIAGNOSTICS
+		// e_unexpected_info holds a LEAF_UNEXPECTED_INFO_BUFFER_SIZE buffer, and
+		// is only ever stored when an error is not handled as expected.
+		template <>
+		struct is_stored_out_of_line<e_unexpected_info>: std::true_type
+		{
+		};
+#endif
+
+		template <class E>
+		using slot_storage = typename std::conditional<
+			is_stored_out_of_line<E>::value,
+			heap_optional<E>,
+			optional<E>>::type;
+
+		// Each context keeps a dirty_mask with one bit per slot, which the slot
+		// sets whenever an E-object is stored in it (see slot<E>::bind_owner).
+		// A clear bit means that the slot is empty. Slots past the width of
+		// the mask share its last bit.
+		typedef std::uint64_t dirty_mask;
+
+		LEAF_CONSTEXPR inline dirty_mask dirty_bit( int i ) noexcept
+		{
+			return dirty_mask(1) << (i<64 ? i : 63);
+		}
+
+		template <class E>
+		class slot:
+			slot_storage<E>
+		{
+			slot( slot const & ) = delete;
+			slot & operator=( slot const & ) = delete;
+
+			typedef slot_storage<E> impl;
+
+			LEAF_CONSTEXPR static E * stored( E & e ) noexcept { return &e; }
+			LEAF_CONSTEXPR static E * stored( E * e ) noexcept { return e; }
+
+			typename std::remove_reference<decltype(tl_slot_head<E>(tl_slot_table()))>::type * top_;
+			slot<E> * prev_;
+			dirty_mask * owner_mask_;
+			dirty_mask owner_bit_;
+			static_assert(is_e_type<E>::value,"Not an error type");
+
+		public:
+
+			LEAF_CONSTEXPR slot() noexcept:
+				top_(0),
+				owner_mask_(0),
+				owner_bit_(0)
+			{
+			}
+
+			LEAF_CONSTEXPR slot( slot && x ) noexcept:
+				impl(std::move(x)),
+				top_(0),
+				owner_mask_(0),
+				owner_bit_(0)
+			{
+				assert(x.top_==0);
+			}
+
+			~slot() noexcept
+			{
+				assert(top_==0);
+			}
+
+			LEAF_CONSTEXPR void activate( tl_slot_table table = get_tl_slot_table() ) noexcept
+			{
+				assert(top_==0);
+				top_ = &tl_slot_head<E>(table);
+				prev_ = static_cast<slot<E> *>(*top_);
+				*top_ = this;
+			}
+
+			// Called by the context that owns the slot, whenever the slot is
+			// constructed or moved.
+			LEAF_CONSTEXPR void bind_owner( dirty_mask * mask, dirty_mask bit ) noexcept
+			{
+				assert(mask!=0);
+				owner_mask_ = mask;
+				owner_bit_ = bit;
+			}
+
+			LEAF_CONSTEXPR bool deactivate( bool propagate_errors ) noexcept;
+
+			// Returns 0 if the E-object could not be stored (only possible
+			// with heap_optional storage, if out of memory).
+			template <class T>
+			LEAF_CONSTEXPR E * put( id_type key, T && v ) noexcept(noexcept(std::declval<impl &>().put(key, std::forward<T>(v))))
+			{
+				assert(owner_mask_!=0);
+				*owner_mask_ |= owner_bit_;
+				return stored(impl::put(key, std::forward<T>(v)));
+			}
+
+			using impl::has_value;
+			using impl::key;
+			using impl::value;
+			using impl::print;
+		};
+
+#if LEAF_DIAGNOSTICS
+
+		template <class E>
+		LEAF_CONSTEXPR inline void load_unexpected_count( id_type err_id ) noexcept
+		{
+			if( slot<e_unexpected_count> * sl = tl_slot_ptr<e_unexpected_count>() )
+				if( e_unexpected_count * unx = sl->has_value(err_id) )
+					++unx->count;
+				else
+					sl->put(err_id, e_unexpected_count(type<E>()));
+		}
+
+		template <class E>
+		LEAF_CONSTEXPR inline void load_unexpected_info( id_type err_id, E && e ) noexcept
+		{
+			if( slot<e_unexpected_info> * sl = tl_slot_ptr<e_unexpected_info>() )
+				if( e_unexpected_info * unx = sl->has_value(err_id) )
+					unx->add(std::forward<E>(e));
+				else if( e_unexpected_info * unx = sl->put(err_id, e_unexpected_info()) )
+					unx->add(std::forward<E>(e));
+		}
+
+		template <class E>
+		LEAF_CONSTEXPR inline void load_unexpected( id_type err_id, E && e  ) noexcept
+		{
+			load_unexpected_count<E>(err_id);
+			load_unexpected_info(err_id, std::forward<E>(e));
+		}
+
+#endif
+
+		// Returns true if the slot still holds an E-object after propagating
+		// (there is no previous slot to move it to).
+		template <class E>
+		LEAF_CONSTEXPR inline bool slot<E>::deactivate( bool propagate_errors ) noexcept
+		{
+			assert(top_!=0);
+			bool holds_value = false;
+			if( propagate_errors )
+				if( id_type err_id = impl::key() )
+				{
+					if( prev_ )
+					{
+						*prev_->owner_mask_ |= prev_->owner_bit_;
+						impl & this_ = *this;
+						impl & that_ = *prev_;
+						that_ = std::move(this_);
+					}
+					else
+					{
+#if LEAF_DIAGNOSTICS
+						int c = tl_unexpected_enabled_counter();
+						assert(c>=0);
+						if( c )
+							load_unexpected(err_id, std::move(*this).value(err_id));
+						else
+#endif
+							holds_value = true;
+					}
+				}
+			*top_ = prev_;
+			top_ = 0;
+			return holds_value;
+		}
+
+#ifdef LEAF_COUNT_LOADS
+
+		// Each E-type that is ever loaded gets a load_counters object, which
+		// registers itself (once, on first use) in a global list so that
+		// get_load_counts can enumerate all E-types.
+		struct load_counters
+		{
+			load_counters( load_counters const & ) = delete;
+			load_counters & operator=( load_counters const & ) = delete;
+
+			type_name const type;
+			atomic_unsigned_long kept;
+			atomic_unsigned_long discarded;
+			atomic_unsigned_long unexpected;
+			load_counters * next;
+
+			explicit load_counters( type_name type ) noexcept;
+		};
+
+		template <class=void>
+		struct load_counters_list
+		{
+#ifdef LEAF_NO_THREADS
+			static load_counters * head;
+#else
+			static std::atomic<load_counters *> head;
+#endif
+		};
+
+#ifdef LEAF_NO_THREADS
+		template <class T>
+		load_counters * load_counters_list<T>::head(0);
+#else
+		template <class T>
+		std::atomic<load_counters *> load_counters_list<T>::head(0);
+#endif
+
+		inline load_counters::load_counters( type_name type ) noexcept:
+			type(type),
+			kept(0),
+			discarded(0),
+			unexpected(0),
+			next(load_counters_list<>::head)
+		{
+#ifdef LEAF_NO_THREADS
+			load_counters_list<>::head = this;
+#else
+			while( !load_counters_list<>::head.compare_exchange_weak(next, this) )
+			{
+			}
+#endif
+		}
+
+		template <class E>
+		inline load_counters & load_counters_of() noexcept
+		{
+			static load_counters c(type<E>());
+			return c;
+		}
+
+		inline void count_load( atomic_unsigned_long & n ) noexcept
+		{
+#ifdef LEAF_NO_THREADS
+			++n;
+#else
+			n.fetch_add(1, std::memory_order_relaxed);
+#endif
+		}
+
 		template <class E>
-		class slot;
+		inline void count_load_kept() noexcept
+		{
+			count_load(load_counters_of<E>().kept);
+		}
 
 		template <class E>
-		inline slot<E> * & tl_slot_ptr() noexcept
+		inline void count_load_discarded() noexcept
 		{
-			static LEAF_THREAD_LOCAL slot<E> * s;
-			return s;
+			count_load(load_counters_of<E>().discarded);
 		}
 
+		// Counts an E-object loaded while no slot for E is active: it is
+		// either recorded as unexpected, or discarded.
 		template <class E>
-		class slot:
-			optional<E>
+		inline void count_load_missed() noexcept
 		{
-			slot( slot const & ) = delete;
-			slot & operator=( slot const & ) = delete;
-
-			typedef optional<E> impl;
-			slot<E> * * top_;
-			slot<E> * prev_;
-			static_assert(is_e_type<E>::value,"Not an error type");
-
-		public:
-
-			LEAF_CONSTEXPR slot() noexcept:
-				top_(0)
-			{
-			}
-
-			LEAF_CONSTEXPR slot( slot && x ) noexcept:
-				optional<E>(std::move(x)),
-				top_(0)
-			{
-				assert(x.top_==0);
-			}
-
-			~slot() noexcept
-			{
-				assert(top_==0);
-			}
-
-			LEAF_CONSTEXPR void activate() noexcept
+			load_counters & c = load_counters_of<E>();
+#if LEAF_DIAGNOSTICS
+			if( tl_unexpected_enabled_counter() )
 			{
-				assert(top_==0);
-				top_ = &tl_slot_ptr<E>();
-				prev_ = *top_;
-				*top_ = this;
+				count_load(c.unexpected);
+				return;
 			}
+#endif
+			count_load(c.discarded);
+		}
 
-			LEAF_CONSTEXPR void deactivate( bool propagate_errors ) noexcept;
-
-			using impl::put;
-			using impl::has_value;
-			using impl::value;
-			using impl::print;
-		};
+		template <class E>
+		inline void count_load( tl_slot_table table ) noexcept
+		{
+			if( tl_slot_ptr<E>(table) )
+				count_load_kept<E>();
+			else
+				count_load_missed<E>();
+		}
 
-#if LEAF_DIAGNOSTICS
+#else
 
 		template <class E>
-		LEAF_CONSTEXPR inline void load_unexpected_count( int err_id ) noexcept
+		LEAF_CONSTEXPR inline void count_load_kept() noexcept
 		{
-			if( slot<e_unexpected_count> * sl = tl_slot_ptr<e_unexpected_count>() )
-				if( e_unexpected_count * unx = sl->has_value(err_id) )
-					++unx->count;
-				else
-					sl->put(err_id, e_unexpected_count(&type<E>));
 		}
 
 		template <class E>
-		LEAF_CONSTEXPR inline void load_unexpected_info( int err_id, E && e ) noexcept
+		LEAF_CONSTEXPR inline void count_load_discarded() noexcept
 		{
-			if( slot<e_unexpected_info> * sl = tl_slot_ptr<e_unexpected_info>() )
-				if( e_unexpected_info * unx = sl->has_value(err_id) )
-					unx->add(e);
-				else
-					sl->put(err_id, e_unexpected_info()).add(e);
 		}
 
 		template <class E>
-		LEAF_CONSTEXPR inline void load_unexpected( int err_id, E && e  ) noexcept
+		LEAF_CONSTEXPR inline void count_load_missed() noexcept
 		{
-			load_unexpected_count<E>(err_id);
-			load_unexpected_info(err_id, std::move(e));
 		}
 
-#endif
-
 		template <class E>
-		LEAF_CONSTEXPR inline void slot<E>::deactivate( bool propagate_errors ) noexcept
+		LEAF_CONSTEXPR inline void count_load( tl_slot_table ) noexcept
 		{
-			assert(top_!=0);
-			if( propagate_errors )
-				if( prev_ )
-				{
-					impl & this_ = *this;
-					impl & that_ = *prev_;
-					that_ = std::move(this_);
-				}
-#if LEAF_DIAGNOSTICS
-				else
-				{
-					int c = tl_unexpected_enabled_counter();
-					assert(c>=0);
-					if( c )
-						if( int err_id = impl::key() )
-							load_unexpected(err_id, std::move(*this).value(err_id));
-				}
-#endif
-			*top_ = prev_;
-			top_ = 0;
 		}
 
+#endif
+
 		template <class E>
-		LEAF_CONSTEXPR inline int load_slot( int err_id, E && e ) noexcept
+		LEAF_CONSTEXPR inline int load_slot( id_type err_id, E && e, tl_slot_table table = get_tl_slot_table() ) noexcept
 		{
 			using T = typename std::decay<E>::type;
 			assert((err_id&3)==1);
-			if( slot<T> * p = tl_slot_ptr<T>() )
+			if( slot<T> * p = tl_slot_ptr<T>(table) )
 				(void) p->put(err_id, std::forward<E>(e));
 #if LEAF_DIAGNOSTICS
 			else
@@ -339,18 +1276,93 @@ namespace boost { namespace leaf {
 			return 0;
 		}
 
+		// A nullary function returning an E-type may be passed to load (or
+		// new_error) instead of an E-object. It is called only if a slot for
+		// the returned E-type is active (or if the E-object will be reported
+		// as unexpected), so that E-objects which would be discarded are not
+		// created at all.
+		template <class F, bool = function_traits<F>::arity==0 && !is_e_type<F>::value>
+		struct is_deferred_e: std::false_type
+		{
+		};
+
+		template <class F>
+		struct is_deferred_e<F, true>: is_e_type<typename std::decay<fn_return_type<F>>::type>
+		{
+		};
+
+		template <class E, bool = is_deferred_e<typename std::decay<E>::type>::value>
+		struct load_item
+		{
+			LEAF_CONSTEXPR static int load( id_type err_id, E && e, tl_slot_table table ) noexcept
+			{
+				count_load<typename std::decay<E>::type>(table);
+				return load_slot(err_id, std::forward<E>(e), table);
+			}
+		};
+
+		template <class F>
+		struct load_item<F, true>
+		{
+			LEAF_CONSTEXPR static int load( id_type err_id, F && f, tl_slot_table table ) noexcept
+			{
+				using E = typename std::decay<fn_return_type<F>>::type;
+				assert((err_id&3)==1);
+				count_load<E>(table);
+				if( slot<E> * p = tl_slot_ptr<E>(table) )
+					(void) p->put(err_id, std::forward<F>(f)());
+#if LEAF_DIAGNOSTICS
+				else
+				{
+					int c = tl_unexpected_enabled_counter();
+					assert(c>=0);
+					if( c )
+					{
+						load_unexpected_count<E>(err_id);
+						if( tl_slot_ptr<e_unexpected_info>(table) )
+							load_unexpected_info(err_id, std::forward<F>(f)());
+					}
+				}
+#endif
+				return 0;
+			}
+		};
+
+		template <class E>
+		LEAF_CONSTEXPR inline bool is_handled_impl( tl_slot_table table ) noexcept
+		{
+			if( tl_slot_ptr<E>(table) )
+				return true;
+#if LEAF_DIAGNOSTICS
+			int c = tl_unexpected_enabled_counter();
+			assert(c>=0);
+			if( c )
+				return tl_slot_ptr<e_unexpected_info>(table)!=0;
+#endif
+			return false;
+		}
+
 		template <class F>
-		LEAF_CONSTEXPR inline int accumulate_slot( int err_id, F && f ) noexcept
+		LEAF_CONSTEXPR inline int accumulate_slot( id_type err_id, F && f, tl_slot_table table = get_tl_slot_table() ) noexcept
 		{
 			static_assert(function_traits<F>::arity==1, "Lambdas passed to accumulate must take a single e-type argument by reference");
 			using E = typename std::decay<fn_arg_type<F,0>>::type;
 			static_assert(is_e_type<E>::value, "Lambdas passed to accumulate must take a single e-type argument by reference");
 			assert((err_id&3)==1);
-			if( auto sl = tl_slot_ptr<E>() )
-				if( auto v = sl->has_value(err_id) )
-					(void) std::forward<F>(f)(*v);
-				else
-					(void) std::forward<F>(f)(sl->put(err_id,E()));
+			E * e = 0;
+			if( auto sl = tl_slot_ptr<E>(table) )
+			{
+				e = sl->has_value(err_id);
+				if( !e )
+					e = sl->put(err_id, E());
+			}
+			if( e )
+			{
+				count_load_kept<E>();
+				(void) std::forward<F>(f)(*e);
+			}
+			else
+				count_load_discarded<E>();
 			return 0;
 		}
 	} // leaf_detail
@@ -362,26 +1374,46 @@ namespace boost { namespace leaf {
 		template <class=void>
 		struct id_factory
 		{
-			static atomic_unsigned_int counter;
-			static LEAF_THREAD_LOCAL unsigned last_id;
-			static LEAF_THREAD_LOCAL unsigned next_id;
+			static atomic_unsigned_id counter;
+			static LEAF_THREAD_LOCAL unsigned_id_type last_id;
+			static LEAF_THREAD_LOCAL unsigned_id_type next_id;
+			static LEAF_THREAD_LOCAL unsigned_id_type block_next;
+			static LEAF_THREAD_LOCAL unsigned block_remaining;
 
-			LEAF_CONSTEXPR static unsigned generate_next_id() noexcept
+			LEAF_CONSTEXPR static unsigned_id_type generate_next_id() noexcept
 			{
-				return counter+=4;
+				if( LEAF_ID_BLOCK_SIZE==1 )
+					return counter+=4;
+				if( !block_remaining )
+				{
+					// Reserve LEAF_ID_BLOCK_SIZE ids with a single atomic operation;
+					// the ids in the block are handed out without touching counter.
+					block_next = (counter+=4*LEAF_ID_BLOCK_SIZE) - 4*(LEAF_ID_BLOCK_SIZE-1);
+					block_remaining = LEAF_ID_BLOCK_SIZE;
+				}
+				--block_remaining;
+				unsigned_id_type id = block_next;
+				block_next += 4;
+				return id;
 			}
 		};
 
 		template <class T>
-		atomic_unsigned_int id_factory<T>::counter(-3);
+		atomic_unsigned_id id_factory<T>::counter(-3);
+
+		template <class T>
+		LEAF_THREAD_LOCAL unsigned_id_type id_factory<T>::last_id(0);
+
+		template <class T>
+		LEAF_THREAD_LOCAL unsigned_id_type id_factory<T>::next_id(0);
 
 		template <class T>
-		LEAF_THREAD_LOCAL unsigned id_factory<T>::last_id(0);
+		LEAF_THREAD_LOCAL unsigned_id_type id_factory<T>::block_next(0);
 
 		template <class T>
-		LEAF_THREAD_LOCAL unsigned id_factory<T>::next_id(0);
+		LEAF_THREAD_LOCAL unsigned id_factory<T>::block_remaining(0);
 
-		inline int last_id() noexcept
+		inline id_type last_id() noexcept
 		{
 			if( auto id = id_factory<>::last_id )
 			{
@@ -392,7 +1424,7 @@ namespace boost { namespace leaf {
 				return id;
 		}
 
-		inline int next_id() noexcept
+		inline id_type next_id() noexcept
 		{
 			if( auto id = id_factory<>::next_id )
 			{
@@ -409,7 +1441,7 @@ namespace boost { namespace leaf {
 			}
 		}
 
-		inline int new_id() noexcept
+		inline id_type new_id() noexcept
 		{
 			if( auto id = id_factory<>::next_id )
 			{
@@ -428,6 +1460,12 @@ namespace boost { namespace leaf {
 				return id;
 			}
 		}
+
+		inline void reset_last_id() noexcept
+		{
+			id_factory<>::last_id = 0;
+			id_factory<>::next_id = 0;
+		}
 	}
 
 	////////////////////////////////////////
@@ -455,15 +1493,38 @@ namespace boost { namespace leaf {
 		template <class T>
 		leaf_category get_error_category<T>::cat;
 
-		inline int import_error_code( std::error_code const & ec ) noexcept
+#ifdef LEAF_USE_64BIT_ERROR_ID
+
+		// Only the low 32 bits of a 64-bit error ID fit in a std::error_code. The high
+		// bits are restored from the ID counter, under the assumption that the error ID
+		// was generated no more than 2^32 IDs ago.
+		inline id_type error_code_value_to_id( int value ) noexcept
+		{
+			unsigned_id_type const top = id_factory<>::counter;
+			unsigned_id_type id = (top & ~unsigned_id_type(0xffffffffu)) | unsigned(value);
+			if( id > top )
+				id -= unsigned_id_type(1)<<32;
+			return id;
+		}
+
+#else
+
+		LEAF_CONSTEXPR inline id_type error_code_value_to_id( int value ) noexcept
 		{
-			if( int err_id = ec.value() )
+			return value;
+		}
+
+#endif
+
+		inline id_type import_error_code( std::error_code const & ec ) noexcept
+		{
+			if( id_type err_id = ec.value() )
 			{
 				std::error_category const & cat = leaf_detail::get_error_category<>::cat;
 				if( &ec.category()==&cat )
 				{
 					assert((err_id&3)==1);
-					return err_id;
+					return error_code_value_to_id(ec.value());
 				}
 				else
 				{
@@ -490,16 +1551,16 @@ namespace boost { namespace leaf {
 
 	namespace leaf_detail
 	{
-		LEAF_CONSTEXPR error_id make_error_id(int) noexcept;
+		LEAF_CONSTEXPR error_id make_error_id(id_type) noexcept;
 	}
 
 	class error_id
 	{
-		friend error_id LEAF_CONSTEXPR leaf_detail::make_error_id(int ) noexcept;
+		friend error_id LEAF_CONSTEXPR leaf_detail::make_error_id(leaf_detail::id_type) noexcept;
 
-		int value_;
+		leaf_detail::id_type value_;
 
-		LEAF_CONSTEXPR explicit error_id( int value ) noexcept:
+		LEAF_CONSTEXPR explicit error_id( leaf_detail::id_type value ) noexcept:
 			value_(value)
 		{
 			assert(value_==0 || ((value_&3)==1));
@@ -526,9 +1587,10 @@ namespace boost { namespace leaf {
 		template <class... E>
 		LEAF_CONSTEXPR error_id load( E && ... e ) const noexcept
 		{
-			if( int err_id = value() )
+			if( leaf_detail::id_type err_id = value() )
 			{
-				auto _ = { leaf_detail::load_slot(err_id, std::forward<E>(e))... };
+				leaf_detail::tl_slot_table table = leaf_detail::get_tl_slot_table();
+				auto _ = { leaf_detail::load_item<E>::load(err_id, std::forward<E>(e), table)... };
 				(void) _;
 			}
 			return *this;
@@ -542,9 +1604,10 @@ namespace boost { namespace leaf {
 		template <class... F>
 		LEAF_CONSTEXPR error_id accumulate( F && ... f ) const noexcept
 		{
-			if( int err_id = value() )
+			if( leaf_detail::id_type err_id = value() )
 			{
-				auto _ = { leaf_detail::accumulate_slot(err_id, std::forward<F>(f))... };
+				leaf_detail::tl_slot_table table = leaf_detail::get_tl_slot_table();
+				auto _ = { leaf_detail::accumulate_slot(err_id, std::forward<F>(f), table)... };
 				(void) _;
 			}
 			return *this;
@@ -552,10 +1615,10 @@ namespace boost { namespace leaf {
 
 		std::error_code to_error_code() const noexcept
 		{
-			return std::error_code(value(), leaf_detail::get_error_category<>::cat);
+			return std::error_code(static_cast<int>(value()), leaf_detail::get_error_category<>::cat);
 		}
 
-		LEAF_CONSTEXPR int value() const noexcept
+		LEAF_CONSTEXPR leaf_detail::id_type value() const noexcept
 		{
 			assert(!value_ || ((value_&3)==1));
 			return value_;
@@ -589,21 +1652,35 @@ namespace boost { namespace leaf {
 
 	namespace leaf_detail
 	{
-		LEAF_CONSTEXPR inline error_id make_error_id( int err_id ) noexcept
+		LEAF_CONSTEXPR inline error_id make_error_id( id_type err_id ) noexcept
 		{
 			return error_id(err_id);
 		}
+
+		// Generates the error ID for new_error. With LEAF_ENABLE_STACKTRACE, if
+		// an active context provides storage for an e_stacktrace, the stack is
+		// captured into it.
+		inline id_type new_error_id() noexcept
+		{
+			id_type err_id = new_id();
+#ifdef LEAF_ENABLE_STACKTRACE
+			if( slot<e_stacktrace> * p = tl_slot_ptr<e_stacktrace>() )
+				if( e_stacktrace * st = p->put(err_id, e_stacktrace()) )
+					st->capture();
+#endif
+			return err_id;
+		}
 	}
 
 	inline error_id new_error() noexcept
 	{
-		return leaf_detail::make_error_id(leaf_detail::new_id());
+		return leaf_detail::make_error_id(leaf_detail::new_error_id());
 	}
 
 	template <class E1, class... E>
-	inline typename std::enable_if<is_e_type<E1>::value, error_id>::type new_error( E1 && e1, E && ... e ) noexcept
+	inline typename std::enable_if<is_e_type<E1>::value || leaf_detail::is_deferred_e<typename std::decay<E1>::type>::value, error_id>::type new_error( E1 && e1, E && ... e ) noexcept
 	{
-		return leaf_detail::make_error_id(leaf_detail::new_id()).load(std::forward<E1>(e1), std::forward<E>(e)...);
+		return leaf_detail::make_error_id(leaf_detail::new_error_id()).load(std::forward<E1>(e1), std::forward<E>(e)...);
 	}
 
 	template <class E1, class... E>
@@ -617,6 +1694,69 @@ namespace boost { namespace leaf {
 		return leaf_detail::make_error_id(leaf_detail::next_id());
 	}
 
+#if LEAF_DIAGNOSTICS==2
+
+	inline void set_diagnostics_enabled( bool enabled ) noexcept
+	{
+		leaf_detail::diagnostics_config<>::enabled = enabled;
+	}
+
+	inline void set_diagnostics_sample_rate( int n ) noexcept
+	{
+		assert(n>0);
+		leaf_detail::diagnostics_config<>::sample_rate = n;
+	}
+
+#endif
+
+#ifdef LEAF_COUNT_LOADS
+
+	struct load_count
+	{
+		type_name type;
+		unsigned long kept;
+		unsigned long discarded;
+		unsigned long unexpected;
+	};
+
+	inline std::vector<load_count> get_load_counts()
+	{
+		std::vector<load_count> v;
+		for( leaf_detail::load_counters * c = leaf_detail::load_counters_list<>::head; c; c=c->next )
+		{
+			load_count x = { c->type, c->kept, c->discarded, c->unexpected };
+			v.push_back(x);
+		}
+		return v;
+	}
+
+	inline void reset_load_counts() noexcept
+	{
+		for( leaf_detail::load_counters * c = leaf_detail::load_counters_list<>::head; c; c=c->next )
+		{
+			c->kept = 0;
+			c->discarded = 0;
+			c->unexpected = 0;
+		}
+	}
+
+#endif
+
+	template <class E>
+	inline bool is_handled() noexcept
+	{
+		using T = typename std::decay<E>::type;
+		static_assert(is_e_type<T>::value, "is_handled requires an E-type");
+		return leaf_detail::is_handled_impl<T>(leaf_detail::get_tl_slot_table());
+	}
+
+	template <class E, class F>
+	inline void if_handled( F && f )
+	{
+		if( is_handled<E>() )
+			std::forward<F>(f)();
+	}
+
 	namespace leaf_detail
 	{
 		template <class... E>
@@ -632,6 +1772,116 @@ namespace boost { namespace leaf {
 
 	////////////////////////////////////////////
 
+#if LEAF_CONTEXT_POOL_SIZE
+
+	namespace leaf_detail
+	{
+		// A per-thread cache of up to LEAF_CONTEXT_POOL_SIZE memory blocks for
+		// objects of type T, obtained from (and eventually returned to) the
+		// stateless allocator Alloc. Used by make_shared_context and
+		// allocate_shared_context to recycle the memory of captured contexts.
+		//
+		// A block is returned to the cache of the thread that frees it, so
+		// recycling only helps threads that free the contexts they allocate.
+		// When contexts are allocated by one thread and freed by another, the
+		// allocating thread always gets new blocks, and the freeing thread
+		// keeps at most LEAF_CONTEXT_POOL_SIZE of them.
+		template <class T, class Alloc>
+		class context_block_cache
+		{
+			context_block_cache( context_block_cache const & ) = delete;
+			context_block_cache & operator=( context_block_cache const & ) = delete;
+
+			struct block
+			{
+				block * next;
+			};
+
+			static_assert(sizeof(T)>=sizeof(block), "Block too small");
+
+			using alloc_traits = typename std::allocator_traits<Alloc>::template rebind_traits<T>;
+			using allocator_type = typename alloc_traits::allocator_type;
+
+			allocator_type alloc_;
+			block * free_;
+			int cached_;
+
+			explicit context_block_cache( Alloc const & a ) noexcept:
+				alloc_(a),
+				free_(0),
+				cached_(0)
+			{
+			}
+
+			~context_block_cache() noexcept
+			{
+				while( block * b = free_ )
+				{
+					free_ = b->next;
+					alloc_traits::deallocate(alloc_, reinterpret_cast<T *>(b), 1);
+				}
+				tl_destroyed() = true;
+			}
+
+			// Set when the calling thread's cache is destroyed. It is kept
+			// apart from the cache (and is trivially destructible), so that
+			// blocks freed after that (e.g. by other thread_local objects)
+			// can go straight back to the allocator without touching it.
+			static bool & tl_destroyed() noexcept
+			{
+				static LEAF_THREAD_LOCAL bool d;
+				return d;
+			}
+
+			static context_block_cache & tl_instance( Alloc const & a ) noexcept
+			{
+				static LEAF_THREAD_LOCAL context_block_cache c(a);
+				return c;
+			}
+
+		public:
+
+			static T * allocate( Alloc const & a )
+			{
+				if( !tl_destroyed() )
+				{
+					context_block_cache & c = tl_instance(a);
+					if( block * b = c.free_ )
+					{
+						c.free_ = b->next;
+						--c.cached_;
+						return reinterpret_cast<T *>(b);
+					}
+				}
+				allocator_type al(a);
+				return alloc_traits::allocate(al, 1);
+			}
+
+			static void deallocate( Alloc const & a, T * p ) noexcept
+			{
+				assert(p!=0);
+				if( !tl_destroyed() )
+				{
+					context_block_cache & c = tl_instance(a);
+					if( c.cached_<LEAF_CONTEXT_POOL_SIZE )
+					{
+						block * b = reinterpret_cast<block *>(p);
+						b->next = c.free_;
+						c.free_ = b;
+						++c.cached_;
+						return;
+					}
+				}
+				allocator_type al(a);
+				alloc_traits::deallocate(al, p, 1);
+			}
+		};
+	}
+
+#endif
+
+	////////////////////////////////////////////
+
 	class polymorphic_context
 	{
 	protected:
@@ -643,6 +1893,9 @@ namespace boost { namespace leaf {
 		virtual void deactivate( bool propagate_errors ) noexcept = 0;
 		virtual bool is_active() const noexcept = 0;
 		virtual void print( std::ostream & ) const = 0;
+		// Not pure, so that classes derived from polymorphic_context outside of
+		// LEAF need not implement it; by default no E-objects are serialized.
+		virtual std::size_t serialize( char *, std::size_t ) const { return 0; }
 		error_id captured_id_;
 	};
 
@@ -703,7 +1956,7 @@ namespace boost { namespace leaf {
 						bool has_exception = LEAF_UNCAUGHT_EXCEPTIONS();
 						ctx_->deactivate(has_exception);
 						if( !has_exception )
-							(void) leaf_detail::new_id();
+							leaf_detail::reset_last_id();
 #endif
 					}
 					else
@@ -725,6 +1978,20 @@ namespace boost { namespace leaf {
 
 	////////////////////////////////////////////
 
+	namespace leaf_detail
+	{
+#ifdef LEAF_NO_CAPTURE_IN_RESULT
+		using default_result_ctx_ptr = void;
+#else
+		using default_result_ctx_ptr = context_ptr;
+#endif
+	}
+
+	// A result<T, void> can't transport a context captured by capture, see
+	// nocapture_result.
+	template <class T, class CtxPtr = leaf_detail::default_result_ctx_ptr>
+	class result;
+
 	template <class R>
 	struct is_result_type: std::false_type
 	{
@@ -751,8 +2018,65 @@ namespace boost { namespace leaf {
 		};
 	}
 
+	////////////////////////////////////////////
+
+#ifndef LEAF_NO_EXCEPTIONS
+
+	namespace leaf_detail
+	{
+		// Checking the dynamic type of an exception against a list of exception
+		// types takes one dynamic_cast per type. The result (bit I is set if the
+		// exception is of the I-th type) depends only on the dynamic type, so it
+		// is cached for the last type seen, per list of types and per thread.
+#ifndef LEAF_NO_RTTI
+		struct exception_type_cache
+		{
+			std::type_info const * type;
+			std::uint64_t mask;
+		};
+#endif
+
+		template <class... Ex, std::size_t... I>
+		inline std::uint64_t get_exception_type_mask_( std::exception const * ex, leaf_detail_mp11::index_sequence<I...> ) noexcept
+		{
+			std::uint64_t const bits[ ] = { 0, ((dynamic_cast<Ex const *>(ex)!=0 ? std::uint64_t(1) : 0) << I)... };
+			std::uint64_t mask = 0;
+			for( std::uint64_t b : bits )
+				mask |= b;
+			return mask;
+		}
+
+		template <class... Ex>
+		inline std::uint64_t get_exception_type_mask_( std::exception const *, leaf_detail_mp11::index_sequence<> ) noexcept
+		{
+			return 0;
+		}
+
+		template <class... Ex>
+		inline std::uint64_t get_exception_type_mask( std::exception const & ex ) noexcept
+		{
+			static_assert(sizeof...(Ex)<=64, "Too many exception types");
+#ifdef LEAF_NO_RTTI
+			return get_exception_type_mask_<Ex...>(&ex, leaf_detail_mp11::make_index_sequence<sizeof...(Ex)>());
+#else
+			static LEAF_THREAD_LOCAL exception_type_cache c;
+			std::type_info const * type = &typeid(ex);
+			if( c.type!=type )
+			{
+				c.mask = get_exception_type_mask_<Ex...>(&ex, leaf_detail_mp11::make_index_sequence<sizeof...(Ex)>());
+				c.type = type;
+			}
+			return c.mask;
+#endif
+		}
+	}
+
+#endif
+
 } }
 
 #undef LEAF_THREAD_LOCAL
+#undef LEAF_STACKTRACE_WINDOWS
+#undef LEAF_STACKTRACE_EXECINFO
 
 #endif
@@ -17,26 +17,6 @@
 
 namespace boost { namespace leaf {
 
-	namespace leaf_detail
-	{
-		template <class Ex>
-		LEAF_CONSTEXPR inline bool check_exception_pack( std::exception const * ex, Ex const * ) noexcept
-		{
-			return dynamic_cast<Ex const *>(ex)!=0;
-		}
-
-		template <class Ex, class... ExRest>
-		LEAF_CONSTEXPR inline bool check_exception_pack( std::exception const * ex, Ex const *, ExRest const * ... ex_rest ) noexcept
-		{
-			return dynamic_cast<Ex const *>(ex)!=0 || check_exception_pack(ex, ex_rest...);
-		}
-
-		LEAF_CONSTEXPR inline bool check_exception_pack( std::exception const * )
-		{
-			return true;
-		}
-	}
-
 	template <class... Ex>
 	class catch_
 	{
@@ -51,7 +31,7 @@ namespace boost { namespace leaf {
 
 		LEAF_CONSTEXPR bool operator()() const noexcept
 		{
-			return value_ && leaf_detail::check_exception_pack(value_,static_cast<Ex const *>(0)...);
+			return value_ && (sizeof...(Ex)==0 || leaf_detail::get_exception_type_mask<Ex...>(*value_)!=0);
 		}
 
 		LEAF_CONSTEXPR std::exception const & value() const noexcept
@@ -69,7 +49,7 @@ namespace boost { namespace leaf {
 	public:
 
 		LEAF_CONSTEXPR explicit catch_( std::exception const * value ) noexcept:
-			value_(dynamic_cast<Ex const *>(value))
+			value_(value && leaf_detail::get_exception_type_mask<Ex>(*value) ? dynamic_cast<Ex const *>(value) : 0)
 		{
 		}
 
@@ -95,6 +75,8 @@ namespace boost { namespace leaf {
 		template <class SlotsTuple, class... Ex>
 		struct check_one_argument<SlotsTuple,catch_<Ex...>>
 		{
+			constexpr static presence_mask required_mask = 0;
+
 			LEAF_CONSTEXPR static bool check( SlotsTuple const &, error_info const & ei ) noexcept
 			{
 				if( ei.exception_caught() )
@@ -8,6 +8,8 @@
 
 #include <boost/leaf/error.hpp>
 
+#define LEAF_ERROR_TRACE auto leaf_error_trace_ = ::boost::leaf::accumulate(::boost::leaf::leaf_detail::error_trace_frame{__FILE__,__LINE__,__FUNCTION__})
+
 namespace boost { namespace leaf {
 
 	namespace leaf_detail
@@ -15,7 +17,7 @@ namespace boost { namespace leaf {
 		template <int I, class Tuple>
 		struct tuple_for_each_preload
 		{
-			LEAF_CONSTEXPR static void trigger( Tuple & tup, int err_id ) noexcept
+			LEAF_CONSTEXPR static void trigger( Tuple & tup, id_type err_id ) noexcept
 			{
 				assert((err_id&3)==1);
 				tuple_for_each_preload<I-1,Tuple>::trigger(tup,err_id);
@@ -26,7 +28,7 @@ namespace boost { namespace leaf {
 		template <class Tuple>
 		struct tuple_for_each_preload<0, Tuple>
 		{
-			LEAF_CONSTEXPR static void trigger( Tuple const &, int ) noexcept { }
+			LEAF_CONSTEXPR static void trigger( Tuple const &, id_type ) noexcept { }
 		};
 	} // leaf_detail
 
@@ -42,29 +44,32 @@ namespace boost { namespace leaf {
 
 		public:
 
-			LEAF_CONSTEXPR explicit preloaded_item( E && e ) noexcept:
-				s_(tl_slot_ptr<E>()),
+			LEAF_CONSTEXPR explicit preloaded_item( E && e, tl_slot_table table = get_tl_slot_table() ) noexcept:
+				s_(tl_slot_ptr<E>(table)),
 				e_(std::forward<E>(e))
 			{
 			}
 
-			LEAF_CONSTEXPR void trigger( int err_id ) noexcept
+			LEAF_CONSTEXPR void trigger( id_type err_id ) noexcept
 			{
 				assert((err_id&3)==1);
 				if( s_ )
 				{
-					if( !s_->has_value(err_id) )
-						s_->put(err_id, std::move(e_));
+					if( !s_->has_value(err_id) && s_->put(err_id, std::move(e_)) )
+						count_load_kept<E>();
+					else
+						count_load_discarded<E>();
 				}
-#if LEAF_DIAGNOSTICS
 				else
 				{
+					count_load_missed<E>();
+#if LEAF_DIAGNOSTICS
 					int c = tl_unexpected_enabled_counter();
 					assert(c>=0);
 					if( c )
 						load_unexpected(err_id, std::forward<E>(e_));
-				}
 #endif
+				}
 			}
 		};
 
@@ -75,7 +80,7 @@ namespace boost { namespace leaf {
 
 			std::tuple<preloaded_item<E>...> p_;
 			bool moved_;
-			int err_id_;
+			id_type err_id_;
 
 		public:
 
@@ -98,8 +103,8 @@ namespace boost { namespace leaf {
 			{
 				if( moved_ )
 					return;
-				int const err_id = last_id();
-				if( err_id==err_id_ )
+				id_type const err_id = last_id();
+				if( err_id==err_id_ || !err_id )
 				{
 #ifndef LEAF_NO_EXCEPTIONS
 					if( LEAF_UNCAUGHT_EXCEPTIONS() )
@@ -131,29 +136,32 @@ namespace boost { namespace leaf {
 
 		public:
 
-			LEAF_CONSTEXPR explicit deferred_item( F && f ) noexcept:
-				s_(tl_slot_ptr<E>()),
+			LEAF_CONSTEXPR explicit deferred_item( F && f, tl_slot_table table = get_tl_slot_table() ) noexcept:
+				s_(tl_slot_ptr<E>(table)),
 				f_(std::forward<F>(f))
 			{
 			}
 
-			LEAF_CONSTEXPR void trigger( int err_id ) noexcept
+			LEAF_CONSTEXPR void trigger( id_type err_id ) noexcept
 			{
 				assert((err_id&3)==1);
 				if( s_ )
 				{
-					if( !s_->has_value(err_id) )
-						s_->put(err_id, f_());
+					if( !s_->has_value(err_id) && s_->put(err_id, f_()) )
+						count_load_kept<E>();
+					else
+						count_load_discarded<E>();
 				}
-#if LEAF_DIAGNOSTICS
 				else
 				{
+					count_load_missed<E>();
+#if LEAF_DIAGNOSTICS
 					int c = tl_unexpected_enabled_counter();
 					assert(c>=0);
 					if( c )
 						load_unexpected(err_id, std::forward<E>(f_()));
-				}
 #endif
+				}
 			}
 		};
 
@@ -163,7 +171,7 @@ namespace boost { namespace leaf {
 			deferred & operator=( deferred const & ) = delete;
 			std::tuple<deferred_item<F>...> d_;
 			bool moved_;
-			int err_id_;
+			id_type err_id_;
 
 		public:
 
@@ -186,8 +194,8 @@ namespace boost { namespace leaf {
 			{
 				if( moved_ )
 					return;
-				int const err_id = last_id();
-				if( err_id==err_id_ )
+				id_type const err_id = last_id();
+				if( err_id==err_id_ || !err_id )
 				{
 #ifndef LEAF_NO_EXCEPTIONS
 					if( LEAF_UNCAUGHT_EXCEPTIONS() )
@@ -206,6 +214,40 @@ namespace boost { namespace leaf {
 		return leaf_detail::deferred<F...>(std::forward<F>(f)...);
 	}
 
+	namespace leaf_detail
+	{
+		// A nullary function object which constructs an E-object from a
+		// reference to a value which outlives it; used by preload_ref to
+		// defer copying the value until an error is actually reported.
+		template <class E, class A>
+		class e_from_ref
+		{
+			A const * a_;
+
+		public:
+
+			LEAF_CONSTEXPR explicit e_from_ref( A const & a ) noexcept:
+				a_(&a)
+			{
+			}
+
+			LEAF_CONSTEXPR E operator()() const
+			{
+				return E{*a_};
+			}
+		};
+	} // leaf_detail
+
+	template <class E, class A>
+	LEAF_CONSTEXPR inline leaf_detail::deferred<leaf_detail::e_from_ref<E, A>> preload_ref( A const & a ) noexcept
+	{
+		static_assert(is_e_type<E>::value, "preload_ref requires an E-type");
+		return leaf_detail::deferred<leaf_detail::e_from_ref<E, A>>(leaf_detail::e_from_ref<E, A>(a));
+	}
+
+	template <class E, class A>
+	void preload_ref( A const && ) = delete;
+
 	////////////////////////////////////////
 
 	namespace leaf_detail
@@ -222,20 +264,29 @@ namespace boost { namespace leaf {
 
 		public:
 
-			LEAF_CONSTEXPR explicit accumulating_item( F && f ) noexcept:
-				s_(tl_slot_ptr<E>()),
+			LEAF_CONSTEXPR explicit accumulating_item( F && f, tl_slot_table table = get_tl_slot_table() ) noexcept:
+				s_(tl_slot_ptr<E>(table)),
 				f_(std::forward<F>(f))
 			{
 			}
 
-			LEAF_CONSTEXPR void trigger( int err_id ) noexcept
+			LEAF_CONSTEXPR void trigger( id_type err_id ) noexcept
 			{
 				assert((err_id&3)==1);
+				E * e = 0;
 				if( s_ )
-					if( E * e = s_->has_value(err_id) )
-						(void) f_(*e);
-					else
-						(void) f_(s_->put(err_id, E()));
+				{
+					e = s_->has_value(err_id);
+					if( !e )
+						e = s_->put(err_id, E());
+				}
+				if( e )
+				{
+					count_load_kept<E>();
+					(void) f_(*e);
+				}
+				else
+					count_load_discarded<E>();
 			}
 		};
 
@@ -245,7 +296,7 @@ namespace boost { namespace leaf {
 			accumulating & operator=( accumulating const & ) = delete;
 			std::tuple<accumulating_item<F>...> a_;
 			bool moved_;
-			int err_id_;
+			id_type err_id_;
 
 		public:
 
@@ -268,8 +319,8 @@ namespace boost { namespace leaf {
 			{
 				if( moved_ )
 					return;
-				int const err_id = last_id();
-				if( err_id==err_id_ )
+				id_type const err_id = last_id();
+				if( err_id==err_id_ || !err_id )
 				{
 #ifndef LEAF_NO_EXCEPTIONS
 					if( LEAF_UNCAUGHT_EXCEPTIONS() )
@@ -288,6 +339,107 @@ namespace boost { namespace leaf {
 		return leaf_detail::accumulating<F...>(std::forward<F>(f)...);
 	}
 
+	////////////////////////////////////////
+
+	namespace leaf_detail
+	{
+		// Selects the item type for each argument passed to on_error: a nullary
+		// function returning an E-type is deferred, a function taking a single
+		// E-object by reference is accumulating, anything else is preloaded.
+		template <class T, int Kind =
+			is_deferred_e<T>::value ? 1 :
+			function_traits<T>::arity==1 && !is_e_type<T>::value ? 2 :
+			0>
+		struct on_error_item_impl
+		{
+			using type = preloaded_item<T>;
+		};
+
+		template <class F>
+		struct on_error_item_impl<F, 1>
+		{
+			using type = deferred_item<F>;
+		};
+
+		template <class F>
+		struct on_error_item_impl<F, 2>
+		{
+			using type = accumulating_item<F>;
+		};
+
+		template <class T>
+		using on_error_item = typename on_error_item_impl<typename std::decay<T>::type>::type;
+
+		// Unlike using separate preload / defer / accumulate objects, the items
+		// share one error ID snapshot and one check in the destructor, and the
+		// slot pointers are all looked up through a single tl_slot_table.
+		template <class... Item>
+		class on_error_guard
+		{
+			on_error_guard & operator=( on_error_guard const & ) = delete;
+			std::tuple<Item...> i_;
+			bool moved_;
+			id_type err_id_;
+
+		public:
+
+			template <class... T>
+			LEAF_CONSTEXPR explicit on_error_guard( tl_slot_table table, T && ... x ) noexcept:
+				i_(Item(typename std::decay<T>::type(std::forward<T>(x)), table)...),
+				moved_(false),
+				err_id_(last_id())
+			{
+			}
+
+			LEAF_CONSTEXPR on_error_guard( on_error_guard && x ) noexcept:
+				i_(std::move(x.i_)),
+				moved_(false),
+				err_id_(x.err_id_)
+			{
+				x.moved_ = true;
+			}
+
+			~on_error_guard() noexcept
+			{
+				if( moved_ )
+					return;
+				id_type const err_id = last_id();
+				if( err_id==err_id_ || !err_id )
+				{
+#ifndef LEAF_NO_EXCEPTIONS
+					if( LEAF_UNCAUGHT_EXCEPTIONS() )
+						leaf_detail::tuple_for_each_preload<sizeof...(Item),decltype(i_)>::trigger(i_,next_id());
+#endif
+				}
+				else
+					leaf_detail::tuple_for_each_preload<sizeof...(Item),decltype(i_)>::trigger(i_,err_id);
+			}
+		};
+	} // leaf_detail
+
+	template <class... T>
+	LEAF_CONSTEXPR inline leaf_detail::on_error_guard<leaf_detail::on_error_item<T>...> on_error( T && ... x ) noexcept
+	{
+		return leaf_detail::on_error_guard<leaf_detail::on_error_item<T>...>(leaf_detail::get_tl_slot_table(), std::forward<T>(x)...);
+	}
+
+	////////////////////////////////////////
+
+	namespace leaf_detail
+	{
+		struct error_trace_frame
+		{
+			char const * file;
+			int line;
+			char const * function;
+
+			void operator()( e_error_trace & tr ) const
+			{
+				tr.push(file, line, function);
+			}
+		};
+	} // leaf_detail
+
 } }
 
 #endif
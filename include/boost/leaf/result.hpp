@@ -36,7 +36,7 @@ namespace boost { namespace leaf {
 	{
 		class result_discriminant
 		{
-			unsigned state_;
+			leaf_detail::unsigned_id_type state_;
 
 		public:
 
@@ -81,12 +81,249 @@ namespace boost { namespace leaf {
 
 	////////////////////////////////////////
 
-	template <class T>
-	class result
+	namespace leaf_detail
 	{
-		template <class U>
+		// A captured context is held through a pointer to a context_ptr stored
+		// in a memory block from the per-thread heap_block_cache, which keeps
+		// the union in result<T> at 8 bytes instead of sizeof(std::shared_ptr).
+		// Each result owns its block, so it can be moved to (and destroyed by)
+		// another thread. Returns 0 (leaving ctx unchanged) if out of memory.
+		inline context_ptr * hold_context( context_ptr & ctx ) noexcept
+		{
+			assert(ctx);
+			if( void * p = heap_block_cache<sizeof(context_ptr)>::allocate() )
+				return new (p) context_ptr(std::move(ctx));
+			return 0;
+		}
+
+		inline void drop_context( context_ptr * p ) noexcept
+		{
+			if( p )
+			{
+				p->~context_ptr();
+				heap_block_cache<sizeof(context_ptr)>::deallocate(p);
+			}
+		}
+
+		template <class T, bool CanCapture, bool Trivial = !CanCapture && std::is_trivially_copyable<T>::value>
+		class result_storage
+		{
+			template <class, bool, bool>
+			friend class result_storage;
+
+		protected:
+
+			union
+			{
+				T value_;
+				context_ptr * ctx_;
+			};
+
+			result_discriminant what_;
+
+			LEAF_CONSTEXPR void destroy() const noexcept
+			{
+				switch(this->what_.kind())
+				{
+				case result_discriminant::val:
+					value_.~T();
+					break;
+				case result_discriminant::ctx_ptr:
+					assert(!ctx_ || (*ctx_)->captured_id_);
+					drop_context(ctx_);
+				default:
+					break;
+				}
+			}
+
+			LEAF_CONSTEXPR context_ptr * release_context() noexcept
+			{
+				assert(what_.kind()==result_discriminant::ctx_ptr);
+				context_ptr * ctx = ctx_;
+				ctx_ = 0;
+				return ctx;
+			}
+
+			LEAF_CONSTEXPR error_id captured_id() const noexcept
+			{
+				assert(what_.kind()==result_discriminant::ctx_ptr);
+				return (*ctx_)->captured_id_;
+			}
+
+			LEAF_CONSTEXPR error_id propagate_captured_errors() noexcept
+			{
+				assert(what_.kind()==result_discriminant::ctx_ptr);
+				return (*ctx_)->propagate_captured_errors();
+			}
+
+			template <class U, bool C, bool B>
+			LEAF_CONSTEXPR result_discriminant move_from( result_storage<U, C, B> && x ) noexcept
+			{
+				auto x_what = x.what_;
+				switch(x_what.kind())
+				{
+				case result_discriminant::val:
+					(void) new(&value_) T(std::move(x.value_));
+					break;
+				case result_discriminant::ctx_ptr:
+					ctx_ = x.release_context();
+				default:
+					break;
+				}
+				return x_what;
+			}
+
+			LEAF_CONSTEXPR result_storage( result_storage && x ) noexcept:
+				what_(move_from(std::move(x)))
+			{
+			}
+
+			template <class U, bool C, bool B>
+			LEAF_CONSTEXPR explicit result_storage( result_storage<U, C, B> && x ) noexcept:
+				what_(move_from(std::move(x)))
+			{
+			}
+
+			LEAF_CONSTEXPR explicit result_storage( result_discriminant what ) noexcept:
+				ctx_(0),
+				what_(what)
+			{
+			}
+
+			template <class... A>
+			LEAF_CONSTEXPR explicit result_storage( result_discriminant::kind_val k, A && ... a ):
+				value_(std::forward<A>(a)...),
+				what_(k)
+			{
+			}
+
+			LEAF_CONSTEXPR explicit result_storage( context_ptr * ctx ) noexcept:
+				ctx_(ctx),
+				what_(result_discriminant::kind_ctx_ptr{})
+			{
+			}
+
+			// If the context_ptr can't be stored, the result holds the captured
+			// error ID instead, without the E-objects stored in the context.
+			LEAF_CONSTEXPR explicit result_storage( context_ptr && ctx ) noexcept:
+				ctx_(hold_context(ctx)),
+				what_(ctx_ ? result_discriminant(result_discriminant::kind_ctx_ptr{}) : result_discriminant(ctx->captured_id_))
+			{
+			}
+
+			LEAF_CONSTEXPR result_storage & operator=( result_storage && x ) noexcept
+			{
+				destroy();
+				what_ = move_from(std::move(x));
+				return *this;
+			}
+
+			~result_storage() noexcept
+			{
+				destroy();
+			}
+		};
+
+		// When T is trivially copyable and the result can not hold a captured
+		// context, all special member functions are trivial, so the result
+		// can be passed in registers and relocated with memcpy.
+		template <class T>
+		class result_storage<T, false, true>
+		{
+			template <class, bool, bool>
+			friend class result_storage;
+
+		protected:
+
+			// raw_ gives the error states a defined object representation, so
+			// that copying a result which holds no value is not a read of an
+			// uninitialized T.
+			union
+			{
+				T value_;
+				unsigned char raw_[sizeof(T)];
+			};
+
+			result_discriminant what_;
+
+			LEAF_CONSTEXPR void destroy() const noexcept
+			{
+			}
+
+			// A result which can't hold a captured context is never in the
+			// ctx_ptr state.
+			LEAF_CONSTEXPR context_ptr * release_context() noexcept
+			{
+				assert(what_.kind()!=result_discriminant::ctx_ptr);
+				return 0;
+			}
+
+			LEAF_CONSTEXPR error_id captured_id() const noexcept
+			{
+				assert(what_.kind()!=result_discriminant::ctx_ptr);
+				return error_id();
+			}
+
+			LEAF_CONSTEXPR error_id propagate_captured_errors() noexcept
+			{
+				assert(what_.kind()!=result_discriminant::ctx_ptr);
+				return error_id();
+			}
+
+			template <class U, bool C, bool B>
+			LEAF_CONSTEXPR result_discriminant move_from( result_storage<U, C, B> && x ) noexcept
+			{
+				assert(x.what_.kind()!=result_discriminant::ctx_ptr);
+				if( x.what_.kind()==result_discriminant::val )
+					(void) new(&value_) T(std::move(x.value_));
+				return x.what_;
+			}
+
+			template <class U, bool C, bool B>
+			LEAF_CONSTEXPR explicit result_storage( result_storage<U, C, B> && x ) noexcept:
+				what_(move_from(std::move(x)))
+			{
+			}
+
+			LEAF_CONSTEXPR explicit result_storage( result_discriminant what ) noexcept:
+				raw_(),
+				what_(what)
+			{
+			}
+
+			template <class... A>
+			LEAF_CONSTEXPR explicit result_storage( result_discriminant::kind_val k, A && ... a ):
+				value_(std::forward<A>(a)...),
+				what_(k)
+			{
+			}
+		};
+	}
+
+	////////////////////////////////////////
+
+	template <class T, class CtxPtr>
+	class result:
+		leaf_detail::result_storage<T, !std::is_void<CtxPtr>::value>
+	{
+		static_assert(std::is_void<CtxPtr>::value || std::is_same<CtxPtr, context_ptr>::value, "The second template parameter of result must be context_ptr or void");
+
+		template <class, class>
 		friend class result;
 
+		typedef leaf_detail::result_storage<T, !std::is_void<CtxPtr>::value> storage;
+
+		using storage::value_;
+		using storage::what_;
+		using storage::destroy;
+		using storage::move_from;
+
+		// Whether a result<T, CtxPtr> may be initialized from a result<U, C>:
+		// a result which can't hold a captured context can't be initialized
+		// from one that can.
+		template <class C>
+		using enable_from = typename std::enable_if<!std::is_void<CtxPtr>::value || std::is_void<C>::value>::type;
+
 		struct error_result
 		{
 			error_result( error_result && ) = default;
@@ -100,18 +337,18 @@ namespace boost { namespace leaf {
 
 			result & r_;
 
-			template <class U>
-			LEAF_CONSTEXPR operator result<U>() noexcept
+			template <class U, class C>
+			LEAF_CONSTEXPR operator result<U, C>() noexcept
 			{
 				using leaf_detail::result_discriminant;
 				switch(r_.what_.kind())
 				{
 				case result_discriminant::val:
-					return result<U>(error_id());
+					return result<U, C>(error_id());
 				case result_discriminant::ctx_ptr:
-					return result<U>(std::move(r_.ctx_));
+					return r_.template move_context<U>(std::is_void<C>());
 				default:
-					return result<U>(std::move(r_.what_));
+					return result<U, C>(std::move(r_.what_));
 				}
 			}
 
@@ -123,58 +360,40 @@ namespace boost { namespace leaf {
 				case result_discriminant::val:
 					return error_id();
 				case result_discriminant::ctx_ptr:
-					return r_.ctx_->propagate_captured_errors();
+					return r_.propagate_captured_errors();
 				default:
 					return r_.what_.get_error_id();
 				}
 			}
 		};
 
-		union
+		template <class U>
+		LEAF_CONSTEXPR result<U, context_ptr> move_context( std::false_type ) noexcept
 		{
-			T value_;
-			context_ptr ctx_;
-		};
+			return result<U, context_ptr>(storage::release_context());
+		}
 
-		leaf_detail::result_discriminant what_;
+		// The captured context can't be transported further: its E-objects
+		// are loaded into the active contexts instead.
+		template <class U>
+		LEAF_CONSTEXPR result<U, void> move_context( std::true_type ) noexcept
+		{
+			return result<U, void>(storage::propagate_captured_errors());
+		}
 
-		LEAF_CONSTEXPR void destroy() const noexcept
+		LEAF_CONSTEXPR explicit result( context_ptr * ctx ) noexcept:
+			storage(ctx)
 		{
-			using leaf_detail::result_discriminant;
-			switch(this->what_.kind())
-			{
-			case result_discriminant::val:
-				value_.~T();
-				break;
-			case result_discriminant::ctx_ptr:
-				assert(!ctx_ || ctx_->captured_id_);
-				ctx_.~context_ptr();
-			default:
-				break;
-			}
 		}
 
-		template <class U>
-		LEAF_CONSTEXPR leaf_detail::result_discriminant move_from( result<U> && x ) noexcept
+		template <class U, class C>
+		LEAF_CONSTEXPR static typename result<U, C>::storage && storage_of( result<U, C> && x ) noexcept
 		{
-			using leaf_detail::result_discriminant;
-			auto x_what = x.what_;
-			switch(x_what.kind())
-			{
-			case result_discriminant::val:
-				(void) new(&value_) T(std::move(x.value_));
-				break;
-			case result_discriminant::ctx_ptr:
-				assert(!x.ctx_ || x.ctx_->captured_id_);
-				(void) new(&ctx_) context_ptr(std::move(x.ctx_));
-			default:
-				break;
-			}
-			return x_what;
+			return std::move(x);
 		}
 
 		LEAF_CONSTEXPR result( leaf_detail::result_discriminant && what ) noexcept:
-			what_(std::move(what))
+			storage(std::move(what))
 		{
 			using leaf_detail::result_discriminant;
 			assert(what_.kind()==result_discriminant::err_id || what_.kind()==result_discriminant::no_error);
@@ -184,69 +403,52 @@ namespace boost { namespace leaf {
 
 		typedef T value_type;
 
-		~result() noexcept
-		{
-			destroy();
-		}
-
-		LEAF_CONSTEXPR result( result && x ) noexcept:
-			what_(move_from(std::move(x)))
-		{
-		}
-
-		template <class U>
-		LEAF_CONSTEXPR result( result<U> && x ) noexcept:
-			what_(move_from(std::move(x)))
+		result( result && ) = default;
 
+		template <class U, class C, class = enable_from<C>>
+		LEAF_CONSTEXPR result( result<U, C> && x ) noexcept:
+			storage(storage_of(std::move(x)))
 		{
 		}
 
 		LEAF_CONSTEXPR result():
-			value_(T()),
-			what_(leaf_detail::result_discriminant::kind_val{})
+			storage(leaf_detail::result_discriminant::kind_val{}, T())
 		{
 		}
 
 		LEAF_CONSTEXPR result( T && v ) noexcept:
-			value_(std::move(v)),
-			what_(leaf_detail::result_discriminant::kind_val{})
+			storage(leaf_detail::result_discriminant::kind_val{}, std::move(v))
 		{
 		}
 
 		LEAF_CONSTEXPR result( T const & v ):
-			value_(v),
-			what_(leaf_detail::result_discriminant::kind_val{})
+			storage(leaf_detail::result_discriminant::kind_val{}, v)
 		{
 		}
 
 		LEAF_CONSTEXPR result( error_id err ) noexcept:
-			what_(err)
+			storage(leaf_detail::result_discriminant(err))
 		{
 		}
 
 		LEAF_CONSTEXPR result( std::error_code const & ec ) noexcept:
-			what_(error_id(ec))
+			storage(leaf_detail::result_discriminant(error_id(ec)))
 		{
 		}
 
+		template <class C = CtxPtr, class = typename std::enable_if<!std::is_void<C>::value>::type>
 		LEAF_CONSTEXPR result( context_ptr && ctx ) noexcept:
-			ctx_(std::move(ctx)),
-			what_(leaf_detail::result_discriminant::kind_ctx_ptr{})
+			storage(std::move(ctx))
 		{
 		}
 
-		LEAF_CONSTEXPR result & operator=( result && x ) noexcept
-		{
-			destroy();
-			what_ = move_from(std::move(x));
-			return *this;
-		}
+		result & operator=( result && ) = default;
 
-		template <class U>
-		LEAF_CONSTEXPR result & operator=( result<U> && x ) noexcept
+		template <class U, class C, class = enable_from<C>>
+		LEAF_CONSTEXPR result & operator=( result<U, C> && x ) noexcept
 		{
 			destroy();
-			what_ = move_from(std::move(x));
+			what_ = move_from(storage_of(std::move(x)));
 			return *this;
 		}
 
@@ -296,7 +498,9 @@ namespace boost { namespace leaf {
 		{
 			using leaf_detail::result_discriminant;
 			assert(what_.kind()!=result_discriminant::val);
-			return what_.kind()==result_discriminant::ctx_ptr ? ctx_->captured_id_ : what_.get_error_id();
+			if( what_.kind()==result_discriminant::ctx_ptr )
+				return storage::captured_id();
+			return what_.get_error_id();
 		}
 
 		LEAF_CONSTEXPR error_result error() noexcept
@@ -319,16 +523,16 @@ namespace boost { namespace leaf {
 
 	////////////////////////////////////////
 
-	template <>
-	class result<void>:
-		result<bool>
+	template <class CtxPtr>
+	class result<void, CtxPtr>:
+		result<bool, CtxPtr>
 	{
-		typedef result<bool> base;
+		typedef result<bool, CtxPtr> base;
 
-		template <class U>
+		template <class, class>
 		friend class result;
 
-		LEAF_CONSTEXPR result( result<bool> && rb ):
+		LEAF_CONSTEXPR result( result<bool, CtxPtr> && rb ):
 			base(std::move(rb))
 		{
 		}
@@ -338,18 +542,18 @@ namespace boost { namespace leaf {
 		{
 		}
 
+		LEAF_CONSTEXPR explicit result( context_ptr * ctx ) noexcept:
+			base(ctx)
+		{
+		}
+
 	public:
 
 		typedef void value_type;
 
-		~result() noexcept
-		{
-		}
+		result( result && ) = default;
 
-		LEAF_CONSTEXPR result( result && x ) noexcept:
-			base(std::move(x))
-		{
-		}
+		result & operator=( result && ) = default;
 
 		LEAF_CONSTEXPR result() noexcept
 		{
@@ -365,6 +569,7 @@ namespace boost { namespace leaf {
 		{
 		}
 
+		template <class C = CtxPtr, class = typename std::enable_if<!std::is_void<C>::value>::type>
 		LEAF_CONSTEXPR result( context_ptr && ctx ) noexcept:
 			base(std::move(ctx))
 		{
@@ -394,13 +599,18 @@ namespace boost { namespace leaf {
 		using base::accumulate;
 	};
 
+	// A result<T> which can't hold a context captured by capture. If T is
+	// trivially copyable, so is nocapture_result<T>.
+	template <class T>
+	using nocapture_result = result<T, void>;
+
 	////////////////////////////////////////
 
 	template <class R>
 	struct is_result_type;
 
-	template <class T>
-	struct is_result_type<result<T>>: std::true_type
+	template <class T, class CtxPtr>
+	struct is_result_type<result<T, CtxPtr>>: std::true_type
 	{
 	};
 } }
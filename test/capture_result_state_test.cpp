@@ -7,6 +7,9 @@
 #include <boost/leaf/result.hpp>
 #include <boost/leaf/handle_error.hpp>
 #include "lightweight_test.hpp"
+#ifndef LEAF_NO_THREADS
+#	include <thread>
+#endif
 
 namespace leaf = boost::leaf;
 
@@ -69,5 +72,55 @@ int main()
 		BOOST_TEST_EQ(answer, 42);
 	}
 	BOOST_TEST_EQ(count, 0);
+
+	// The context is kept alive until the last result that refers to it is gone.
+	{
+		leaf::context_ptr ctx = leaf::make_shared_context(&error_handler);
+		{
+			auto active_context = activate_context(*ctx, leaf::on_deactivation::do_not_propagate);
+			ctx->captured_id_ = leaf::new_error( info<1>{}, info<3>{} );
+		}
+		leaf::result<int> r1(leaf::context_ptr{ctx});
+		{
+			leaf::result<int> r2(std::move(ctx));
+		}
+		BOOST_TEST_EQ(count, 2);
+		int answer = leaf::remote_try_handle_all(
+			[&r1]
+			{
+				return std::move(r1);
+			},
+			[&]( leaf::error_info const & err )
+			{
+				return error_handler(err);
+			} );
+		BOOST_TEST_EQ(answer, 42);
+	}
+	BOOST_TEST_EQ(count, 0);
+
+#ifndef LEAF_NO_THREADS
+	// Results referring to the same context may be created and destroyed concurrently.
+	{
+		leaf::context_ptr ctx = leaf::make_shared_context(&error_handler);
+		{
+			auto active_context = activate_context(*ctx, leaf::on_deactivation::do_not_propagate);
+			ctx->captured_id_ = leaf::new_error( info<1>{}, info<3>{} );
+		}
+		auto f = [&ctx]
+		{
+			for( int i=0; i!=10000; ++i )
+			{
+				leaf::result<int> r(leaf::context_ptr{ctx});
+				BOOST_TEST(!r);
+			}
+		};
+		std::thread t1(f), t2(f);
+		t1.join();
+		t2.join();
+		BOOST_TEST_EQ(count, 2);
+		BOOST_TEST_EQ(ctx.use_count(), 1);
+	}
+	BOOST_TEST_EQ(count, 0);
+#endif
 	return boost::report_errors();
 }
@@ -0,0 +1,150 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <boost/leaf/context.hpp>
+#include <boost/leaf/handle_error.hpp>
+#include <boost/leaf/result.hpp>
+#include "lightweight_test.hpp"
+
+namespace leaf = boost::leaf;
+
+template <int>
+struct info
+{
+	int value;
+};
+
+using outer_context = leaf::context<info<1>, info<2>>;
+using inner_context = leaf::context<info<1>, info<2>>;
+
+int handle( outer_context & ctx, leaf::error_id id )
+{
+	leaf::result<int> r(id);
+	return ctx.handle_all( r,
+		[]( info<1> const & x, info<2> const & y )
+		{
+			return x.value + y.value;
+		},
+		[]( info<1> const & x )
+		{
+			return x.value;
+		},
+		[]( info<2> const & y )
+		{
+			return y.value;
+		},
+		[]
+		{
+			return -1;
+		} );
+}
+
+int main()
+{
+	// Propagating a context with no E-objects leaves the outer context alone.
+	{
+		outer_context outer;
+		leaf::error_id id;
+		{
+			auto active_outer = activate_context(outer, leaf::on_deactivation::do_not_propagate);
+			id = leaf::new_error(info<1>{1}, info<2>{2});
+			for( int i=0; i!=3; ++i )
+			{
+				inner_context inner;
+				auto active_inner = activate_context(inner, leaf::on_deactivation::propagate);
+			}
+		}
+		BOOST_TEST_EQ(handle(outer, id), 3);
+	}
+
+	// Only the E-objects stored in the inner context replace those in the outer context.
+	{
+		outer_context outer;
+		leaf::error_id id;
+		{
+			auto active_outer = activate_context(outer, leaf::on_deactivation::do_not_propagate);
+			(void) leaf::new_error(info<1>{1}, info<2>{2});
+			{
+				inner_context inner;
+				auto active_inner = activate_context(inner, leaf::on_deactivation::propagate);
+				id = leaf::new_error(info<2>{20});
+			}
+		}
+		BOOST_TEST_EQ(handle(outer, id), 20);
+	}
+
+	// E-objects propagate through a chain of nested contexts.
+	{
+		outer_context outer;
+		leaf::error_id id;
+		{
+			auto active_outer = activate_context(outer, leaf::on_deactivation::do_not_propagate);
+			inner_context inner1;
+			auto active_inner1 = activate_context(inner1, leaf::on_deactivation::propagate);
+			{
+				inner_context inner2;
+				auto active_inner2 = activate_context(inner2, leaf::on_deactivation::propagate);
+				id = leaf::new_error(info<1>{1}, info<2>{2});
+			}
+		}
+		BOOST_TEST_EQ(handle(outer, id), 3);
+	}
+
+	// A context that holds E-objects from an earlier activation propagates them
+	// even if nothing is loaded while it is active.
+	{
+		inner_context inner;
+		leaf::error_id id;
+		{
+			auto active_inner = activate_context(inner, leaf::on_deactivation::do_not_propagate);
+			id = leaf::new_error(info<1>{1}, info<2>{2});
+		}
+		outer_context outer;
+		{
+			auto active_outer = activate_context(outer, leaf::on_deactivation::do_not_propagate);
+			auto active_inner = activate_context(inner, leaf::on_deactivation::propagate);
+		}
+		BOOST_TEST_EQ(handle(outer, id), 3);
+	}
+
+	// E-objects that have nowhere to go stay in the context, and are propagated
+	// the next time it is deactivated.
+	{
+		inner_context inner;
+		leaf::error_id id;
+		{
+			auto active_inner = activate_context(inner, leaf::on_deactivation::propagate);
+			id = leaf::new_error(info<1>{1});
+		}
+		outer_context outer;
+		{
+			auto active_outer = activate_context(outer, leaf::on_deactivation::do_not_propagate);
+			auto active_inner = activate_context(inner, leaf::on_deactivation::propagate);
+		}
+		BOOST_TEST_EQ(handle(outer, id), 1);
+	}
+
+	// A moved context propagates the E-objects it was moved with, and records
+	// E-objects loaded into it afterwards.
+	{
+		leaf::error_id id1, id2;
+		inner_context inner1;
+		{
+			auto active_inner1 = activate_context(inner1, leaf::on_deactivation::do_not_propagate);
+			id1 = leaf::new_error(info<1>{1});
+		}
+		inner_context inner2(std::move(inner1));
+		outer_context outer;
+		{
+			auto active_outer = activate_context(outer, leaf::on_deactivation::do_not_propagate);
+			auto active_inner2 = activate_context(inner2, leaf::on_deactivation::propagate);
+			id2 = leaf::new_error(info<2>{2});
+		}
+		BOOST_TEST_EQ(handle(outer, id1), 1);
+		BOOST_TEST_EQ(handle(outer, id2), 2);
+	}
+
+	return boost::report_errors();
+}
@@ -0,0 +1,245 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef LEAF_CONTEXT_POOL_SIZE
+#	define LEAF_CONTEXT_POOL_SIZE 16
+#endif
+
+#include <boost/leaf/capture.hpp>
+#include <boost/leaf/handle_error.hpp>
+#include <boost/leaf/result.hpp>
+#include "lightweight_test.hpp"
+#include <vector>
+#ifndef LEAF_NO_THREADS
+#	include <thread>
+#endif
+
+namespace leaf = boost::leaf;
+
+template <int> struct info { int value; };
+
+auto handle_error = []( leaf::error_info const & error )
+{
+	return leaf::remote_handle_all( error,
+		[]( info<1> const & x, info<2> const & y )
+		{
+			return x.value + y.value;
+		},
+		[]( info<1> const & x )
+		{
+			return x.value;
+		},
+		[]
+		{
+			return -1;
+		} );
+};
+
+leaf::result<int> task( int x )
+{
+	if( x==0 )
+		return 0;
+	if( x==1 )
+		return leaf::new_error(info<1>{1}, info<2>{2});
+	return leaf::new_error(info<1>{x});
+}
+
+int run( int x )
+{
+	leaf::result<int> r = leaf::capture(leaf::make_shared_context(&handle_error), &task, x);
+	return leaf::remote_try_handle_all(
+		[&]
+		{
+			return std::move(r);
+		},
+		[]( leaf::error_info const & error )
+		{
+			return handle_error(error);
+		} );
+}
+
+int live_allocations;
+
+template <class T>
+struct stateful_allocator
+{
+	using value_type = T;
+	int id;
+
+	explicit stateful_allocator( int id ) noexcept:
+		id(id)
+	{
+	}
+
+	template <class U>
+	stateful_allocator( stateful_allocator<U> const & x ) noexcept:
+		id(x.id)
+	{
+	}
+
+	T * allocate( std::size_t n )
+	{
+		++live_allocations;
+		return static_cast<T *>(::operator new(n*sizeof(T)));
+	}
+
+	void deallocate( T * p, std::size_t ) noexcept
+	{
+		--live_allocations;
+		::operator delete(p);
+	}
+
+	template <class U>
+	bool operator==( stateful_allocator<U> const & x ) const noexcept
+	{
+		return id==x.id;
+	}
+
+	template <class U>
+	bool operator!=( stateful_allocator<U> const & x ) const noexcept
+	{
+		return id!=x.id;
+	}
+};
+
+template <class T>
+struct stateless_allocator
+{
+	using value_type = T;
+
+	stateless_allocator() noexcept
+	{
+	}
+
+	template <class U>
+	stateless_allocator( stateless_allocator<U> const & ) noexcept
+	{
+	}
+
+	T * allocate( std::size_t n )
+	{
+		++live_allocations;
+		return static_cast<T *>(::operator new(n*sizeof(T)));
+	}
+
+	void deallocate( T * p, std::size_t ) noexcept
+	{
+		--live_allocations;
+		::operator delete(p);
+	}
+
+	template <class U>
+	bool operator==( stateless_allocator<U> const & ) const noexcept
+	{
+		return true;
+	}
+
+	template <class U>
+	bool operator!=( stateless_allocator<U> const & ) const noexcept
+	{
+		return false;
+	}
+};
+
+int main()
+{
+	// Recycled contexts do not carry over E-objects from previous errors.
+	for( int i=0; i!=3; ++i )
+	{
+		BOOST_TEST_EQ(run(1), 3);
+		BOOST_TEST_EQ(run(0), 0);
+		BOOST_TEST_EQ(run(5), 5);
+	}
+
+	// A context is recycled once the last reference to it is dropped.
+	{
+		leaf::polymorphic_context * p;
+		{
+			leaf::context_ptr ctx = leaf::make_shared_context(&handle_error);
+			p = ctx.get();
+		}
+		leaf::context_ptr ctx = leaf::make_shared_context(&handle_error);
+#if LEAF_CONTEXT_POOL_SIZE
+		BOOST_TEST_EQ(ctx.get(), p);
+#else
+		(void) p;
+#endif
+		BOOST_TEST(!ctx->is_active());
+		BOOST_TEST(!ctx->captured_id_);
+	}
+
+	// At most LEAF_CONTEXT_POOL_SIZE blocks are kept; the rest are freed.
+	{
+		live_allocations = 0;
+		{
+			std::vector<leaf::context_ptr> v;
+			for( int i=0; i!=LEAF_CONTEXT_POOL_SIZE+10; ++i )
+				v.push_back(leaf::allocate_shared_context(stateless_allocator<char>(), &handle_error));
+			BOOST_TEST_EQ(live_allocations, LEAF_CONTEXT_POOL_SIZE+10);
+		}
+		BOOST_TEST_EQ(live_allocations, LEAF_CONTEXT_POOL_SIZE);
+#if LEAF_CONTEXT_POOL_SIZE
+		leaf::context_ptr ctx = leaf::allocate_shared_context(stateless_allocator<char>(), &handle_error);
+		BOOST_TEST_EQ(live_allocations, LEAF_CONTEXT_POOL_SIZE);
+#endif
+	}
+
+	// Stateful allocators are not pooled.
+	{
+		int before = live_allocations;
+		{
+			leaf::context_ptr ctx = leaf::allocate_shared_context(stateful_allocator<char>(42), &handle_error);
+			BOOST_TEST_EQ(live_allocations, before+1);
+		}
+		BOOST_TEST_EQ(live_allocations, before);
+	}
+
+#ifndef LEAF_NO_THREADS
+	// Contexts allocated by one thread and freed by another: the freeing thread
+	// keeps at most LEAF_CONTEXT_POOL_SIZE blocks, the rest are freed.
+	{
+		int before = live_allocations;
+		std::vector<leaf::result<int>> results;
+		std::thread producer( [&]
+			{
+				for( int i=0; i!=LEAF_CONTEXT_POOL_SIZE+10; ++i )
+					results.push_back(leaf::capture(leaf::allocate_shared_context(stateless_allocator<char>(), &handle_error), &task, i+1));
+			} );
+		producer.join();
+		BOOST_TEST_EQ(live_allocations, before+LEAF_CONTEXT_POOL_SIZE+10);
+		int sum = 0;
+		for( auto & r : results )
+			sum += leaf::remote_try_handle_all(
+				[&]
+				{
+					return std::move(r);
+				},
+				[]( leaf::error_info const & error )
+				{
+					return handle_error(error);
+				} );
+		BOOST_TEST_EQ(sum, 3 + (LEAF_CONTEXT_POOL_SIZE+10)*(LEAF_CONTEXT_POOL_SIZE+11)/2 - 1);
+		results.clear();
+		BOOST_TEST(live_allocations<=before+LEAF_CONTEXT_POOL_SIZE);
+	}
+
+	// Contexts freed by a thread_local object after the thread's pool is gone.
+	{
+		int before = live_allocations;
+		std::thread t( []
+			{
+				static thread_local std::vector<leaf::context_ptr> late;
+				late.push_back(leaf::allocate_shared_context(stateless_allocator<char>(), &handle_error));
+				late.push_back(leaf::allocate_shared_context(stateless_allocator<char>(), &handle_error));
+				late.clear();
+				late.push_back(leaf::allocate_shared_context(stateless_allocator<char>(), &handle_error));
+			} );
+		t.join();
+		BOOST_TEST_EQ(live_allocations, before);
+	}
+#endif
+
+	return boost::report_errors();
+}
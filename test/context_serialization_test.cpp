@@ -0,0 +1,186 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <boost/leaf/context.hpp>
+#include <boost/leaf/handle_error.hpp>
+#include <boost/leaf/result.hpp>
+#include "lightweight_test.hpp"
+#include <sstream>
+#include <vector>
+
+namespace leaf = boost::leaf;
+
+template <int> struct info { int value; };
+
+struct e_message { std::string value; };
+
+struct not_serializable { int value; };
+
+namespace boost { namespace leaf {
+
+	template <int N>
+	struct serialization<info<N>>: trivial_serialization<info<N>>
+	{
+	};
+
+	template <>
+	struct serialization<e_message>
+	{
+		static void write( serialization_writer & w, e_message const & e )
+		{
+			w.write_string(e.value);
+		}
+
+		static bool read( serialization_reader & r, e_message & e )
+		{
+			return r.read_string(e.value);
+		}
+	};
+
+} }
+
+auto handle_error = []( leaf::error_info const & unmatched )
+{
+	return leaf::remote_handle_all( unmatched,
+		[]( info<1> const & x, info<2> const & y, e_message const & m )
+		{
+			BOOST_TEST_EQ(x.value, 1);
+			BOOST_TEST_EQ(y.value, 2);
+			BOOST_TEST_EQ(m.value, "hello");
+			return 1;
+		},
+		[]( info<1> const & x )
+		{
+			BOOST_TEST_EQ(x.value, 1);
+			return 2;
+		},
+		[]( not_serializable const & )
+		{
+			return 3;
+		},
+		[]
+		{
+			return 4;
+		} );
+};
+
+template <class... E>
+leaf::context_ptr capture( E && ... e )
+{
+	auto ctx = leaf::make_shared_context(&handle_error);
+	ctx->activate();
+	ctx->captured_id_ = leaf::new_error(std::forward<E>(e)...);
+	ctx->deactivate(false);
+	return ctx;
+}
+
+template <class... E>
+std::vector<char> capture_and_serialize( E && ... e )
+{
+	auto ctx = capture(std::forward<E>(e)...);
+	std::size_t size = leaf::serialize(*ctx, 0, 0);
+	std::vector<char> buf(size);
+	BOOST_TEST_EQ(leaf::serialize(*ctx, buf.data(), buf.size()), size);
+	return buf;
+}
+
+int deserialize_and_handle( std::vector<char> const & buf )
+{
+	auto ctx = leaf::make_context(&handle_error);
+	leaf::error_id id = leaf::deserialize(buf.data(), buf.size(), ctx);
+	if( !id )
+		return -1;
+	leaf::result<int> r(id);
+	return ctx.remote_handle_all(r, handle_error);
+}
+
+struct user_context: leaf::polymorphic_context
+{
+	leaf::error_id propagate_captured_errors() noexcept final override { return captured_id_; }
+	void activate() noexcept final override { }
+	void deactivate( bool ) noexcept final override { }
+	bool is_active() const noexcept final override { return false; }
+	void print( std::ostream & ) const final override { }
+};
+
+int main()
+{
+	// Round trip.
+	{
+		std::vector<char> buf = capture_and_serialize(info<1>{1}, info<2>{2}, e_message{"hello"});
+		BOOST_TEST_EQ(deserialize_and_handle(buf), 1);
+	}
+
+	// E-types without a serialization specialization are not serialized.
+	{
+		std::vector<char> buf = capture_and_serialize(info<1>{1}, not_serializable{42});
+		BOOST_TEST_EQ(deserialize_and_handle(buf), 2);
+	}
+
+	// E-types unknown to the receiving context are skipped.
+	{
+		std::vector<char> buf = capture_and_serialize(info<1>{1}, info<2>{2}, e_message{"hello"});
+		leaf::context<info<2>> ctx;
+		leaf::error_id id = leaf::deserialize(buf.data(), buf.size(), ctx);
+		BOOST_TEST(id);
+		leaf::result<int> r(id);
+		int c = ctx.remote_handle_all( r,
+			[]( leaf::error_info const & unmatched )
+			{
+				return leaf::remote_handle_all( unmatched,
+					[]( info<2> const & y )
+					{
+						BOOST_TEST_EQ(y.value, 2);
+						return 1;
+					},
+					[]
+					{
+						return 2;
+					} );
+			} );
+		BOOST_TEST_EQ(c, 1);
+	}
+
+	// A buffer that is too small is not overrun, and the required size is returned.
+	{
+		std::vector<char> full = capture_and_serialize(info<1>{1}, info<2>{2}, e_message{"hello"});
+		auto ctx = capture(info<1>{1}, info<2>{2}, e_message{"hello"});
+		char small[8] = { };
+		BOOST_TEST_EQ(leaf::serialize(*ctx, small, sizeof(small)-1), full.size());
+		BOOST_TEST_EQ(small[sizeof(small)-1], 0);
+	}
+
+	// Malformed input.
+	{
+		std::vector<char> buf = capture_and_serialize(info<1>{1}, info<2>{2}, e_message{"hello"});
+		for( std::size_t n=0; n!=buf.size(); ++n )
+		{
+			std::vector<char> truncated(buf.begin(), buf.begin()+n);
+			BOOST_TEST_EQ(deserialize_and_handle(truncated), -1);
+		}
+		buf[0] = 'X';
+		BOOST_TEST_EQ(deserialize_and_handle(buf), -1);
+	}
+
+	// Nothing is stored from a truncated buffer.
+	{
+		std::vector<char> buf = capture_and_serialize(info<1>{1}, info<2>{2}, e_message{"hello"});
+		buf.pop_back();
+		auto ctx = leaf::make_context(&handle_error);
+		BOOST_TEST(!leaf::deserialize(buf.data(), buf.size(), ctx));
+		std::ostringstream st;
+		ctx.print(st);
+		BOOST_TEST(st.str().empty());
+	}
+
+	// Classes derived from polymorphic_context need not implement serialize.
+	{
+		user_context ctx;
+		char buf[8] = { };
+		BOOST_TEST_EQ(leaf::serialize(ctx, buf, sizeof(buf)), 0);
+	}
+
+	return boost::report_errors();
+}
@@ -0,0 +1,61 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef LEAF_DIAGNOSTICS
+#	define LEAF_DIAGNOSTICS 2
+#endif
+#include <boost/leaf/handle_error.hpp>
+#include <boost/leaf/result.hpp>
+#include "lightweight_test.hpp"
+#include <sstream>
+
+namespace leaf = boost::leaf;
+
+struct info
+{
+	int value;
+};
+
+bool unexpected_info_captured()
+{
+	return leaf::try_handle_all(
+		[]() -> leaf::result<bool>
+		{
+			return leaf::new_error(info{42});
+		},
+		[]( leaf::verbose_diagnostic_info const & di )
+		{
+			std::ostringstream st;
+			st << di;
+			return st.str().find("Unexpected error objects") != std::string::npos;
+		} );
+}
+
+int main()
+{
+#if LEAF_DIAGNOSTICS==2
+	BOOST_TEST(unexpected_info_captured());
+
+	leaf::set_diagnostics_enabled(false);
+	BOOST_TEST(!unexpected_info_captured());
+	BOOST_TEST(!unexpected_info_captured());
+
+	leaf::set_diagnostics_enabled(true);
+	leaf::set_diagnostics_sample_rate(3);
+	int captured = 0;
+	for( int i=0; i!=30; ++i )
+		captured += unexpected_info_captured();
+	BOOST_TEST_EQ(captured, 10);
+
+	leaf::set_diagnostics_sample_rate(1);
+	BOOST_TEST(unexpected_info_captured());
+	BOOST_TEST(unexpected_info_captured());
+#elif LEAF_DIAGNOSTICS
+	BOOST_TEST(unexpected_info_captured());
+#else
+	BOOST_TEST(!unexpected_info_captured());
+#endif
+	return boost::report_errors();
+}
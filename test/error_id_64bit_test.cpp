@@ -0,0 +1,65 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef LEAF_USE_64BIT_ERROR_ID
+#	define LEAF_USE_64BIT_ERROR_ID
+#endif
+#include <boost/leaf/handle_error.hpp>
+#include <boost/leaf/result.hpp>
+#include "lightweight_test.hpp"
+
+namespace leaf = boost::leaf;
+
+struct info { int value; };
+
+leaf::result<int> f( int x )
+{
+	return leaf::new_error(info{x});
+}
+
+int main()
+{
+	static_assert(sizeof(leaf::error_id().value())==8, "Expected 64-bit error IDs");
+
+	// Start just below the point where a 32-bit ID counter would wrap around.
+	leaf::leaf_detail::id_factory<>::counter = (1ull<<32) - 3 - 4*4;
+
+	long long prev = 0;
+	for( int i=0; i!=10; ++i )
+	{
+		leaf::error_id err = leaf::new_error();
+		BOOST_TEST_EQ(err.value()&3, 1);
+		BOOST_TEST_GT(err.value(), prev);
+		prev = err.value();
+
+		std::error_code ec = err.to_error_code();
+		BOOST_TEST(leaf::leaf_detail::is_error_id(ec));
+		BOOST_TEST(leaf::error_id(ec)==err);
+
+		leaf::result<int> r(err);
+		BOOST_TEST(!r);
+		BOOST_TEST(r.error()==err);
+	}
+	BOOST_TEST_GT(prev, 1ll<<32);
+
+	int r = leaf::try_handle_all(
+		[]() -> leaf::result<int>
+		{
+			LEAF_AUTO(x, f(42));
+			return x;
+		},
+		[]( info const & x, leaf::error_info const & ei )
+		{
+			BOOST_TEST_GT(ei.error().value(), 1ll<<32);
+			return x.value;
+		},
+		[]
+		{
+			return -1;
+		} );
+	BOOST_TEST_EQ(r, 42);
+
+	return boost::report_errors();
+}
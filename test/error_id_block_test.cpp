@@ -0,0 +1,65 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#define LEAF_ID_BLOCK_SIZE 8
+#include <boost/leaf/error.hpp>
+#include "lightweight_test.hpp"
+#include <future>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+
+namespace leaf = boost::leaf;
+
+constexpr int ids_per_thread = 10001;
+
+std::vector<int> generate_ids()
+{
+	std::vector<int> ids;
+	ids.reserve(ids_per_thread);
+	for(int i=0; i!=ids_per_thread; ++i)
+	{
+		int id = leaf::new_error().value();
+		BOOST_TEST_EQ(id&3, 1);
+		if( i%LEAF_ID_BLOCK_SIZE )
+			BOOST_TEST_EQ(id, ids.back()+4);
+		ids.push_back(id);
+	}
+	return ids;
+}
+
+int main()
+{
+	BOOST_TEST_EQ(leaf::new_error().value(), 1);
+	BOOST_TEST_EQ(leaf::new_error().value(), 5);
+	BOOST_TEST_EQ(leaf::next_error().value(), 9);
+	BOOST_TEST_EQ(leaf::new_error().value(), 9);
+#ifdef LEAF_NO_THREADS
+	std::vector<int> all_ids = generate_ids();
+#else
+	constexpr int thread_count = 100;
+	using thread_ids = std::future<std::vector<int>>;
+	std::vector<thread_ids> fut;
+	fut.reserve(thread_count);
+	std::generate_n(
+		std::inserter(fut,fut.end()),
+		thread_count,
+		[=]
+		{
+			return std::async(std::launch::async, &generate_ids);
+		});
+	std::vector<int> all_ids;
+	for(auto & f : fut)
+	{
+		auto fv = f.get();
+		all_ids.insert(all_ids.end(), fv.begin(), fv.end());
+	}
+#endif
+	all_ids.push_back(leaf::new_error().value());
+	std::sort(all_ids.begin(), all_ids.end());
+	auto u = std::unique(all_ids.begin(), all_ids.end());
+	BOOST_TEST(u==all_ids.end());
+	return boost::report_errors();
+}
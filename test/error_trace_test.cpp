@@ -0,0 +1,134 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#define LEAF_ERROR_TRACE_CAPACITY 4
+#include <boost/leaf/preload.hpp>
+#include <boost/leaf/handle_error.hpp>
+#include <boost/leaf/result.hpp>
+#include "lightweight_test.hpp"
+#include <sstream>
+#include <cstring>
+
+namespace leaf = boost::leaf;
+
+int const first_line = __LINE__;
+
+leaf::result<void> f( int depth )
+{
+	LEAF_ERROR_TRACE;
+	if( depth==0 )
+		return leaf::new_error();
+	return f(depth-1);
+}
+
+leaf::result<void> g()
+{
+	LEAF_ERROR_TRACE;
+	return f(0);
+}
+
+leaf::result<void> h()
+{
+	LEAF_ERROR_TRACE;
+	return { };
+}
+
+int main()
+{
+	BOOST_TEST_EQ(leaf::e_error_trace::capacity(), 4);
+
+	{
+		leaf::e_error_trace tr;
+		BOOST_TEST_EQ(tr.size(), 0);
+		BOOST_TEST_EQ(tr.dropped(), 0);
+		for( int i=0; i!=6; ++i )
+			tr.push("file", i, "function");
+		BOOST_TEST_EQ(tr.size(), 4);
+		BOOST_TEST_EQ(tr.dropped(), 2);
+		for( int i=0; i!=4; ++i )
+			BOOST_TEST_EQ(tr[i].line, i+2);
+		leaf::e_error_trace c(tr);
+		BOOST_TEST_EQ(c.size(), 4);
+		BOOST_TEST_EQ(c.dropped(), 2);
+		for( int i=0; i!=4; ++i )
+			BOOST_TEST_EQ(c[i].line, i+2);
+		leaf::e_error_trace a;
+		a.push("file", 7, "function");
+		c = a;
+		BOOST_TEST_EQ(c.size(), 1);
+		BOOST_TEST_EQ(c[0].line, 7);
+	}
+
+	{
+		int r = leaf::try_handle_all(
+			[]() -> leaf::result<int>
+			{
+				LEAF_CHECK(g());
+				return 0;
+			},
+			[]( leaf::e_error_trace const & tr )
+			{
+				BOOST_TEST_EQ(tr.size(), 2);
+				BOOST_TEST_EQ(tr.dropped(), 0);
+				BOOST_TEST_EQ(tr[0].line, first_line+4);
+				BOOST_TEST_EQ(tr[1].line, first_line+12);
+				BOOST_TEST(std::strstr(tr[0].function, "f")!=0);
+				BOOST_TEST(std::strstr(tr[1].function, "g")!=0);
+				BOOST_TEST(std::strstr(tr[0].file, "error_trace_test.cpp")!=0);
+				std::ostringstream s;
+				s << tr;
+				BOOST_TEST(s.str().find("error_trace_test.cpp")!=std::string::npos);
+				return 1;
+			},
+			[]
+			{
+				return 2;
+			} );
+		BOOST_TEST_EQ(r, 1);
+	}
+
+	{
+		int r = leaf::try_handle_all(
+			[]() -> leaf::result<int>
+			{
+				LEAF_CHECK(f(10));
+				return 0;
+			},
+			[]( leaf::e_error_trace const & tr )
+			{
+				BOOST_TEST_EQ(tr.size(), 4);
+				BOOST_TEST_EQ(tr.dropped(), 7);
+				std::ostringstream s;
+				s << tr;
+				BOOST_TEST(s.str().find("7 oldest records dropped")!=std::string::npos);
+				return 1;
+			},
+			[]
+			{
+				return 2;
+			} );
+		BOOST_TEST_EQ(r, 1);
+	}
+
+	{
+		int r = leaf::try_handle_all(
+			[]() -> leaf::result<int>
+			{
+				LEAF_CHECK(h());
+				return 0;
+			},
+			[]( leaf::e_error_trace const & )
+			{
+				return 1;
+			},
+			[]
+			{
+				return 2;
+			} );
+		BOOST_TEST_EQ(r, 0);
+	}
+
+	return boost::report_errors();
+}
@@ -0,0 +1,128 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <boost/leaf/config.hpp>
+#ifdef LEAF_NO_EXCEPTIONS
+
+#include <iostream>
+
+int main()
+{
+	std::cout << "Unit test not applicable." << std::endl;
+	return 0;
+}
+
+#else
+
+#include <boost/leaf/handle_exception.hpp>
+#include <boost/leaf/capture.hpp>
+#include <boost/leaf/result.hpp>
+#include "lightweight_test.hpp"
+
+namespace leaf = boost::leaf;
+
+struct base: virtual std::exception { int value = 0; };
+template <int N> struct ex: base { ex() { value = N; } };
+struct ex12: ex<1>, ex<2> { };
+struct other: std::exception { };
+
+template <class Ex>
+int handle( Ex const & e )
+{
+	return leaf::try_catch(
+		[&]() -> int
+		{
+			throw e;
+		},
+		[]( leaf::catch_<ex<1>> x )
+		{
+			BOOST_TEST_EQ(x.value().value, 1);
+			return 1;
+		},
+		[]( leaf::catch_<ex<2>, ex<3>> x )
+		{
+			return 23;
+		},
+		[]( leaf::catch_<base> x )
+		{
+			return 10 + x.value().value;
+		},
+		[]( leaf::catch_<> )
+		{
+			return 0;
+		} );
+}
+
+template <class Ex>
+int to_result( Ex const & e )
+{
+	return leaf::try_handle_all(
+		[&]
+		{
+			return leaf::exception_to_result<ex<1>, ex<2>, other>(
+				[&]() -> int
+				{
+					throw e;
+				} );
+		},
+		[]( ex<1> const & x1, ex<2> const & x2 )
+		{
+			BOOST_TEST_EQ(x1.value, 1);
+			BOOST_TEST_EQ(x2.value, 2);
+			return 12;
+		},
+		[]( ex<1> const & x )
+		{
+			BOOST_TEST_EQ(x.value, 1);
+			return 1;
+		},
+		[]( ex<2> const & x )
+		{
+			BOOST_TEST_EQ(x.value, 2);
+			return 2;
+		},
+		[]( other const & )
+		{
+			return 3;
+		},
+		[]
+		{
+			return 0;
+		} );
+}
+
+int main()
+{
+	// The same exception types, repeatedly and in different order, so that
+	// both cached and uncached results are used.
+	for( int i=0; i!=3; ++i )
+	{
+		BOOST_TEST_EQ(handle(ex<1>()), 1);
+		BOOST_TEST_EQ(handle(ex<1>()), 1);
+		BOOST_TEST_EQ(handle(ex<2>()), 23);
+		BOOST_TEST_EQ(handle(ex<3>()), 23);
+		BOOST_TEST_EQ(handle(ex<4>()), 14);
+		BOOST_TEST_EQ(handle(ex<4>()), 14);
+		BOOST_TEST_EQ(handle(other()), 0);
+		BOOST_TEST_EQ(handle(ex<3>()), 23);
+		BOOST_TEST_EQ(handle(ex<1>()), 1);
+	}
+
+	for( int i=0; i!=3; ++i )
+	{
+		BOOST_TEST_EQ(to_result(ex<1>()), 1);
+		BOOST_TEST_EQ(to_result(ex<2>()), 2);
+		BOOST_TEST_EQ(to_result(ex<2>()), 2);
+		BOOST_TEST_EQ(to_result(ex12()), 12);
+		BOOST_TEST_EQ(to_result(ex12()), 12);
+		BOOST_TEST_EQ(to_result(ex<3>()), 0);
+		BOOST_TEST_EQ(to_result(other()), 3);
+		BOOST_TEST_EQ(to_result(ex<1>()), 1);
+	}
+
+	return boost::report_errors();
+}
+
+#endif
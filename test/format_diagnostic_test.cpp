@@ -0,0 +1,103 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <boost/leaf/handle_error.hpp>
+#include <boost/leaf/common.hpp>
+#include <boost/leaf/result.hpp>
+#include "lightweight_test.hpp"
+#include <sstream>
+#include <cstring>
+
+namespace leaf = boost::leaf;
+
+template <int N>
+struct info
+{
+	int value;
+};
+
+struct sync_counter: std::stringbuf
+{
+	int syncs = 0;
+
+	int sync() override
+	{
+		++syncs;
+		return std::stringbuf::sync();
+	}
+};
+
+template <class Info>
+void test( Info const & x )
+{
+	std::ostringstream st;
+	st << x;
+	std::string const expected = st.str();
+	BOOST_TEST(!expected.empty());
+
+	{
+		sync_counter sb;
+		std::ostream os(&sb);
+		os << x;
+		BOOST_TEST_EQ(sb.syncs, 0);
+		BOOST_TEST_EQ(sb.str(), expected);
+	}
+
+	{
+		char buf[4096];
+		std::size_t n = leaf::format_to_buffer(buf, sizeof(buf), x);
+		BOOST_TEST_EQ(n, expected.size());
+		BOOST_TEST_EQ(std::strlen(buf), n);
+		BOOST_TEST_EQ(std::string(buf), expected);
+	}
+
+	{
+		char buf[16];
+		std::size_t n = leaf::format_to_buffer(buf, sizeof(buf), x);
+		BOOST_TEST_EQ(n, sizeof(buf)-1);
+		BOOST_TEST_EQ(std::string(buf), expected.substr(0, sizeof(buf)-1));
+	}
+
+	{
+		std::string s;
+		int calls = 0;
+		leaf::format_to_sink(
+			[&]( char const * p, std::size_t n )
+			{
+				BOOST_TEST_GT(n, 0);
+				++calls;
+				s.append(p, n);
+			}, x );
+		BOOST_TEST_EQ(s, expected);
+		BOOST_TEST_GT(calls, 0);
+	}
+}
+
+leaf::result<void> f()
+{
+	std::string long_string(2000, 'x');
+	return leaf::new_error(info<1>{1}, info<2>{2}, info<3>{3}, leaf::e_file_name{long_string});
+}
+
+int main()
+{
+	leaf::try_handle_all(
+		[]
+		{
+			return f();
+		},
+		[]( info<1> const &, leaf::error_info const & ei, leaf::diagnostic_info const & di, leaf::verbose_diagnostic_info const & vdi )
+		{
+			test(ei);
+			test(di);
+			test(vdi);
+		},
+		[]
+		{
+			BOOST_TEST(false);
+		} );
+
+	return boost::report_errors();
+}
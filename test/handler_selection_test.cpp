@@ -0,0 +1,101 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#define LEAF_HANDLER_PRESENCE_MASK
+#include <boost/leaf/handle_error.hpp>
+#include <boost/leaf/result.hpp>
+#include "lightweight_test.hpp"
+
+namespace leaf = boost::leaf;
+
+template <int> struct info { int value; };
+
+template <int... I>
+struct int_seq
+{
+};
+
+template <int N, int... I>
+struct make_int_seq: make_int_seq<N-1, N-1, I...>
+{
+};
+
+template <int... I>
+struct make_int_seq<0, I...>
+{
+	using type = int_seq<I...>;
+};
+
+template <class Seq>
+struct context_of;
+
+template <int... I>
+struct context_of<int_seq<I...>>
+{
+	using type = leaf::context<info<I>...>;
+};
+
+// More E-types than there are bits in the presence mask.
+using big_context = context_of<make_int_seq<70>::type>::type;
+
+template <class... E>
+int handle( E && ... e )
+{
+	big_context ctx;
+	leaf::error_id id;
+	{
+		auto active_context = activate_context(ctx, leaf::on_deactivation::do_not_propagate);
+		id = leaf::new_error(std::forward<E>(e)...);
+	}
+	leaf::result<int> r(id);
+	return ctx.handle_all( r,
+		[]( info<1> const &, info<65> const & )
+		{
+			return 1;
+		},
+		[]( leaf::match<info<66>, 1, 2> )
+		{
+			return 2;
+		},
+		[]( info<2> const & x, info<66> const & )
+		{
+			BOOST_TEST_EQ(x.value, 2);
+			return 3;
+		},
+		[]( info<1> const & x )
+		{
+			BOOST_TEST_EQ(x.value, 1);
+			return 4;
+		},
+		[]( info<69> const & x, info<3> const * y )
+		{
+			BOOST_TEST_EQ(x.value, 69);
+			return y ? 5 : 6;
+		},
+		[]( leaf::match<info<0>, 7> )
+		{
+			return 7;
+		},
+		[]
+		{
+			return 8;
+		} );
+}
+
+int main()
+{
+	BOOST_TEST_EQ(handle(info<1>{1}, info<65>{65}), 1);
+	BOOST_TEST_EQ(handle(info<1>{1}, info<66>{1}), 2);
+	BOOST_TEST_EQ(handle(info<1>{1}, info<2>{2}, info<66>{3}), 3);
+	BOOST_TEST_EQ(handle(info<2>{2}, info<66>{2}), 2);
+	BOOST_TEST_EQ(handle(info<1>{1}, info<66>{3}), 4);
+	BOOST_TEST_EQ(handle(info<69>{69}, info<3>{3}), 5);
+	BOOST_TEST_EQ(handle(info<69>{69}), 6);
+	BOOST_TEST_EQ(handle(info<0>{7}), 7);
+	BOOST_TEST_EQ(handle(info<0>{1}), 8);
+	BOOST_TEST_EQ(handle(info<65>{65}), 8);
+	BOOST_TEST_EQ(handle(), 8);
+	return boost::report_errors();
+}
@@ -0,0 +1,98 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <boost/leaf/handle_error.hpp>
+#include <boost/leaf/result.hpp>
+#include "lightweight_test.hpp"
+
+namespace leaf = boost::leaf;
+
+template <int> struct info { int value; };
+
+int main()
+{
+	BOOST_TEST(!leaf::is_handled<info<1>>());
+	BOOST_TEST(!leaf::is_handled<info<2>>());
+
+	{
+		int r = leaf::try_handle_all(
+			[]() -> leaf::result<int>
+			{
+				BOOST_TEST(leaf::is_handled<info<1>>());
+				BOOST_TEST(leaf::is_handled<info<1> const &>());
+				BOOST_TEST(!leaf::is_handled<info<2>>());
+				return leaf::try_handle_some(
+					[]() -> leaf::result<int>
+					{
+						BOOST_TEST(leaf::is_handled<info<1>>());
+						BOOST_TEST(leaf::is_handled<info<2>>());
+						int called1 = 0, called2 = 0;
+						leaf::if_handled<info<1>>( [&] { ++called1; } );
+						leaf::if_handled<info<3>>( [&] { ++called2; } );
+						BOOST_TEST_EQ(called1, 1);
+						BOOST_TEST_EQ(called2, 0);
+						return leaf::new_error(info<1>{42});
+					},
+					[]( info<2> const & ) -> leaf::result<int>
+					{
+						return 2;
+					} );
+			},
+			[]( info<1> const & x )
+			{
+				return x.value;
+			},
+			[]
+			{
+				return -1;
+			} );
+		BOOST_TEST_EQ(r, 42);
+	}
+
+	BOOST_TEST(!leaf::is_handled<info<1>>());
+	BOOST_TEST(!leaf::is_handled<info<2>>());
+
+	{
+		int r = leaf::try_handle_all(
+			[]() -> leaf::result<int>
+			{
+				BOOST_TEST(!leaf::is_handled<info<1>>());
+				return leaf::new_error();
+			},
+			[]( leaf::diagnostic_info const & )
+			{
+				return 1;
+			} );
+		BOOST_TEST_EQ(r, 1);
+	}
+
+	{
+		int r = leaf::try_handle_all(
+			[]() -> leaf::result<int>
+			{
+#if LEAF_DIAGNOSTICS
+				BOOST_TEST(leaf::is_handled<info<1>>());
+#else
+				BOOST_TEST(!leaf::is_handled<info<1>>());
+#endif
+				int called = 0;
+				leaf::if_handled<info<1>>( [&] { ++called; } );
+				BOOST_TEST_EQ(called, LEAF_DIAGNOSTICS ? 1 : 0);
+				return leaf::new_error(
+					[&]
+					{
+						++called;
+						return info<1>{1};
+					} );
+			},
+			[]( leaf::verbose_diagnostic_info const & )
+			{
+				return 1;
+			} );
+		BOOST_TEST_EQ(r, 1);
+	}
+
+	return boost::report_errors();
+}
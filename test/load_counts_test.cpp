@@ -0,0 +1,136 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#define LEAF_COUNT_LOADS
+#include <boost/leaf/handle_error.hpp>
+#include <boost/leaf/preload.hpp>
+#include <boost/leaf/result.hpp>
+#include "lightweight_test.hpp"
+
+namespace leaf = boost::leaf;
+
+template <int N>
+struct info
+{
+	int value;
+};
+
+template <class E>
+leaf::load_count get_count()
+{
+	for( auto const & c : leaf::get_load_counts() )
+		if( c.type==leaf::type<E>() )
+			return c;
+	leaf::load_count c = { leaf::type<E>(), 0, 0, 0 };
+	return c;
+}
+
+template <class E>
+void check( unsigned long kept, unsigned long discarded, unsigned long unexpected )
+{
+	leaf::load_count c = get_count<E>();
+	BOOST_TEST_EQ(c.kept, kept);
+	BOOST_TEST_EQ(c.discarded, discarded);
+	BOOST_TEST_EQ(c.unexpected, unexpected);
+}
+
+leaf::result<int> f()
+{
+	auto load = leaf::preload(info<3>{3});
+	return leaf::new_error(info<1>{1}, info<2>{2}, []{ return info<4>{4}; });
+}
+
+leaf::result<int> g()
+{
+	auto load = leaf::preload(info<5>{5});
+	auto acc = leaf::accumulate([]( info<6> & x ) { ++x.value; });
+	return leaf::new_error(info<5>{1});
+}
+
+int main()
+{
+	BOOST_TEST(leaf::get_load_counts().empty());
+
+	(void) f();
+	check<info<1>>(0, 1, 0);
+	check<info<2>>(0, 1, 0);
+	check<info<3>>(0, 1, 0);
+	check<info<4>>(0, 1, 0);
+
+	for( int i=0; i!=2; ++i )
+	{
+		int r = leaf::try_handle_all(
+			[]
+			{
+				return f();
+			},
+			[]( info<1> const & x, info<3> const & )
+			{
+				return x.value;
+			},
+			[]
+			{
+				return -1;
+			} );
+		BOOST_TEST_EQ(r, 1);
+	}
+	check<info<1>>(2, 1, 0);
+	check<info<2>>(0, 3, 0);
+	check<info<3>>(2, 1, 0);
+	check<info<4>>(0, 3, 0);
+
+	{
+		int r = leaf::try_handle_all(
+			[]
+			{
+				return f();
+			},
+			[]( leaf::diagnostic_info const & )
+			{
+				return 1;
+			} );
+		BOOST_TEST_EQ(r, 1);
+	}
+#if LEAF_DIAGNOSTICS
+	check<info<1>>(2, 1, 1);
+	check<info<2>>(0, 3, 1);
+#else
+	check<info<1>>(2, 2, 0);
+	check<info<2>>(0, 4, 0);
+#endif
+
+	BOOST_TEST_EQ(leaf::get_load_counts().size(), 4);
+	leaf::reset_load_counts();
+	check<info<1>>(0, 0, 0);
+	check<info<4>>(0, 0, 0);
+	BOOST_TEST_EQ(leaf::get_load_counts().size(), 4);
+
+	(void) g();
+	check<info<5>>(0, 2, 0);
+	check<info<6>>(0, 1, 0);
+
+	{
+		int r = leaf::try_handle_all(
+			[]
+			{
+				return g();
+			},
+			[]( info<5> const & x, info<6> const & y )
+			{
+				return x.value + y.value;
+			},
+			[]
+			{
+				return -1;
+			} );
+		BOOST_TEST_EQ(r, 2);
+	}
+	// The preloaded info<5> is discarded, because new_error already stored one.
+	check<info<5>>(1, 3, 0);
+	check<info<6>>(1, 1, 0);
+	BOOST_TEST_EQ(leaf::get_load_counts().size(), 6);
+
+	return boost::report_errors();
+}
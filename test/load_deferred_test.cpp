@@ -0,0 +1,83 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <boost/leaf/handle_error.hpp>
+#include <boost/leaf/result.hpp>
+#include "lightweight_test.hpp"
+
+namespace leaf = boost::leaf;
+
+template <int>
+struct info
+{
+	int value;
+};
+
+int call_count = 0;
+
+template <int N>
+info<N> make_info()
+{
+	++call_count;
+	return info<N>{N};
+}
+
+leaf::result<int> f()
+{
+	return leaf::new_error( &make_info<1>, []{ ++call_count; return info<2>{2}; }, info<3>{3} );
+}
+
+int main()
+{
+	{
+		call_count = 0;
+		leaf::error_id err = leaf::new_error( &make_info<1>, []{ ++call_count; return info<2>{2}; } );
+		BOOST_TEST(err);
+		BOOST_TEST_EQ(call_count, 0);
+	}
+	{
+		call_count = 0;
+		int r = leaf::try_handle_all(
+			[]
+			{
+				return f();
+			},
+			[]( info<1> const & x1, info<3> const & x3 )
+			{
+				BOOST_TEST_EQ(x1.value, 1);
+				BOOST_TEST_EQ(x3.value, 3);
+				return 1;
+			},
+			[]
+			{
+				return 2;
+			} );
+		BOOST_TEST_EQ(r, 1);
+		BOOST_TEST_EQ(call_count, 1);
+	}
+	{
+		call_count = 0;
+		int r = leaf::try_handle_all(
+			[]() -> leaf::result<int>
+			{
+				leaf::result<int> r = f();
+				return r.load( []{ ++call_count; return info<4>{4}; } );
+			},
+			[]( info<1> const & x1, info<2> const & x2, info<4> const & x4 )
+			{
+				BOOST_TEST_EQ(x1.value, 1);
+				BOOST_TEST_EQ(x2.value, 2);
+				BOOST_TEST_EQ(x4.value, 4);
+				return 1;
+			},
+			[]
+			{
+				return 2;
+			} );
+		BOOST_TEST_EQ(r, 1);
+		BOOST_TEST_EQ(call_count, 3);
+	}
+	return boost::report_errors();
+}
@@ -0,0 +1,76 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef LEAF_MATCH_LOOKUP_TABLE_MIN
+#	define LEAF_MATCH_LOOKUP_TABLE_MIN 4
+#endif
+#include <boost/leaf/handle_error.hpp>
+#include "lightweight_test.hpp"
+#include <climits>
+
+namespace leaf = boost::leaf;
+
+enum class protocol_error
+{
+	first = -10,
+	last = 250
+};
+
+struct e_code
+{
+	int value;
+};
+
+struct e_unsigned
+{
+	unsigned long long value;
+};
+
+template <class Match, class T, class... V>
+bool check( T x, V... v )
+{
+	bool expected = false;
+	for( T y : { T(v)... } )
+		expected = expected || x==y;
+	Match m(&x);
+	return m()==expected;
+}
+
+int main()
+{
+	// More than 64 possible values: a lookup table with several words.
+	{
+		using m = leaf::match<protocol_error, protocol_error(-10), protocol_error(0), protocol_error(63), protocol_error(64), protocol_error(200), protocol_error(250)>;
+		static_assert(leaf::leaf_detail::use_enumerator_bitset<protocol_error, protocol_error, protocol_error(-10), protocol_error(0), protocol_error(63), protocol_error(64), protocol_error(200), protocol_error(250)>::value==(LEAF_MATCH_LOOKUP_TABLE_MIN!=0 && LEAF_MATCH_LOOKUP_TABLE_MIN<=6), "Expected a lookup table");
+		for( int i=-20; i!=260; ++i )
+			BOOST_TEST(check<m>(protocol_error(i), -10, 0, 63, 64, 200, 250));
+	}
+
+	// Negative values in a single word.
+	{
+		using m = leaf::match<e_code, -30, -3, 0, 7, 20>;
+		for( int i=-40; i!=40; ++i )
+			BOOST_TEST(check<m>(i, -30, -3, 0, 7, 20));
+		BOOST_TEST(check<m>(INT_MIN, -30, -3, 0, 7, 20));
+		BOOST_TEST(check<m>(INT_MAX, -30, -3, 0, 7, 20));
+	}
+
+	// Unsigned values at both ends of the range.
+	{
+		using m = leaf::match<e_unsigned, 0ull, 1ull, ULLONG_MAX-1, ULLONG_MAX>;
+		for( unsigned long long i : { 0ull, 1ull, 2ull, 3ull, ULLONG_MAX-3, ULLONG_MAX-2, ULLONG_MAX-1, ULLONG_MAX, ULLONG_MAX/2, ULLONG_MAX/2+1 } )
+			BOOST_TEST(check<m>(i, 0ull, 1ull, ULLONG_MAX-1, ULLONG_MAX));
+	}
+
+	// Sparse values are checked one by one.
+	{
+		using m = leaf::match<e_code, INT_MIN, -1000000, 0, 1000000, INT_MAX>;
+		static_assert(!leaf::leaf_detail::use_enumerator_bitset<int, int, INT_MIN, -1000000, 0, 1000000, INT_MAX>::value, "Expected a chain of comparisons");
+		for( int i : { INT_MIN, INT_MIN+1, -1000000, -1, 0, 1, 1000000, INT_MAX-1, INT_MAX } )
+			BOOST_TEST(check<m>(i, INT_MIN, -1000000, 0, 1000000, INT_MAX));
+	}
+
+	return boost::report_errors();
+}
@@ -0,0 +1,118 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <boost/leaf/result.hpp>
+#include <boost/leaf/capture.hpp>
+#include <boost/leaf/handle_error.hpp>
+#include "lightweight_test.hpp"
+#include <type_traits>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+namespace leaf = boost::leaf;
+
+struct info { int value; };
+
+static_assert(std::is_trivially_copyable<leaf::nocapture_result<int>>::value, "nocapture_result<int> should be trivially copyable");
+static_assert(std::is_trivially_copyable<leaf::nocapture_result<float>>::value, "nocapture_result<float> should be trivially copyable");
+static_assert(std::is_trivially_copyable<leaf::nocapture_result<void>>::value, "nocapture_result<void> should be trivially copyable");
+static_assert(std::is_trivially_destructible<leaf::nocapture_result<std::uint64_t>>::value, "nocapture_result<std::uint64_t> should be trivially destructible");
+static_assert(!std::is_trivially_copyable<leaf::nocapture_result<std::string>>::value, "nocapture_result<std::string> should not be trivially copyable");
+static_assert(!std::is_constructible<leaf::nocapture_result<int>, leaf::context_ptr &&>::value, "nocapture_result<int> should not hold a context");
+static_assert(!std::is_constructible<leaf::nocapture_result<int>, leaf::result<int, leaf::context_ptr> &&>::value, "nocapture_result<int> should not be initialized from a result<int, context_ptr>");
+static_assert(std::is_constructible<leaf::result<int>, leaf::nocapture_result<int> &&>::value, "result<int> should be initialized from a nocapture_result<int>");
+static_assert(leaf::is_result_type<leaf::nocapture_result<int>>::value, "nocapture_result<int> should be a result type");
+
+leaf::nocapture_result<int> f( int x )
+{
+	if( x<0 )
+		return leaf::new_error(info{x});
+	else
+		return x;
+}
+
+leaf::nocapture_result<float> g( int x )
+{
+	LEAF_AUTO(y, f(x));
+	return float(y) / 2;
+}
+
+leaf::result<void> h( int x )
+{
+	LEAF_CHECK(g(x));
+	return { };
+}
+
+int main()
+{
+	{
+		leaf::nocapture_result<float> r = g(42);
+		BOOST_TEST(r);
+		BOOST_TEST_EQ(r.value(), 21.0f);
+	}
+	{
+		int r = leaf::try_handle_all(
+			[]() -> leaf::nocapture_result<int>
+			{
+				LEAF_CHECK(h(-42));
+				return 0;
+			},
+			[]( info const & x )
+			{
+				return x.value;
+			},
+			[]
+			{
+				return 1;
+			} );
+		BOOST_TEST_EQ(r, -42);
+	}
+	{
+		std::vector<leaf::nocapture_result<std::uint64_t>> v;
+		for( int i=0; i!=100; ++i )
+			if( i%3 )
+				v.push_back(std::uint64_t(i));
+			else
+				v.push_back(leaf::new_error(info{i}));
+		for( int i=0; i!=100; ++i )
+			if( i%3 )
+				BOOST_TEST_EQ(v[i].value(), std::uint64_t(i));
+			else
+				BOOST_TEST(!v[i]);
+		leaf::nocapture_result<std::uint64_t> r = std::uint64_t(0);
+		std::memcpy(&r, &v[6], sizeof(r));
+		BOOST_TEST(!r);
+		BOOST_TEST_EQ(r.get_error_id(), v[6].get_error_id());
+	}
+
+	// A captured context returned from a function which returns a
+	// nocapture_result is propagated to the active contexts.
+	{
+		int r = leaf::try_handle_all(
+			[]() -> leaf::nocapture_result<int>
+			{
+				leaf::result<int, leaf::context_ptr> cr = leaf::capture(
+					std::make_shared<leaf::leaf_detail::polymorphic_context_impl<leaf::context<info>>>(),
+					[]() -> leaf::result<int, leaf::context_ptr>
+					{
+						return f(-7);
+					} );
+				BOOST_TEST(!cr);
+				LEAF_AUTO(x, cr);
+				return x;
+			},
+			[]( info const & x )
+			{
+				return x.value;
+			},
+			[]
+			{
+				return 1;
+			} );
+		BOOST_TEST_EQ(r, -7);
+	}
+	return boost::report_errors();
+}
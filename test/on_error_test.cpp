@@ -0,0 +1,143 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <boost/leaf/preload.hpp>
+#include <boost/leaf/handle_error.hpp>
+#include <boost/leaf/result.hpp>
+#ifndef LEAF_NO_EXCEPTIONS
+#	include <boost/leaf/handle_exception.hpp>
+#	include <boost/leaf/exception.hpp>
+#endif
+#include "lightweight_test.hpp"
+
+namespace leaf = boost::leaf;
+
+template <int>
+struct info
+{
+	int value;
+};
+
+int global;
+
+int get_global() noexcept
+{
+	return global;
+}
+
+template <class... E>
+auto make_guard( E && ... e ) -> decltype(leaf::on_error(std::forward<E>(e)...))
+{
+	auto guard = leaf::on_error(std::forward<E>(e)...);
+	return guard;
+}
+
+leaf::result<void> g( bool fail )
+{
+	global = 0;
+	info<0> i0{0};
+	auto guard = leaf::on_error(
+		i0,
+		info<1>{1},
+		[]{ return info<2>{get_global()}; },
+		[]( info<3> & x ){ ++x.value; } );
+	global = 2;
+	if( fail )
+		return leaf::new_error(info<3>{2});
+	return { };
+}
+
+leaf::result<void> f( bool fail )
+{
+	auto guard = make_guard( []( info<3> & x ){ x.value *= 10; }, info<4>{4} );
+	return g(fail);
+}
+
+int handle( bool fail )
+{
+	return leaf::try_handle_all(
+		[=]() -> leaf::result<int>
+		{
+			LEAF_CHECK(f(fail));
+			return 0;
+		},
+		[]( info<0> i0, info<1> i1, info<2> i2, info<3> i3, info<4> i4 )
+		{
+			BOOST_TEST_EQ(i0.value, 0);
+			BOOST_TEST_EQ(i1.value, 1);
+			BOOST_TEST_EQ(i2.value, 2);
+			BOOST_TEST_EQ(i3.value, 30);
+			BOOST_TEST_EQ(i4.value, 4);
+			return 1;
+		},
+		[]
+		{
+			return 2;
+		} );
+}
+
+#ifndef LEAF_NO_EXCEPTIONS
+
+void h()
+{
+	auto guard = leaf::on_error( info<1>{1}, []{ return info<2>{2}; }, []( info<3> & x ){ x.value = 3; } );
+	throw std::exception();
+}
+
+#endif
+
+int main()
+{
+	BOOST_TEST_EQ(handle(true), 1);
+	BOOST_TEST_EQ(handle(false), 0);
+
+	{
+		// Nothing is loaded if the scope exits without an error.
+		leaf::context<info<1>> ctx;
+		leaf::error_id id;
+		{
+			auto active_context = activate_context(ctx, leaf::on_deactivation::do_not_propagate);
+			{
+				auto guard = leaf::on_error(info<1>{1});
+			}
+			id = leaf::new_error();
+		}
+		leaf::result<int> r(id);
+		BOOST_TEST_EQ(ctx.handle_all( r,
+			[]( info<1> const & )
+			{
+				return 1;
+			},
+			[]
+			{
+				return 2;
+			} ), 2);
+	}
+
+#ifndef LEAF_NO_EXCEPTIONS
+	{
+		int r = leaf::try_catch(
+			[]
+			{
+				h();
+				return 0;
+			},
+			[]( info<1> i1, info<2> i2, info<3> i3 )
+			{
+				BOOST_TEST_EQ(i1.value, 1);
+				BOOST_TEST_EQ(i2.value, 2);
+				BOOST_TEST_EQ(i3.value, 3);
+				return 1;
+			},
+			[]
+			{
+				return 2;
+			} );
+		BOOST_TEST_EQ(r, 1);
+	}
+#endif
+
+	return boost::report_errors();
+}
@@ -0,0 +1,82 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <boost/leaf/config.hpp>
+#ifdef LEAF_NO_EXCEPTIONS
+
+#include <iostream>
+
+int main()
+{
+	std::cout << "Unit test not applicable." << std::endl;
+	return 0;
+}
+
+#else
+
+#include <boost/leaf/preload.hpp>
+#include <boost/leaf/handle_exception.hpp>
+#include <boost/leaf/exception.hpp>
+#include "lightweight_test.hpp"
+
+namespace leaf = boost::leaf;
+
+template <int A>
+struct info
+{
+	int value;
+};
+
+void g()
+{
+	int r = leaf::try_catch(
+		[]
+		{
+			throw leaf::exception(std::exception(), info<1>{1});
+			return 0;
+		},
+		[]( info<1> x )
+		{
+			BOOST_TEST_EQ(x.value, 1);
+			return 1;
+		} );
+	BOOST_TEST_EQ(r, 1);
+	BOOST_TEST_EQ(leaf::leaf_detail::last_id(), 0);
+}
+
+void f()
+{
+	auto load = leaf::preload( info<2>{2} );
+	g();
+	throw std::exception();
+}
+
+int main()
+{
+	int r = leaf::try_catch(
+		[]
+		{
+			f();
+			return 0;
+		},
+		[]( info<1> )
+		{
+			return 1;
+		},
+		[]( info<2> x )
+		{
+			BOOST_TEST_EQ(x.value, 2);
+			return 2;
+		},
+		[]
+		{
+			return 3;
+		} );
+	BOOST_TEST_EQ(r, 2);
+
+	return boost::report_errors();
+}
+
+#endif
@@ -0,0 +1,134 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <boost/leaf/preload.hpp>
+#include <boost/leaf/handle_error.hpp>
+#include <boost/leaf/result.hpp>
+#include "lightweight_test.hpp"
+
+namespace leaf = boost::leaf;
+
+int constructed;
+
+struct e_name
+{
+	std::string value;
+
+	e_name()
+	{
+	}
+
+	explicit e_name( std::string const & s ):
+		value(s)
+	{
+		++constructed;
+	}
+};
+
+template <int>
+struct info
+{
+	int value;
+};
+
+leaf::result<int> f( std::string const & name, bool fail )
+{
+	auto load = leaf::preload_ref<e_name>(name);
+	if( fail )
+		return leaf::new_error();
+	return 42;
+}
+
+int main()
+{
+	// The E-object is constructed, from the current value, only if an error is reported.
+	{
+		constructed = 0;
+		std::string name = "a";
+		int r = leaf::try_handle_all(
+			[&]() -> leaf::result<int>
+			{
+				auto load = leaf::preload_ref<e_name>(name);
+				name = "b";
+				return leaf::new_error();
+			},
+			[]( e_name const & n )
+			{
+				BOOST_TEST_EQ(n.value, "b");
+				return 1;
+			},
+			[]
+			{
+				return 2;
+			} );
+		BOOST_TEST_EQ(r, 1);
+		BOOST_TEST_EQ(constructed, 1);
+	}
+
+	// No E-object is constructed on success.
+	{
+		constructed = 0;
+		std::string name = "a";
+		int r = leaf::try_handle_all(
+			[&]
+			{
+				return f(name, false);
+			},
+			[]( e_name const & )
+			{
+				return 1;
+			},
+			[]
+			{
+				return 2;
+			} );
+		BOOST_TEST_EQ(r, 42);
+		BOOST_TEST_EQ(constructed, 0);
+	}
+
+	// No E-object is constructed if no handler needs it.
+	{
+		constructed = 0;
+		std::string name = "a";
+		int r = leaf::try_handle_all(
+			[&]
+			{
+				return f(name, true);
+			},
+			[]( info<1> const & )
+			{
+				return 1;
+			},
+			[]
+			{
+				return 2;
+			} );
+		BOOST_TEST_EQ(r, 2);
+		BOOST_TEST_EQ(constructed, 0);
+	}
+
+	// Trivial E-types are constructed from the referenced value too.
+	{
+		int x = 1;
+		int r = leaf::try_handle_all(
+			[&]() -> leaf::result<int>
+			{
+				auto load = leaf::preload_ref<info<1>>(x);
+				x = 2;
+				return leaf::new_error();
+			},
+			[]( info<1> const & i )
+			{
+				return i.value;
+			},
+			[]
+			{
+				return 0;
+			} );
+		BOOST_TEST_EQ(r, 2);
+	}
+
+	return boost::report_errors();
+}
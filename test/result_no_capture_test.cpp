@@ -0,0 +1,138 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#define LEAF_NO_CAPTURE_IN_RESULT
+#include <boost/leaf/result.hpp>
+#include <boost/leaf/capture.hpp>
+#include <boost/leaf/handle_error.hpp>
+#include "lightweight_test.hpp"
+#include <type_traits>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+namespace leaf = boost::leaf;
+
+struct val
+{
+	static int count;
+	int value;
+
+	explicit val( int v ):
+		value(v)
+	{
+		++count;
+	}
+
+	val( val const & x ):
+		value(x.value)
+	{
+		++count;
+	}
+
+	val( val && x ):
+		value(x.value)
+	{
+		++count;
+	}
+
+	~val()
+	{
+		--count;
+	}
+};
+int val::count = 0;
+
+struct info { int value; };
+
+static_assert(std::is_trivially_copyable<leaf::result<int>>::value, "result<int> should be trivially copyable");
+static_assert(std::is_trivially_copyable<leaf::result<float>>::value, "result<float> should be trivially copyable");
+static_assert(std::is_trivially_copyable<leaf::result<void>>::value, "result<void> should be trivially copyable");
+static_assert(std::is_trivially_copyable<leaf::result<std::uint64_t>>::value, "result<std::uint64_t> should be trivially copyable");
+static_assert(std::is_trivially_destructible<leaf::result<int>>::value, "result<int> should be trivially destructible");
+static_assert(!std::is_trivially_copyable<leaf::result<val>>::value, "result<val> should not be trivially copyable");
+static_assert(!std::is_trivially_destructible<leaf::result<val>>::value, "result<val> should not be trivially destructible");
+
+leaf::result<int> f( int x )
+{
+	if( x<0 )
+		return leaf::new_error(info{x});
+	else
+		return x;
+}
+
+leaf::result<float> g( int x )
+{
+	LEAF_AUTO(y, f(x));
+	return float(y) / 2;
+}
+
+leaf::result<void> h( int x )
+{
+	LEAF_CHECK(g(x));
+	return { };
+}
+
+int main()
+{
+	{
+		leaf::result<float> r = g(42);
+		BOOST_TEST(r);
+		BOOST_TEST_EQ(r.value(), 21.0f);
+	}
+	{
+		int r = leaf::try_handle_all(
+			[]() -> leaf::result<int>
+			{
+				LEAF_CHECK(h(-42));
+				return 0;
+			},
+			[]( info const & x )
+			{
+				return x.value;
+			},
+			[]
+			{
+				return 1;
+			} );
+		BOOST_TEST_EQ(r, -42);
+	}
+	{
+		std::vector<leaf::result<std::uint64_t>> v;
+		for( int i=0; i!=100; ++i )
+			if( i%3 )
+				v.push_back(std::uint64_t(i));
+			else
+				v.push_back(leaf::new_error(info{i}));
+		for( int i=0; i!=100; ++i )
+			if( i%3 )
+				BOOST_TEST_EQ(v[i].value(), std::uint64_t(i));
+			else
+				BOOST_TEST(!v[i]);
+		leaf::result<std::uint64_t> r = std::uint64_t(0);
+		std::memcpy(&r, &v[5], sizeof(r));
+		BOOST_TEST_EQ(r.value(), 5u);
+		std::memcpy(&r, &v[6], sizeof(r));
+		BOOST_TEST(!r);
+		BOOST_TEST_EQ(r.get_error_id(), v[6].get_error_id());
+		leaf::result<void> rv;
+		rv = leaf::result<void>(r.get_error_id());
+		BOOST_TEST(!rv);
+		BOOST_TEST_EQ(rv.get_error_id(), r.get_error_id());
+	}
+	{
+		{
+			leaf::result<val> r1 = val(42);
+			BOOST_TEST_EQ(val::count, 1);
+			leaf::result<val> r2 = std::move(r1);
+			BOOST_TEST_EQ(val::count, 2);
+			BOOST_TEST_EQ(r2.value().value, 42);
+			r1 = leaf::new_error();
+			BOOST_TEST_EQ(val::count, 1);
+		}
+		BOOST_TEST_EQ(val::count, 0);
+	}
+	return boost::report_errors();
+}
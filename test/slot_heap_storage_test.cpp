@@ -0,0 +1,204 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#define LEAF_SLOT_HEAP_THRESHOLD 32
+#include <boost/leaf/handle_error.hpp>
+#include <boost/leaf/result.hpp>
+#include "lightweight_test.hpp"
+#include <sstream>
+#include <new>
+
+namespace leaf = boost::leaf;
+
+bool fail_allocations;
+
+void * operator new( std::size_t size, std::nothrow_t const & ) noexcept
+{
+	return fail_allocations ? 0 : ::operator new(size);
+}
+
+struct big
+{
+	static int count;
+	int value;
+	char pad[64];
+
+	explicit big( int v ):
+		value(v)
+	{
+		++count;
+	}
+
+	big( big const & x ):
+		value(x.value)
+	{
+		++count;
+	}
+
+	big( big && x ):
+		value(x.value)
+	{
+		++count;
+	}
+
+	~big()
+	{
+		--count;
+	}
+
+	friend std::ostream & operator<<( std::ostream & os, big const & x )
+	{
+		return os << "big " << x.value;
+	}
+};
+int big::count = 0;
+
+struct small
+{
+	int value;
+};
+
+struct never
+{
+	int value;
+};
+
+struct huge
+{
+	int value;
+	char pad[128];
+};
+
+static_assert(sizeof(leaf::leaf_detail::slot<big>) < sizeof(big), "big should be stored out of line");
+
+leaf::result<int> f( int x )
+{
+	if( x<0 )
+		return leaf::new_error(big{x}, small{x});
+	else
+		return x;
+}
+
+template <int Depth>
+struct nest
+{
+	static leaf::result<int> g( int x )
+	{
+		return leaf::try_handle_some(
+			[=]
+			{
+				return nest<Depth-1>::g(x);
+			},
+			[]( big const & b, never const & ) -> leaf::result<int>
+			{
+				return b.value;
+			} );
+	}
+};
+
+template <>
+struct nest<0>
+{
+	static leaf::result<int> g( int x )
+	{
+		return f(x);
+	}
+};
+
+int main()
+{
+	for( int i=0; i!=3; ++i )
+	{
+		int r = leaf::try_handle_all(
+			[]() -> leaf::result<int>
+			{
+				return nest<4>::g(-42);
+			},
+			[]( big const & b, small const & s )
+			{
+				BOOST_TEST_EQ(b.value, -42);
+				BOOST_TEST_EQ(s.value, -42);
+				BOOST_TEST_EQ(big::count, 1);
+				return 1;
+			},
+			[]
+			{
+				return 2;
+			} );
+		BOOST_TEST_EQ(r, 1);
+		BOOST_TEST_EQ(big::count, 0);
+	}
+	{
+		int r = leaf::try_handle_all(
+			[]() -> leaf::result<int>
+			{
+				return nest<2>::g(42);
+			},
+			[]( big const & )
+			{
+				return 1;
+			},
+			[]
+			{
+				return 2;
+			} );
+		BOOST_TEST_EQ(r, 42);
+		BOOST_TEST_EQ(big::count, 0);
+	}
+	{
+		leaf::context<big> ctx;
+		{
+			auto active_context = activate_context(ctx, leaf::on_deactivation::do_not_propagate);
+			(void) leaf::new_error(big{1});
+			(void) leaf::new_error(big{2});
+		}
+		BOOST_TEST_EQ(big::count, 1);
+		std::ostringstream st;
+		ctx.print(st);
+		BOOST_TEST(st.str().find("big 2")!=std::string::npos);
+	}
+	BOOST_TEST_EQ(big::count, 0);
+
+	// If no memory can be allocated for a large E-object, it is not stored.
+	{
+		fail_allocations = true;
+		int r = leaf::try_handle_all(
+			[]() -> leaf::result<int>
+			{
+				return leaf::new_error(huge{1, { }}, small{2});
+			},
+			[]( huge const & h )
+			{
+				return h.value;
+			},
+			[]( small const & s )
+			{
+				return s.value;
+			},
+			[]
+			{
+				return 3;
+			} );
+		fail_allocations = false;
+		BOOST_TEST_EQ(r, 2);
+	}
+	{
+		int r = leaf::try_handle_all(
+			[]() -> leaf::result<int>
+			{
+				return leaf::new_error(huge{1, { }}, small{2});
+			},
+			[]( huge const & h )
+			{
+				return h.value;
+			},
+			[]
+			{
+				return 3;
+			} );
+		BOOST_TEST_EQ(r, 1);
+	}
+	return boost::report_errors();
+}
@@ -0,0 +1,80 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#define LEAF_ENABLE_STACKTRACE
+#include <boost/leaf/handle_error.hpp>
+#include <boost/leaf/result.hpp>
+#include "lightweight_test.hpp"
+#include <sstream>
+
+namespace leaf = boost::leaf;
+
+#if defined(__GLIBC__) || defined(__APPLE__) || defined(_WIN32)
+#	define STACKTRACE_AVAILABLE 1
+#else
+#	define STACKTRACE_AVAILABLE 0
+#endif
+
+leaf::result<int> f()
+{
+	return LEAF_NEW_ERROR();
+}
+
+int main()
+{
+	{
+		leaf::e_stacktrace st;
+		BOOST_TEST_EQ(st.size(), 0);
+		st.capture();
+		BOOST_TEST(st.size()<=leaf::e_stacktrace::capacity());
+#if STACKTRACE_AVAILABLE
+		BOOST_TEST(st.size()>0);
+#endif
+		std::ostringstream s;
+		s << st;
+		BOOST_TEST(s.str().find("frames")!=std::string::npos);
+	}
+
+	// new_error captures the stack if a handler takes an e_stacktrace.
+	{
+		int r = leaf::try_handle_all(
+			[]
+			{
+				return f();
+			},
+			[]( leaf::e_stacktrace const & st )
+			{
+#if STACKTRACE_AVAILABLE
+				BOOST_TEST(st.size()>0);
+#endif
+				return 1;
+			},
+			[]
+			{
+				return 2;
+			} );
+		BOOST_TEST_EQ(r, 1);
+	}
+
+	// A context only keeps the stack trace of the most recent error.
+	{
+		leaf::context<leaf::e_stacktrace> ctx;
+		leaf::error_id id1, id2;
+		{
+			auto active_context = activate_context(ctx, leaf::on_deactivation::do_not_propagate);
+			id1 = leaf::new_error();
+			id2 = leaf::new_error();
+		}
+		leaf::result<int> r1(id1), r2(id2);
+		auto h = []( leaf::e_stacktrace const * st )
+		{
+			return st ? 1 : 2;
+		};
+		BOOST_TEST_EQ(ctx.handle_all(r1, h), 2);
+		BOOST_TEST_EQ(ctx.handle_all(r2, h), 1);
+	}
+
+	return boost::report_errors();
+}
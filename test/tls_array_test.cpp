@@ -0,0 +1,82 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#define LEAF_USE_TLS_ARRAY
+#define LEAF_TLS_ARRAY_SIZE 2
+#include <boost/leaf/handle_error.hpp>
+#include <boost/leaf/result.hpp>
+#include "lightweight_test.hpp"
+
+namespace leaf = boost::leaf;
+
+template <int N>
+struct info
+{
+	int value;
+};
+
+// More E-types than LEAF_TLS_ARRAY_SIZE, so some of them use the fallback TLS variables.
+leaf::result<int> f( int x )
+{
+	return leaf::new_error(info<1>{x+1}, info<2>{x+2}, info<3>{x+3}, info<4>{x+4});
+}
+
+int main()
+{
+	{
+		int r = leaf::try_handle_all(
+			[]() -> leaf::result<int>
+			{
+				return f(10);
+			},
+			[]( info<1> const & x1, info<2> const & x2, info<3> const & x3, info<4> const & x4 )
+			{
+				BOOST_TEST_EQ(x1.value, 11);
+				BOOST_TEST_EQ(x2.value, 12);
+				BOOST_TEST_EQ(x3.value, 13);
+				BOOST_TEST_EQ(x4.value, 14);
+				return 1;
+			},
+			[]
+			{
+				return 2;
+			} );
+		BOOST_TEST_EQ(r, 1);
+	}
+	{
+		int r = leaf::try_handle_all(
+			[]() -> leaf::result<int>
+			{
+				return leaf::try_handle_some(
+					[]() -> leaf::result<int>
+					{
+						return f(20);
+					},
+					[]( info<4> const & x4, info<1> const & x1 ) -> leaf::result<int>
+					{
+						BOOST_TEST_EQ(x4.value, 24);
+						BOOST_TEST_EQ(x1.value, 21);
+						return leaf::new_error(info<3>{x4.value+x1.value});
+					} );
+			},
+			[]( info<3> const & x3, info<2> const & x2 )
+			{
+				BOOST_TEST_EQ(x3.value, 45);
+				BOOST_TEST_EQ(x2.value, 22);
+				return 1;
+			},
+			[]( info<3> const & x3 )
+			{
+				BOOST_TEST_EQ(x3.value, 45);
+				return 2;
+			},
+			[]
+			{
+				return 3;
+			} );
+		BOOST_TEST_EQ(r, 2);
+	}
+	return boost::report_errors();
+}
@@ -0,0 +1,62 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include <boost/leaf/detail/print.hpp>
+#include "lightweight_test.hpp"
+#include <sstream>
+#include <string>
+
+namespace leaf = boost::leaf;
+
+template <int N>
+struct info
+{
+	int value;
+};
+
+namespace ns
+{
+	struct e_type { };
+}
+
+template <class... T>
+struct long_name
+{
+};
+
+template <class T>
+std::string str()
+{
+	std::ostringstream s;
+	s << leaf::type<T>();
+	return s.str();
+}
+
+constexpr std::uint64_t hash_info1 = leaf::type<info<1>>().hash;
+constexpr int length_info1 = leaf::type<info<1>>().length;
+static_assert(hash_info1!=leaf::type<info<2>>().hash, "type_name hash collision");
+static_assert(length_info1==7, "Unexpected type name length");
+
+int main()
+{
+	BOOST_TEST_EQ(str<info<1>>(), "info<1>");
+	BOOST_TEST_EQ(str<info<-42>>(), "info<-42>");
+	BOOST_TEST_NE(str<ns::e_type>().find("ns::e_type"), std::string::npos);
+	BOOST_TEST_NE(str<int[3]>().find("int"), std::string::npos);
+	BOOST_TEST_NE(str<int[3]>().find("[3]"), std::string::npos);
+
+	BOOST_TEST(leaf::type<info<1>>()==leaf::type<info<1>>());
+	BOOST_TEST(leaf::type<info<1>>()!=leaf::type<info<2>>());
+	BOOST_TEST_EQ(leaf::type<info<1>>().hash, hash_info1);
+
+	using big = long_name<info<1>, info<2>, info<3>, info<4>, info<5>, info<6>, info<7>, info<8>, info<9>, info<10>,
+		long_name<info<1>, info<2>, info<3>, info<4>, info<5>, info<6>, info<7>, info<8>, info<9>, info<10>,
+			long_name<info<1>, info<2>, info<3>, info<4>, info<5>, info<6>, info<7>, info<8>, info<9>, info<10>>>>;
+	constexpr leaf::type_name big_name = leaf::type<big>();
+	BOOST_TEST_GT(big_name.length, 300);
+	BOOST_TEST_EQ(str<big>().substr(0, 10), "long_name<");
+
+	return boost::report_errors();
+}
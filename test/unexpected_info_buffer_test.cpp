@@ -0,0 +1,158 @@
+// Copyright (c) 2018-2019 Emil Dotchevski and Reverge Studios, Inc.
+
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#define LEAF_UNEXPECTED_INFO_BUFFER_SIZE 128
+#include <boost/leaf/handle_error.hpp>
+#include <boost/leaf/result.hpp>
+#include "lightweight_test.hpp"
+#include <sstream>
+
+namespace leaf = boost::leaf;
+
+int object_count = 0;
+int print_count = 0;
+
+template <int N>
+struct info
+{
+	int value;
+
+	explicit info( int value ) noexcept:
+		value(value)
+	{
+		++object_count;
+	}
+
+	info( info && x ) noexcept:
+		value(x.value)
+	{
+		++object_count;
+	}
+
+	info( info const & x ) noexcept:
+		value(x.value)
+	{
+		++object_count;
+	}
+
+	~info() noexcept
+	{
+		--object_count;
+	}
+
+	friend std::ostream & operator<<( std::ostream & os, info const & x )
+	{
+		++print_count;
+		return os << "info<" << N << ">: " << x.value;
+	}
+};
+
+struct big
+{
+	int value;
+	char buf[256];
+};
+
+struct e_name
+{
+	std::string value;
+};
+
+leaf::result<void> f()
+{
+	return leaf::new_error(info<1>{1}, info<2>{2}, info<1>{3}, big{ }, info<3>{4}, info<4>{5}, info<5>{6});
+}
+
+// The buffer is not stored in the context.
+static_assert(sizeof(leaf::context<leaf::verbose_diagnostic_info const &>) < LEAF_UNEXPECTED_INFO_BUFFER_SIZE, "e_unexpected_info stored inline");
+
+int main()
+{
+	{
+		std::string s;
+		int r = leaf::try_handle_all(
+			[]() -> leaf::result<int>
+			{
+				return leaf::try_handle_some(
+					[]() -> leaf::result<int>
+					{
+						LEAF_CHECK(f());
+						return 0;
+					},
+					[]( info<42> const & ) -> leaf::result<int>
+					{
+						return 42;
+					} );
+			},
+			[&]( leaf::verbose_diagnostic_info const & di )
+			{
+#if LEAF_DIAGNOSTICS
+				BOOST_TEST_GT(object_count, 0);
+#endif
+				BOOST_TEST_EQ(print_count, 0);
+				std::ostringstream st;
+				st << di;
+				s = st.str();
+				std::cout << s;
+				return 1;
+			} );
+		BOOST_TEST_EQ(r, 1);
+		BOOST_TEST_EQ(object_count, 0);
+#if LEAF_DIAGNOSTICS
+		BOOST_TEST_GT(print_count, 0);
+		BOOST_TEST_NE(s.find("info<1>: 1"), s.npos);
+		BOOST_TEST_EQ(s.find("info<1>: 3"), s.npos);
+		BOOST_TEST_NE(s.find("info<2>: 2"), s.npos);
+		BOOST_TEST_EQ(s.find("big"), s.npos);
+		BOOST_TEST_NE(s.find("more not captured"), s.npos);
+#endif
+	}
+
+	{
+		int r = leaf::try_handle_all(
+			[]() -> leaf::result<int>
+			{
+				LEAF_CHECK(f());
+				return 0;
+			},
+			[]( leaf::verbose_diagnostic_info const & )
+			{
+				return 1;
+			} );
+		BOOST_TEST_EQ(r, 1);
+		BOOST_TEST_EQ(object_count, 0);
+	}
+
+	// Lvalues passed to new_error are copied, not moved from.
+	{
+		e_name n{"important-file-name"};
+		info<6> i6{42};
+		std::string s;
+		int r = leaf::try_handle_all(
+			[&]() -> leaf::result<int>
+			{
+				return leaf::new_error(n, i6);
+			},
+			[&]( leaf::verbose_diagnostic_info const & di )
+			{
+				std::ostringstream st;
+				st << di;
+				s = st.str();
+				return 1;
+			} );
+		BOOST_TEST_EQ(r, 1);
+		BOOST_TEST_EQ(n.value, "important-file-name");
+		BOOST_TEST_EQ(i6.value, 42);
+#if LEAF_DIAGNOSTICS
+		BOOST_TEST_NE(s.find("info<6>: 42"), s.npos);
+		// Copying e_name may throw, so it is only counted.
+		BOOST_TEST_EQ(s.find("important-file-name"), s.npos);
+		BOOST_TEST_NE(s.find("more not captured"), s.npos);
+#endif
+	}
+	BOOST_TEST_EQ(object_count, 0);
+
+	return boost::report_errors();
+}